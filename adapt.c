@@ -1,36 +1,117 @@
 #include "adapt.h"
 
-#include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
 
 #include "coarsen.h"
 #include "comm.h"
+#include "diffusive_balance.h"
 #include "doubles.h"
+#include "ghost_mesh.h"
+#include "ints.h"
 #include "loop.h"
 #include "mesh.h"
+#include "parallel_inertial_bisect.h"
+#include "parallel_mesh.h"
 #include "quality.h"
 #include "refine.h"
 #include "size.h"
 #include "swap.h"
+#include "trace.h"
 
 static unsigned global_op_count = 0;
 static unsigned global_max_ops = 0;
+static double global_max_imbalance = 0;
+static unsigned global_diffusive = 0;
+
+void mesh_adapt_set_imbalance(double max_imbalance)
+{
+  global_max_imbalance = max_imbalance;
+}
+
+void mesh_adapt_set_diffusive(unsigned diffusive)
+{
+  global_diffusive = diffusive;
+}
+
+/* all the decisions made by the adapt driver have
+   to be identical on all MPI ranks, otherwise
+   they will disagree about which collective
+   operation comes next.
+   that means every quantity used in a decision
+   has to be a global one. */
+
+static double global_min_quality(struct mesh* m)
+{
+  return comm_min_double(mesh_adapt_min_quality(m));
+}
+
+/* counts each element once, on the rank that owns it,
+   regardless of whether the mesh is currently ghosted */
+
+static unsigned count_owned_elems(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  if (!mesh_is_parallel(m) || !mesh_ghost_layers(m))
+    return nelems;
+  unsigned* owned = mesh_get_owned(m, dim);
+  unsigned nowned = uints_sum(owned, nelems);
+  loop_free(owned);
+  return nowned;
+}
 
 static void adapt_summary(struct mesh* m)
 {
-  unsigned long total_elems = comm_add_ulong(mesh_count(m, mesh_dim(m)));
-  double minqual = comm_min_double(mesh_min_quality(m));
+  unsigned long total_elems = count_owned_elems(m);
+  double minqual = mesh_min_quality(m);
   unsigned nedges = mesh_count(m, 1);
   double* edge_sizes = mesh_measure_edges_for_adapt(m);
-  double min = comm_min_double(doubles_min(edge_sizes, nedges));
-  double max = comm_max_double(doubles_max(edge_sizes, nedges));
+  double min = doubles_min(edge_sizes, nedges);
+  double max = doubles_max(edge_sizes, nedges);
   loop_free(edge_sizes);
+  struct comm_reduction* r = comm_new_reduction();
+  comm_defer_add_ulong(r, &total_elems);
+  comm_defer_min_double(r, &minqual);
+  comm_defer_min_double(r, &min);
+  comm_defer_max_double(r, &max);
+  comm_reduce(r);
+  comm_free_reduction(r);
   if (comm_rank() == 0)
     printf("%10lu elements, min quality %.0f%%, metric range %.2f - %.2f\n",
         total_elems, minqual * 100.0, min, max);
 }
 
+/* refinement and coarsening are very local operations,
+   so after a few passes one part can end up with
+   many more elements than the others.
+   if the user asked for it, restore the balance
+   before the next pass by repartitioning, or by
+   diffusion down to halfway below the ceiling, so
+   the next few passes don't trigger it again. */
+
+static void maybe_rebalance(struct mesh* m)
+{
+  if (!mesh_is_parallel(m) || global_max_imbalance <= 1.0)
+    return;
+  unsigned long total = count_owned_elems(m);
+  unsigned long max = total;
+  struct comm_reduction* r = comm_new_reduction();
+  comm_defer_add_ulong(r, &total);
+  comm_defer_max_ulong(r, &max);
+  comm_reduce(r);
+  comm_free_reduction(r);
+  double imbalance = (double) max / ((double) total / comm_size());
+  if (imbalance <= global_max_imbalance)
+    return;
+  if (comm_rank() == 0)
+    printf("element imbalance %.2f, rebalancing\n", imbalance);
+  if (global_diffusive)
+    balance_mesh_diffusive(m, 1.0 + (global_max_imbalance - 1.0) / 2);
+  else
+    balance_mesh_inertial(m);
+}
+
 static void incr_op_count(struct mesh* m)
 {
   if (global_op_count > global_max_ops) {
@@ -39,12 +120,13 @@ static void incr_op_count(struct mesh* m)
     abort();
   }
   ++global_op_count;
+  maybe_rebalance(m);
   adapt_summary(m);
 }
 
 static void satisfy_size(struct mesh* m, double size_floor, double good_qual)
 {
-  double qual_floor = mesh_min_quality(m);
+  double qual_floor = global_min_quality(m);
   if (good_qual < qual_floor)
     qual_floor = good_qual;
   while (refine_by_size(m, qual_floor))
@@ -59,7 +141,7 @@ static void satisfy_shape(
     unsigned nsliver_layers)
 {
   while (1) {
-    double prev_qual = mesh_min_quality(m);
+    double prev_qual = global_min_quality(m);
     if (prev_qual >= qual_floor)
       return;
     if (mesh_dim(m) == 3 &&
@@ -71,7 +153,8 @@ static void satisfy_shape(
       incr_op_count(m);
       continue;
     }
-    fprintf(stderr, "ran out of options!\n");
+    if (comm_rank() == 0)
+      fprintf(stderr, "ran out of options!\n");
     abort();
   }
 }
@@ -82,11 +165,20 @@ unsigned mesh_adapt(struct mesh* m,
     unsigned nsliver_layers,
     unsigned max_ops)
 {
-  assert(!mesh_is_parallel(m));
+  trace_begin("mesh_adapt");
+  unsigned nghost_layers = 0;
+  if (mesh_is_parallel(m))
+    nghost_layers = mesh_ghost_layers(m);
   global_op_count = 0;
   global_max_ops = max_ops;
   adapt_summary(m);
   satisfy_size(m, size_ratio_floor, good_qual);
   satisfy_shape(m, good_qual, nsliver_layers);
+  /* the modification passes leave the mesh with
+     whatever ghosting they last needed, give the
+     user back what they gave us */
+  if (mesh_is_parallel(m))
+    mesh_ensure_ghosting(m, nghost_layers);
+  trace_end();
   return global_op_count > 0;
 }
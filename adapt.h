@@ -9,4 +9,21 @@ unsigned mesh_adapt(struct mesh* m,
     unsigned nsliver_layers,
     unsigned max_ops);
 
+/* for partitioned meshes, mesh_adapt will call
+   balance_mesh_inertial between passes whenever
+   the largest part has more than (max_imbalance)
+   times the average number of elements.
+   values at or below 1.0 (the default is zero)
+   disable rebalancing. */
+
+void mesh_adapt_set_imbalance(double max_imbalance);
+
+/* nonzero makes that rebalancing use balance_mesh_diffusive,
+   which only moves elements near part boundaries */
+
+void mesh_adapt_set_diffusive(unsigned diffusive);
+
+/* a vertex tag "adapt_region" masks all of the above to the
+   region around the marked vertices, see adapt_region.h */
+
 #endif
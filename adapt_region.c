@@ -0,0 +1,93 @@
+#include "adapt_region.h"
+
+#include "arrays.h"
+#include "ints.h"
+#include "loop.h"
+#include "mark.h"
+#include "mesh.h"
+#include "parallel_mesh.h"
+#include "tag.h"
+
+static char const* const region_name = "adapt_region";
+
+unsigned* mesh_mark_region(struct mesh* m, unsigned dim)
+{
+  struct const_tag* t = mesh_find_tag(m, 0, region_name);
+  if (!t)
+    return 0;
+  unsigned* verts = uints_copy(t->d.u32, mesh_count(m, 0));
+  mesh_conform_uints(m, 0, 1, &verts);
+  if (!dim)
+    return verts;
+  unsigned* ents = mesh_mark_up(m, 0, dim, verts);
+  loop_free(verts);
+  return ents;
+}
+
+unsigned* mesh_list_region(struct mesh* m, unsigned dim,
+    unsigned* p_nents)
+{
+  unsigned* marked = mesh_mark_region(m, dim);
+  if (!marked)
+    return 0;
+  unsigned* ents = collect_marked(mesh_count(m, dim), marked, 0, p_nents);
+  loop_free(marked);
+  return ents;
+}
+
+LOOP_KERNEL(mask_marked,
+    unsigned const* region,
+    unsigned* marked)
+  if (!region[i])
+    marked[i] = 0;
+}
+
+void mesh_mask_to_region(struct mesh* m, unsigned dim,
+    unsigned* marked)
+{
+  unsigned* region = mesh_mark_region(m, dim);
+  if (!region)
+    return;
+  LOOP_EXEC(mask_marked, mesh_count(m, dim), region, marked);
+  loop_free(region);
+}
+
+LOOP_KERNEL(mark_generated,
+    unsigned nkept,
+    unsigned* generated)
+  generated[i] = (i >= nkept);
+}
+
+LOOP_KERNEL(grow_region_verts,
+    unsigned nkept_verts,
+    unsigned const* touched,
+    unsigned* region)
+  if (i >= nkept_verts || touched[i])
+    region[i] = 1;
+}
+
+void mesh_grow_region(struct mesh* m, struct mesh* m_out,
+    unsigned* const offset_of_same_ents[4])
+{
+  struct const_tag* t = mesh_find_tag(m, 0, region_name);
+  if (!t)
+    return;
+  unsigned elem_dim = mesh_dim(m);
+  unsigned nverts = mesh_count(m, 0);
+  unsigned nverts_out = mesh_count(m_out, 0);
+  unsigned* region = LOOP_MALLOC(unsigned, nverts_out);
+  uints_expand_into(nverts, 1, t->d.u32, offset_of_same_ents[0], region);
+  unsigned nkept_verts = uints_at(offset_of_same_ents[0], nverts);
+  unsigned nelems_out = mesh_count(m_out, elem_dim);
+  unsigned* generated = LOOP_MALLOC(unsigned, nelems_out);
+  LOOP_EXEC(mark_generated, nelems_out,
+      uints_at(offset_of_same_ents[elem_dim], mesh_count(m, elem_dim)),
+      generated);
+  unsigned* touched = mesh_mark_down_local(m_out, elem_dim, 0, generated);
+  loop_free(generated);
+  LOOP_EXEC(grow_region_verts, nverts_out, nkept_verts, touched, region);
+  loop_free(touched);
+  if (mesh_find_tag(m_out, 0, region_name))
+    mesh_free_tag(m_out, 0, region_name);
+  mesh_add_tag(m_out, 0, TAG_U32, region_name, 1, region);
+}
@@ -0,0 +1,43 @@
+#ifndef ADAPT_REGION_H
+#define ADAPT_REGION_H
+
+struct mesh;
+
+/* adaptation can be masked to a region of the mesh, given
+ * by the vertex tag "adapt_region" (TAG_U32, nonzero inside).
+ * an entity is in the region if one of its vertices is.
+ * only edges in the region are measured for size, only
+ * elements in the region have their quality evaluated when
+ * adapt decides what to accept (the rest count as perfect,
+ * see mesh_adapt_qualities; mesh_qualities and the reported
+ * minimum still cover every element), and refinement,
+ * coarsening and swapping candidates outside it are unmarked.
+ * this is a mask, not a smaller mesh: the geometric work
+ * scales with the region, but marking the region, the
+ * independent sets, conforming and rebuilding the mesh
+ * still touch every entity, so each pass stays O(mesh).
+ * every modification adds the vertices of the cavities it
+ * rebuilt, so the region follows the adaptation around.
+ * without the tag, all of these cover the whole mesh.
+ */
+
+/* marks the entities of dimension (dim) in the region,
+   or returns null if there is no region */
+unsigned* mesh_mark_region(struct mesh* m, unsigned dim);
+
+/* lists the (*p_nents) entities of dimension (dim) in the
+   region, or returns null if there is no region */
+unsigned* mesh_list_region(struct mesh* m, unsigned dim,
+    unsigned* p_nents);
+
+/* masks (marked), unmarking the entities outside the region */
+void mesh_mask_to_region(struct mesh* m, unsigned dim,
+    unsigned* marked);
+
+/* gives (m_out) the region of (m) plus the vertices of the
+   entities it generated. (offset_of_same_ents) is as
+   described for carry_topology. */
+void mesh_grow_region(struct mesh* m, struct mesh* m_out,
+    unsigned* const offset_of_same_ents[4]);
+
+#endif
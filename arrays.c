@@ -218,3 +218,30 @@ void name##_max_into(unsigned n, unsigned width, \
 }
 
 GENERIC_MAX_INTO(double, doubles)
+
+#define MIN(a, b) ((b) < (a) ? (b) : (a))
+
+#define GENERIC_MIN_INTO(T, name) \
+LOOP_KERNEL(min_##name##_into_kern, T const* a, unsigned width, \
+    unsigned const* offsets, T* out) \
+  unsigned first = offsets[i]; \
+  unsigned end = offsets[i + 1]; \
+  if (end == first) \
+    return; \
+  for (unsigned k = 0; k < width; ++k) { \
+    out[i * width + k] = a[first * width + k]; \
+  } \
+  for (unsigned j = first + 1; j < end; ++j) \
+    for (unsigned k = 0; k < width; ++k) { \
+      out[i * width + k] = MIN(out[i * width + k], a[j * width + k]); \
+    } \
+} \
+void name##_min_into(unsigned n, unsigned width, \
+    T const* a, unsigned const* offsets, \
+    T* out) \
+{ \
+  LOOP_EXEC(min_##name##_into_kern, n, a, width, offsets, out); \
+}
+
+GENERIC_MIN_INTO(unsigned, uints)
+GENERIC_MIN_INTO(unsigned long, ulongs)
@@ -78,5 +78,9 @@ unsigned uints_at(unsigned const* a, unsigned i);
 
 void doubles_max_into(unsigned n, unsigned width,
     double const* a, unsigned const* offsets, double* out);
+void uints_min_into(unsigned n, unsigned width,
+    unsigned const* a, unsigned const* offsets, unsigned* out);
+void ulongs_min_into(unsigned n, unsigned width,
+    unsigned long const* a, unsigned const* offsets, unsigned long* out);
 
 #endif
@@ -2,16 +2,16 @@
 
 #include <assert.h>
 
+#include "arrays.h"
+#include "ints.h"
 #include "loop.h"
+#include "sort.h"
 #include "tables.h"
 
-/* none of the functions in this file
-   are parallelized via the LOOP mechanism.
-   this means during accelerator runs they
-   will have to be executed on the host.
-   the reasoning is that BFS is somewhat
-   inherently serial (#layers), and parallelizing
-   each layer seems like more trouble than its worth */
+/* the first functions in this file are serial
+   and run on host copies of the graph.
+   the *_parallel ones further down give the same
+   results using the LOOP mechanism on device arrays. */
 
 void bfs_continue(
     unsigned* queue,
@@ -98,3 +98,315 @@ void connected_components(
   loop_host_free(sorted);
 }
 
+
+/* the level-synchronous BFS: the whole frontier is
+   expanded at once into one slot per adjacency entry.
+   a slot is a candidate if its vertex is unvisited,
+   and the first slot of each candidate vertex (found
+   with a stable sort by vertex) discovers it.
+   since slots are laid out in queue order, this is the
+   same discovery order as the serial queue, so the
+   results match bfs_continue exactly. */
+
+LOOP_KERNEL(frontier_degree,
+    unsigned const* frontier,
+    unsigned const* offsets,
+    unsigned* degrees)
+  unsigned u = frontier[i];
+  degrees[i] = offsets[u + 1] - offsets[u];
+}
+
+LOOP_KERNEL(fill_slots,
+    unsigned n,
+    unsigned const* frontier,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned const* layer,
+    unsigned const* slot_offsets,
+    unsigned long* slot_verts,
+    unsigned* slot_parents)
+  unsigned u = frontier[i];
+  unsigned f = offsets[u];
+  unsigned e = offsets[u + 1];
+  unsigned o = slot_offsets[i];
+  for (unsigned j = f; j < e; ++j) {
+    unsigned v = adj[j];
+    /* (n) sorts after every candidate */
+    slot_verts[o + j - f] = (layer[v] == INVALID) ? v : n;
+    slot_parents[o + j - f] = u;
+  }
+}
+
+LOOP_KERNEL(mark_first_slots,
+    unsigned n,
+    unsigned const* order,
+    unsigned long const* slot_verts,
+    unsigned* first)
+  unsigned s = order[i];
+  first[s] = (slot_verts[s] != n) &&
+    (i == 0 || slot_verts[order[i - 1]] != slot_verts[s]);
+}
+
+LOOP_KERNEL(discover,
+    unsigned const* first,
+    unsigned const* first_offsets,
+    unsigned long const* slot_verts,
+    unsigned const* slot_parents,
+    unsigned* queue_end,
+    unsigned* comp,
+    unsigned* layer)
+  if (first[i]) {
+    unsigned v = (unsigned) slot_verts[i];
+    unsigned u = slot_parents[i];
+    queue_end[first_offsets[i]] = v;
+    layer[v] = layer[u] + 1;
+    if (comp)
+      comp[v] = comp[u];
+  }
+}
+
+static unsigned expand_frontier(
+    unsigned n,
+    unsigned const* frontier,
+    unsigned nfrontier,
+    unsigned* queue_end,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned* comp,
+    unsigned* layer)
+{
+  unsigned* degrees = LOOP_MALLOC(unsigned, nfrontier);
+  LOOP_EXEC(frontier_degree, nfrontier, frontier, offsets, degrees);
+  unsigned* slot_offsets = uints_exscan(degrees, nfrontier);
+  loop_free(degrees);
+  unsigned nslots = uints_at(slot_offsets, nfrontier);
+  unsigned long* slot_verts = LOOP_MALLOC(unsigned long, nslots);
+  unsigned* slot_parents = LOOP_MALLOC(unsigned, nslots);
+  LOOP_EXEC(fill_slots, nfrontier, n, frontier, offsets, adj, layer,
+      slot_offsets, slot_verts, slot_parents);
+  loop_free(slot_offsets);
+  unsigned* order = sort_ulongs(nslots, slot_verts);
+  unsigned* first = LOOP_MALLOC(unsigned, nslots);
+  LOOP_EXEC(mark_first_slots, nslots, n, order, slot_verts, first);
+  loop_free(order);
+  unsigned* first_offsets = uints_exscan(first, nslots);
+  unsigned nnew = uints_at(first_offsets, nslots);
+  LOOP_EXEC(discover, nslots, first, first_offsets, slot_verts, slot_parents,
+      queue_end, comp, layer);
+  loop_free(first);
+  loop_free(first_offsets);
+  loop_free(slot_verts);
+  loop_free(slot_parents);
+  return nnew;
+}
+
+void bfs_continue_parallel(
+    unsigned n,
+    unsigned* queue,
+    unsigned* p_begin,
+    unsigned* p_end,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned* comp,
+    unsigned* layer)
+{
+  unsigned begin = *p_begin;
+  unsigned end = *p_end;
+  while (begin != end) {
+    unsigned nnew = expand_frontier(n, queue + begin, end - begin,
+        queue + end, offsets, adj, comp, layer);
+    begin = end;
+    end += nnew;
+  }
+  *p_begin = begin;
+  *p_end = end;
+}
+
+/* components by hooking and shortcutting (Shiloach-Vishkin):
+   every vertex is labeled with the root of its tree, and
+   the trees are stars after each round.
+   a root whose tree touches trees of smaller roots hooks
+   under the smallest of them; the smallest is found with
+   a sort instead of atomics, so every round is deterministic.
+   since labels only decrease, each component ends up
+   labeled with its smallest vertex. */
+
+LOOP_KERNEL(hook_key,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned const* labels,
+    unsigned bits,
+    unsigned long none,
+    unsigned long* keys,
+    unsigned* hooks)
+  unsigned r = labels[i];
+  unsigned l = r;
+  unsigned f = offsets[i];
+  unsigned e = offsets[i + 1];
+  for (unsigned j = f; j < e; ++j)
+    if (labels[adj[j]] < l)
+      l = labels[adj[j]];
+  keys[i] = (l < r) ? ((((unsigned long) r) << bits) | l) : none;
+  hooks[i] = (l < r);
+}
+
+LOOP_KERNEL(hook_roots,
+    unsigned const* order,
+    unsigned long const* keys,
+    unsigned bits,
+    unsigned long none,
+    unsigned* labels)
+  unsigned long k = keys[order[i]];
+  if (k != none && (i == 0 || (keys[order[i - 1]] >> bits) != (k >> bits)))
+    labels[k >> bits] = (unsigned) (k & ((1ul << bits) - 1));
+}
+
+LOOP_KERNEL(shortcut,
+    unsigned const* labels,
+    unsigned* labels_out,
+    unsigned* changed)
+  labels_out[i] = labels[labels[i]];
+  changed[i] = (labels_out[i] != labels[i]);
+}
+
+static unsigned* shortcut_labels(unsigned n, unsigned* labels)
+{
+  unsigned* changed = LOOP_MALLOC(unsigned, n);
+  while (1) {
+    unsigned* labels_out = LOOP_MALLOC(unsigned, n);
+    LOOP_EXEC(shortcut, n, labels, labels_out, changed);
+    loop_free(labels);
+    labels = labels_out;
+    if (!uints_max(changed, n))
+      break;
+  }
+  loop_free(changed);
+  return labels;
+}
+
+static unsigned* smallest_labels(
+    unsigned n,
+    unsigned const* offsets,
+    unsigned const* adj)
+{
+  unsigned* labels = uints_linear(n, 1);
+  if (!n)
+    return labels;
+  unsigned bits = count_bits(n);
+  unsigned long none = ((unsigned long) n) << bits;
+  unsigned long* keys = LOOP_MALLOC(unsigned long, n);
+  unsigned* hooks = LOOP_MALLOC(unsigned, n);
+  while (1) {
+    LOOP_EXEC(hook_key, n, offsets, adj, labels, bits, none, keys, hooks);
+    if (!uints_max(hooks, n))
+      break;
+    unsigned* order = sort_ulongs(n, keys);
+    LOOP_EXEC(hook_roots, n, order, keys, bits, none, labels);
+    loop_free(order);
+    labels = shortcut_labels(n, labels);
+  }
+  loop_free(hooks);
+  loop_free(keys);
+  return labels;
+}
+
+LOOP_KERNEL(mark_roots,
+    unsigned const* labels,
+    unsigned* roots)
+  roots[i] = (labels[i] == i);
+}
+
+LOOP_KERNEL(number_comps,
+    unsigned const* labels,
+    unsigned const* root_numbers,
+    unsigned* comp)
+  comp[i] = root_numbers[labels[i]];
+}
+
+/* components are numbered in the order of their
+   smallest vertex, as the serial version does */
+
+static unsigned* number_roots(unsigned n, unsigned const* labels,
+    unsigned* comp)
+{
+  unsigned* roots = LOOP_MALLOC(unsigned, n);
+  LOOP_EXEC(mark_roots, n, labels, roots);
+  unsigned* root_numbers = uints_exscan(roots, n);
+  loop_free(roots);
+  LOOP_EXEC(number_comps, n, labels, root_numbers, comp);
+  return root_numbers;
+}
+
+void connected_components_parallel(
+    unsigned n,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned* comp)
+{
+  unsigned* labels = smallest_labels(n, offsets, adj);
+  loop_free(number_roots(n, labels, comp));
+  loop_free(labels);
+}
+
+LOOP_KERNEL(seed_roots,
+    unsigned const* labels,
+    unsigned const* root_numbers,
+    unsigned* queue,
+    unsigned* layer)
+  if (labels[i] == i) {
+    queue[root_numbers[i]] = i;
+    layer[i] = 0;
+  } else {
+    layer[i] = INVALID;
+  }
+}
+
+LOOP_KERNEL(comp_of_queue,
+    unsigned const* queue,
+    unsigned const* comp,
+    unsigned long* keys)
+  keys[i] = comp[queue[i]];
+}
+
+LOOP_KERNEL(gather_queue,
+    unsigned const* queue,
+    unsigned const* order,
+    unsigned* sorted)
+  sorted[i] = queue[order[i]];
+}
+
+/* all components are searched at once from their smallest
+   vertices. each component's part of the queue is in the
+   order its own search would give, so a stable sort by
+   component gives the serial order. */
+
+void bfs_full_parallel(
+    unsigned n,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned* comp,
+    unsigned* layer,
+    unsigned* sorted)
+{
+  unsigned* own_comp = 0;
+  if (!comp)
+    comp = own_comp = LOOP_MALLOC(unsigned, n);
+  unsigned* labels = smallest_labels(n, offsets, adj);
+  unsigned* root_numbers = number_roots(n, labels, comp);
+  unsigned* queue = LOOP_MALLOC(unsigned, n);
+  LOOP_EXEC(seed_roots, n, labels, root_numbers, queue, layer);
+  unsigned begin = 0;
+  unsigned end = uints_at(root_numbers, n);
+  loop_free(labels);
+  loop_free(root_numbers);
+  bfs_continue_parallel(n, queue, &begin, &end, offsets, adj, comp, layer);
+  assert(end == n);
+  unsigned long* keys = LOOP_MALLOC(unsigned long, n);
+  LOOP_EXEC(comp_of_queue, n, queue, comp, keys);
+  unsigned* order = sort_ulongs(n, keys);
+  loop_free(keys);
+  LOOP_EXEC(gather_queue, n, queue, order, sorted);
+  loop_free(order);
+  loop_free(queue);
+  loop_free(own_comp);
+}
@@ -1,7 +1,7 @@
 #ifndef BFS_H
 #define BFS_H
 
-/* all arrays on HOST ! */
+/* all arrays on HOST ! (except the *_parallel ones) */
 
 void bfs_continue(
     unsigned* queue,
@@ -37,4 +37,33 @@ void connected_components(
     unsigned const* adj,
     unsigned* comp);
 
+/* the same as the serial versions, but all arrays are
+   on the device (e.g. the mesh_ask_star arrays as they are)
+   and the work is spread over the LOOP mechanism.
+   (n) is the number of graph vertices. */
+
+void bfs_continue_parallel(
+    unsigned n,
+    unsigned* queue,
+    unsigned* p_begin,
+    unsigned* p_end,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned* comp,
+    unsigned* layer);
+
+void bfs_full_parallel(
+    unsigned n,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned* comp,
+    unsigned* layer,
+    unsigned* sorted);
+
+void connected_components_parallel(
+    unsigned n,
+    unsigned const* offsets,
+    unsigned const* adj,
+    unsigned* comp);
+
 #endif
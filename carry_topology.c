@@ -0,0 +1,410 @@
+#include "carry_topology.h"
+
+#include "arrays.h"
+#include "dual.h"
+#include "ints.h"
+#include "loop.h"
+#include "mark.h"
+#include "mesh.h"
+#include "reflect_down.h"
+#include "star.h"
+#include "tables.h"
+#include "up_from_down.h"
+
+/* kept entities of one dimension: new numbers of old ones
+   (INVALID for those removed) and old numbers of the
+   (nkept) new ones that come first */
+
+struct carry_map {
+  unsigned nkept;
+  unsigned nents_out;
+  unsigned* old_to_new;
+  unsigned* new_to_old;
+};
+
+LOOP_KERNEL(map_kept,
+    unsigned const* offset_of_same_ents,
+    unsigned* old_to_new,
+    unsigned* new_to_old)
+  unsigned o = offset_of_same_ents[i];
+  if (o != offset_of_same_ents[i + 1]) {
+    old_to_new[i] = o;
+    new_to_old[o] = i;
+  } else {
+    old_to_new[i] = INVALID;
+  }
+}
+
+static struct carry_map make_map(struct mesh* m, struct mesh* m_out,
+    unsigned dim, unsigned const* offset_of_same_ents)
+{
+  struct carry_map map = {0, 0, 0, 0};
+  if (!offset_of_same_ents || !mesh_has_dim(m_out, dim))
+    return map;
+  unsigned nents = mesh_count(m, dim);
+  map.nkept = uints_at(offset_of_same_ents, nents);
+  map.nents_out = mesh_count(m_out, dim);
+  map.old_to_new = LOOP_MALLOC(unsigned, nents);
+  map.new_to_old = LOOP_MALLOC(unsigned, map.nkept);
+  LOOP_EXEC(map_kept, nents, offset_of_same_ents,
+      map.old_to_new, map.new_to_old);
+  return map;
+}
+
+/* a kept entity keeps all of its lows, so its row of an
+   intermediate downward adjacency is just renumbered */
+
+LOOP_KERNEL(carry_down_rows,
+    unsigned lows_per_high,
+    unsigned const* new_to_old_highs,
+    unsigned const* old_to_new_lows,
+    unsigned const* lows_of_highs,
+    unsigned* lows_of_highs_out)
+  unsigned old = new_to_old_highs[i];
+  for (unsigned j = 0; j < lows_per_high; ++j)
+    lows_of_highs_out[i * lows_per_high + j] =
+      old_to_new_lows[lows_of_highs[old * lows_per_high + j]];
+}
+
+static void carry_down(struct mesh* m, struct mesh* m_out,
+    unsigned high_dim, unsigned low_dim,
+    struct carry_map highs, struct carry_map lows)
+{
+  unsigned lows_per_high = the_down_degrees[high_dim][low_dim];
+  unsigned* lows_of_highs_out = LOOP_MALLOC(unsigned,
+      highs.nents_out * lows_per_high);
+  LOOP_EXEC(carry_down_rows, highs.nkept, lows_per_high,
+      highs.new_to_old, lows.old_to_new,
+      mesh_find_down(m, high_dim, low_dim), lows_of_highs_out);
+  unsigned* gen_lows_of_highs = mesh_reflect_down_from(m_out,
+      high_dim, low_dim, highs.nkept);
+  uints_memcpy(lows_of_highs_out + highs.nkept * lows_per_high,
+      gen_lows_of_highs, (highs.nents_out - highs.nkept) * lows_per_high);
+  loop_free(gen_lows_of_highs);
+  mesh_set_down(m_out, high_dim, low_dim, lows_of_highs_out);
+}
+
+/* an upward row lists its highs in order, and the generated
+   highs come after all kept ones, so a kept low's new row is
+   its old row without the removed highs, followed by the
+   generated highs that use it */
+
+LOOP_KERNEL(count_carried_uses,
+    unsigned nkept_lows,
+    unsigned const* new_to_old_lows,
+    unsigned const* old_offsets,
+    unsigned const* old_highs,
+    unsigned const* old_to_new_highs,
+    unsigned const* gen_offsets,
+    unsigned* degrees)
+  unsigned n = gen_offsets[i + 1] - gen_offsets[i];
+  if (i < nkept_lows) {
+    unsigned old = new_to_old_lows[i];
+    for (unsigned j = old_offsets[old]; j < old_offsets[old + 1]; ++j)
+      if (old_to_new_highs[old_highs[j]] != INVALID)
+        ++n;
+  }
+  degrees[i] = n;
+}
+
+LOOP_KERNEL(fill_carried_uses,
+    unsigned nkept_lows,
+    unsigned nkept_highs,
+    unsigned const* new_to_old_lows,
+    unsigned const* old_offsets,
+    unsigned const* old_highs,
+    unsigned const* old_directions,
+    unsigned const* old_to_new_highs,
+    unsigned const* gen_offsets,
+    unsigned const* gen_highs,
+    unsigned const* gen_directions,
+    unsigned const* offsets,
+    unsigned* highs,
+    unsigned* directions)
+  unsigned o = offsets[i];
+  if (i < nkept_lows) {
+    unsigned old = new_to_old_lows[i];
+    for (unsigned j = old_offsets[old]; j < old_offsets[old + 1]; ++j) {
+      unsigned high = old_to_new_highs[old_highs[j]];
+      if (high == INVALID)
+        continue;
+      highs[o] = high;
+      directions[o] = old_directions[j];
+      ++o;
+    }
+  }
+  for (unsigned j = gen_offsets[i]; j < gen_offsets[i + 1]; ++j) {
+    highs[o] = nkept_highs + gen_highs[j];
+    directions[o] = gen_directions[j];
+    ++o;
+  }
+}
+
+static void carry_up(struct mesh* m, struct mesh* m_out,
+    unsigned low_dim, unsigned high_dim,
+    struct carry_map lows, struct carry_map highs)
+{
+  struct const_up* old = mesh_find_up(m, low_dim, high_dim);
+  unsigned lows_per_high = the_down_degrees[high_dim][low_dim];
+  unsigned const* lows_of_highs_out = mesh_ask_down(m_out, high_dim, low_dim);
+  unsigned* gen_offsets;
+  unsigned* gen_highs;
+  unsigned* gen_directions;
+  up_from_down(high_dim, low_dim, highs.nents_out - highs.nkept,
+      lows.nents_out, lows_of_highs_out + highs.nkept * lows_per_high,
+      &gen_offsets, &gen_highs, &gen_directions);
+  unsigned* degrees = LOOP_MALLOC(unsigned, lows.nents_out);
+  LOOP_EXEC(count_carried_uses, lows.nents_out, lows.nkept,
+      lows.new_to_old, old->offsets, old->adj, highs.old_to_new,
+      gen_offsets, degrees);
+  unsigned* offsets = uints_exscan(degrees, lows.nents_out);
+  loop_free(degrees);
+  unsigned nuses = uints_at(offsets, lows.nents_out);
+  unsigned* highs_of_lows = LOOP_MALLOC(unsigned, nuses);
+  unsigned* directions = LOOP_MALLOC(unsigned, nuses);
+  LOOP_EXEC(fill_carried_uses, lows.nents_out, lows.nkept, highs.nkept,
+      lows.new_to_old, old->offsets, old->adj, old->directions,
+      highs.old_to_new, gen_offsets, gen_highs, gen_directions,
+      offsets, highs_of_lows, directions);
+  loop_free(gen_offsets);
+  loop_free(gen_highs);
+  loop_free(gen_directions);
+  mesh_set_up(m_out, low_dim, high_dim, offsets, highs_of_lows, directions);
+}
+
+/* a kept element whose neighbor was removed now has a
+   generated neighbor there, so its row is derived again
+   along with the rows of generated elements */
+
+LOOP_KERNEL(carry_dual_rows,
+    unsigned nkept_elems,
+    unsigned sides_per_elem,
+    unsigned const* new_to_old_elems,
+    unsigned const* old_to_new_elems,
+    unsigned const* dual,
+    unsigned* dual_out,
+    unsigned* dirty)
+  if (i >= nkept_elems) {
+    dirty[i] = 1;
+    return;
+  }
+  unsigned old = new_to_old_elems[i];
+  unsigned is_dirty = 0;
+  for (unsigned j = 0; j < sides_per_elem; ++j) {
+    unsigned other = dual[old * sides_per_elem + j];
+    if (other != INVALID) {
+      other = old_to_new_elems[other];
+      if (other == INVALID)
+        is_dirty = 1;
+    }
+    dual_out[i * sides_per_elem + j] = other;
+  }
+  dirty[i] = is_dirty;
+}
+
+static void carry_dual(struct mesh* m, struct mesh* m_out,
+    struct carry_map elems)
+{
+  unsigned elem_dim = mesh_dim(m);
+  unsigned sides_per_elem = the_down_degrees[elem_dim][elem_dim - 1];
+  unsigned* dual_out = LOOP_MALLOC(unsigned, elems.nents_out * sides_per_elem);
+  unsigned* dirty = LOOP_MALLOC(unsigned, elems.nents_out);
+  LOOP_EXEC(carry_dual_rows, elems.nents_out, elems.nkept, sides_per_elem,
+      elems.new_to_old, elems.old_to_new, mesh_find_dual(m),
+      dual_out, dirty);
+  unsigned nrows;
+  unsigned* rows = collect_marked(elems.nents_out, dirty, 0, &nrows);
+  loop_free(dirty);
+  struct const_up* elems_of_verts = mesh_ask_up(m_out, 0, elem_dim);
+  dual_from_verts_rows(elem_dim, nrows, rows,
+      mesh_ask_down(m_out, elem_dim, 0),
+      elems_of_verts->offsets, elems_of_verts->adj, dual_out);
+  loop_free(rows);
+  mesh_set_dual(m_out, dual_out);
+}
+
+/* a star row only changes if some element around the low
+   changed, which then has one of the low's vertices.
+   vertices around removed or generated elements are touched. */
+
+LOOP_KERNEL(mark_touched_verts,
+    unsigned nkept_verts,
+    unsigned nkept_elems,
+    unsigned const* new_to_old_verts,
+    unsigned const* old_offsets,
+    unsigned const* old_elems,
+    unsigned const* old_to_new_elems,
+    unsigned const* offsets,
+    unsigned const* elems,
+    unsigned* touched)
+  if (i >= nkept_verts) {
+    touched[i] = 1;
+    return;
+  }
+  unsigned is_touched = 0;
+  for (unsigned j = offsets[i]; j < offsets[i + 1]; ++j)
+    if (elems[j] >= nkept_elems)
+      is_touched = 1;
+  unsigned old = new_to_old_verts[i];
+  for (unsigned j = old_offsets[old]; j < old_offsets[old + 1]; ++j)
+    if (old_to_new_elems[old_elems[j]] == INVALID)
+      is_touched = 1;
+  touched[i] = is_touched;
+}
+
+LOOP_KERNEL(mark_dirty_lows,
+    unsigned nkept_lows,
+    unsigned verts_per_low,
+    unsigned const* verts_of_lows,
+    unsigned const* touched,
+    unsigned* dirty)
+  if (i >= nkept_lows) {
+    dirty[i] = 1;
+    return;
+  }
+  if (!verts_of_lows) {
+    dirty[i] = touched[i];
+    return;
+  }
+  unsigned is_dirty = 0;
+  for (unsigned j = 0; j < verts_per_low; ++j)
+    if (touched[verts_of_lows[i * verts_per_low + j]])
+      is_dirty = 1;
+  dirty[i] = is_dirty;
+}
+
+LOOP_KERNEL(count_carried_star,
+    unsigned const* dirty,
+    unsigned const* dirty_offsets,
+    unsigned const* row_offsets,
+    unsigned const* new_to_old_lows,
+    unsigned const* old_offsets,
+    unsigned* degrees)
+  if (dirty[i]) {
+    unsigned k = dirty_offsets[i];
+    degrees[i] = row_offsets[k + 1] - row_offsets[k];
+  } else {
+    unsigned old = new_to_old_lows[i];
+    degrees[i] = old_offsets[old + 1] - old_offsets[old];
+  }
+}
+
+LOOP_KERNEL(fill_carried_star,
+    unsigned const* dirty,
+    unsigned const* dirty_offsets,
+    unsigned const* row_offsets,
+    unsigned const* row_star,
+    unsigned const* new_to_old_lows,
+    unsigned const* old_to_new_lows,
+    unsigned const* old_offsets,
+    unsigned const* old_star,
+    unsigned const* offsets,
+    unsigned* star)
+  unsigned o = offsets[i];
+  if (dirty[i]) {
+    unsigned k = dirty_offsets[i];
+    for (unsigned j = row_offsets[k]; j < row_offsets[k + 1]; ++j)
+      star[o++] = row_star[j];
+  } else {
+    unsigned old = new_to_old_lows[i];
+    for (unsigned j = old_offsets[old]; j < old_offsets[old + 1]; ++j)
+      star[o++] = old_to_new_lows[old_star[j]];
+  }
+}
+
+static void carry_star(struct mesh* m, struct mesh* m_out,
+    unsigned low_dim, unsigned high_dim,
+    unsigned const* touched, struct carry_map lows)
+{
+  struct const_graph* old = mesh_find_star(m, low_dim, high_dim);
+  unsigned verts_per_low = the_down_degrees[low_dim][0];
+  unsigned* dirty = LOOP_MALLOC(unsigned, lows.nents_out);
+  LOOP_EXEC(mark_dirty_lows, lows.nents_out, lows.nkept, verts_per_low,
+      low_dim ? mesh_ask_down(m_out, low_dim, 0) : 0, touched, dirty);
+  unsigned* dirty_offsets;
+  unsigned nrows;
+  unsigned* rows = collect_marked(lows.nents_out, dirty, &dirty_offsets,
+      &nrows);
+  unsigned* row_offsets;
+  unsigned* row_star;
+  mesh_get_star_rows(m_out, low_dim, high_dim, nrows, rows,
+      &row_offsets, &row_star);
+  loop_free(rows);
+  unsigned* degrees = LOOP_MALLOC(unsigned, lows.nents_out);
+  LOOP_EXEC(count_carried_star, lows.nents_out, dirty, dirty_offsets,
+      row_offsets, lows.new_to_old, old->offsets, degrees);
+  unsigned* offsets = uints_exscan(degrees, lows.nents_out);
+  loop_free(degrees);
+  unsigned* star = LOOP_MALLOC(unsigned, uints_at(offsets, lows.nents_out));
+  LOOP_EXEC(fill_carried_star, lows.nents_out, dirty, dirty_offsets,
+      row_offsets, row_star, lows.new_to_old, lows.old_to_new,
+      old->offsets, old->adj, offsets, star);
+  loop_free(dirty);
+  loop_free(dirty_offsets);
+  loop_free(row_offsets);
+  loop_free(row_star);
+  mesh_set_star(m_out, low_dim, high_dim, offsets, star);
+}
+
+static unsigned* get_touched_verts(struct mesh* m, struct mesh* m_out,
+    struct carry_map verts, struct carry_map elems)
+{
+  unsigned elem_dim = mesh_dim(m);
+  struct const_up* old = mesh_find_up(m, 0, elem_dim);
+  struct const_up* up = mesh_ask_up(m_out, 0, elem_dim);
+  unsigned* touched = LOOP_MALLOC(unsigned, verts.nents_out);
+  LOOP_EXEC(mark_touched_verts, verts.nents_out, verts.nkept, elems.nkept,
+      verts.new_to_old, old->offsets, old->adj, elems.old_to_new,
+      up->offsets, up->adj, touched);
+  return touched;
+}
+
+void carry_topology(
+    struct mesh* m,
+    struct mesh* m_out,
+    unsigned* const offset_of_same_ents[4])
+{
+  unsigned elem_dim = mesh_dim(m);
+  struct carry_map maps[4];
+  for (unsigned d = 0; d <= elem_dim; ++d)
+    maps[d] = make_map(m, m_out, d, offset_of_same_ents[d]);
+  /* ups from vertices first, the rest is found through them */
+  for (unsigned high_dim = 1; high_dim <= elem_dim; ++high_dim)
+    if (maps[0].old_to_new && maps[high_dim].old_to_new &&
+        mesh_find_up(m, 0, high_dim))
+      carry_up(m, m_out, 0, high_dim, maps[0], maps[high_dim]);
+  for (unsigned high_dim = 2; high_dim <= elem_dim; ++high_dim)
+    for (unsigned low_dim = 1; low_dim < high_dim; ++low_dim)
+      if (maps[low_dim].old_to_new && maps[high_dim].old_to_new &&
+          mesh_find_down(m, high_dim, low_dim))
+        carry_down(m, m_out, high_dim, low_dim,
+            maps[high_dim], maps[low_dim]);
+  for (unsigned low_dim = 1; low_dim < elem_dim; ++low_dim)
+    for (unsigned high_dim = low_dim + 1; high_dim <= elem_dim; ++high_dim)
+      if (maps[low_dim].old_to_new && maps[high_dim].old_to_new &&
+          mesh_find_down(m_out, high_dim, low_dim) &&
+          mesh_find_up(m, low_dim, high_dim))
+        carry_up(m, m_out, low_dim, high_dim,
+            maps[low_dim], maps[high_dim]);
+  if (maps[0].old_to_new && maps[elem_dim].old_to_new) {
+    if (mesh_find_dual(m))
+      carry_dual(m, m_out, maps[elem_dim]);
+    unsigned* touched = 0;
+    for (unsigned low_dim = 0; low_dim < elem_dim; ++low_dim)
+      for (unsigned high_dim = low_dim + 1; high_dim <= elem_dim; ++high_dim)
+        if (maps[low_dim].old_to_new &&
+            mesh_find_star(m, low_dim, high_dim) &&
+            mesh_find_up(m, 0, elem_dim) &&
+            mesh_star_method(m, low_dim, high_dim) ==
+            mesh_star_method(m_out, low_dim, high_dim)) {
+          if (!touched)
+            touched = get_touched_verts(m, m_out, maps[0], maps[elem_dim]);
+          carry_star(m, m_out, low_dim, high_dim, touched, maps[low_dim]);
+        }
+    loop_free(touched);
+  }
+  for (unsigned d = 0; d <= elem_dim; ++d) {
+    loop_free(maps[d].old_to_new);
+    loop_free(maps[d].new_to_old);
+  }
+}
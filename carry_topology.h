@@ -0,0 +1,23 @@
+#ifndef CARRY_TOPOLOGY_H
+#define CARRY_TOPOLOGY_H
+
+struct mesh;
+
+/* after a modification builds (m_out) from (m), this carries over
+ * the adjacency (m) had derived: ups, intermediate downs, the dual
+ * and stars. the modification must number the entities it kept
+ * first, in their old order, followed by the ones it generated.
+ * (offset_of_same_ents[d]) is the exscan of which entities of
+ * dimension (d) were kept, or null if that dimension was rebuilt
+ * some other way.
+ * rows of kept entities are copied and renumbered, and only the
+ * rows that touch generated entities are derived, so each array
+ * comes out the same as if it were derived on (m_out) from scratch.
+ */
+
+void carry_topology(
+    struct mesh* m,
+    struct mesh* m_out,
+    unsigned* const offset_of_same_ents[4]);
+
+#endif
@@ -1,5 +1,6 @@
 #include "coarsen.h"
 
+#include "adapt_region.h"
 #include "coarsen_common.h"
 #include "collapse_codes.h"
 #include "ghost_mesh.h"
@@ -7,6 +8,7 @@
 #include "mark.h"
 #include "mesh.h"
 #include "size.h"
+#include "trace.h"
 
 LOOP_KERNEL(coarsen_size_code,
     double const* edge_sizes,
@@ -23,6 +25,7 @@ unsigned coarsen_by_size(
     double quality_floor,
     double size_ratio_floor)
 {
+  trace_begin("coarsen_by_size");
   unsigned nedges = mesh_count(m, 1);
   double* edge_sizes = mesh_measure_edges_for_adapt(m);
   unsigned* col_codes = LOOP_MALLOC(unsigned, nedges);
@@ -30,7 +33,9 @@ unsigned coarsen_by_size(
       edge_sizes, size_ratio_floor, col_codes);
   loop_free(edge_sizes);
   mesh_add_tag(m, 1, TAG_U32, "col_codes", 1, col_codes);
-  return coarsen_common(m, quality_floor, 0);
+  unsigned ret = coarsen_common(m, quality_floor, 0);
+  trace_end();
+  return ret;
 }
 
 LOOP_KERNEL(coarsen_sliver_code,
@@ -57,6 +62,7 @@ unsigned coarsen_slivers(
   unsigned* slivers = mesh_mark_slivers(m, quality_floor, nlayers);
   unsigned* marked_verts = mesh_mark_down(m, elem_dim, 0, slivers);
   loop_free(slivers);
+  mesh_mask_to_region(m, 0, marked_verts);
   unsigned nedges = mesh_count(m, 1);
   unsigned const* verts_of_edges = mesh_ask_down(m, 1, 0);
   unsigned* col_codes = LOOP_MALLOC(unsigned, nedges);
@@ -2,7 +2,9 @@
 
 #include <stdio.h>
 
+#include "adapt_region.h"
 #include "arrays.h"
+#include "carry_topology.h"
 #include "check_collapse_class.h"
 #include "coarsen_conserve.h"
 #include "coarsen_fit.h"
@@ -38,7 +40,8 @@ static void coarsen_ents(
     unsigned const* gen_vert_of_verts,
     unsigned const* offset_of_same_verts,
     unsigned const* fused_ents,
-    unsigned** p_fused_sides)
+    unsigned** p_fused_sides,
+    unsigned** p_offset_of_same_ents)
 {
   unsigned nents = mesh_count(m, ent_dim);
   unsigned const* verts_of_ents = mesh_ask_down(m, ent_dim, 0);
@@ -83,7 +86,7 @@ static void coarsen_ents(
         offset_of_same_ents);
   }
   loop_free(gen_offset_of_ents);
-  loop_free(offset_of_same_ents);
+  *p_offset_of_same_ents = offset_of_same_ents;
 }
 
 static void coarsen_all_ents(
@@ -91,36 +94,28 @@ static void coarsen_all_ents(
     struct mesh* m_out,
     unsigned const* gen_offset_of_verts,
     unsigned const* gen_vert_of_verts,
-    unsigned const* offset_of_same_verts)
+    unsigned const* offset_of_same_verts,
+    unsigned* offset_of_same_ents[4])
 {
   unsigned* fused_sides[4] = {0};
   for (unsigned dd = 0; dd < mesh_dim(m); ++dd) {
     unsigned d = mesh_dim(m) - dd;
     coarsen_ents(m, m_out, d, gen_offset_of_verts,
         gen_vert_of_verts, offset_of_same_verts,
-        fused_sides[d], &fused_sides[d - 1]);
+        fused_sides[d], &fused_sides[d - 1], &offset_of_same_ents[d]);
   }
   for (unsigned d = 0; d <= mesh_dim(m); ++d)
     loop_free(fused_sides[d]);
 }
 
-static unsigned check_coarsen_noop(struct mesh* m)
-{
-  unsigned nedges = mesh_count(m, 1);
-  unsigned const* col_codes = mesh_find_tag(m, 1, "col_codes")->d.u32;
-  if (comm_max_uint(uints_max(col_codes, nedges)) == DONT_COLLAPSE) {
-    mesh_free_tag(m, 1, "col_codes");
-    return 0;
-  }
-  return 1;
-}
-
 static unsigned check_coarsen_class(struct mesh* m)
 {
   /* right now this assumes we're doing the simple
      check_collapse_class that only looks at the edge
      closure classification. if it gets more advanced,
-     add ghosting and synchronization to this function */
+     add ghosting and synchronization to this function.
+     it only ever removes collapses, so its one global
+     check also covers the case of nothing to begin with */
   unsigned const* col_codes_in = mesh_find_tag(m, 1, "col_codes")->d.u32;
   unsigned nedges = mesh_count(m, 1);
   unsigned* col_codes = uints_copy(col_codes_in, nedges);
@@ -164,13 +159,16 @@ static unsigned check_coarsen_quality(
       elems_of_verts_offsets, elems_of_verts, elems_of_verts_directions,
       coords, quality_floor, elem_quals);
   loop_free(elem_quals);
-  mesh_conform_uints(m, 1, 1, &col_codes);
+  void* conformed[2] = {col_codes, quals_of_edges};
+  unsigned const nbytes[2] = {sizeof(unsigned), 2 * sizeof(double)};
+  mesh_conform_many(m, 1, 2, nbytes, conformed);
+  col_codes = conformed[0];
+  quals_of_edges = conformed[1];
   if (comm_max_uint(uints_max(col_codes, nedges)) == DONT_COLLAPSE) {
     loop_free(col_codes);
     loop_free(quals_of_edges);
     return 0;
   }
-  mesh_conform_doubles(m, 1, 2, &quals_of_edges);
   mesh_add_tag(m, 1, TAG_U32, "col_codes", 1, col_codes);
   mesh_add_tag(m, 1, TAG_F64, "col_quals", 2, quals_of_edges);
   return 1;
@@ -195,7 +193,7 @@ static void coarsen_interior(struct mesh* m)
   mesh_free_tag(m, 1, "col_quals");
   mesh_free_tag(m, 0, "col_qual");
   unsigned const* indset = mesh_find_tag(m, 0, "indset")->d.u32;
-  unsigned long total = comm_add_ulong(uints_sum(indset, nverts));
+  unsigned long total = indset_size();
   unsigned* gen_offset_of_verts = uints_exscan(indset, nverts);
   mesh_free_tag(m, 0, "indset");
   unsigned* offset_of_same_verts = uints_negate_offsets(
@@ -203,26 +201,30 @@ static void coarsen_interior(struct mesh* m)
   unsigned nverts_out = uints_at(offset_of_same_verts, nverts);
   struct mesh* m_out = new_mesh(elem_dim, mesh_get_rep(m), mesh_is_parallel(m));
   mesh_set_ents(m_out, 0, nverts_out, 0);
-  tags_subset(m, m_out, 0, offset_of_same_verts);
+  adopt_tags_subset(m, m_out, 0, offset_of_same_verts);
   if (mesh_is_parallel(m))
     inherit_globals(m, m_out, 0, offset_of_same_verts);
+  unsigned* offset_of_same_ents[4] = {0};
   coarsen_all_ents(m, m_out, gen_offset_of_verts, gen_vert_of_verts,
-      offset_of_same_verts);
+      offset_of_same_verts, offset_of_same_ents);
   loop_free(gen_vert_of_verts);
   loop_free(gen_offset_of_verts);
-  loop_free(offset_of_same_verts);
+  offset_of_same_ents[0] = offset_of_same_verts;
+  carry_topology(m, m_out, offset_of_same_ents);
+  mesh_grow_region(m, m_out, offset_of_same_ents);
+  for (unsigned d = 0; d <= elem_dim; ++d)
+    loop_free(offset_of_same_ents[d]);
   if (comm_rank() == 0)
-    printf("collapsed %10lu %s\n", total, get_ent_name(1, total));
+    printf("collapsed %10lu %s (independent set in %u iterations)\n",
+        total, get_ent_name(1, total), indset_iterations());
   overwrite_mesh(m, m_out);
 }
 
-unsigned coarsen_common(
+static unsigned coarsen_pass(
     struct mesh* m,
     double quality_floor,
     unsigned require_better)
 {
-  if (!check_coarsen_noop(m))
-    return 0;
   if (!check_coarsen_class(m))
     return 0;
   if (!check_coarsen_quality(m, quality_floor, require_better))
@@ -235,3 +237,18 @@ unsigned coarsen_common(
   coarsen_interior(m);
   return 1;
 }
+
+/* the temporaries of a pass are charged to the adapt category */
+
+unsigned coarsen_common(
+    struct mesh* m,
+    double quality_floor,
+    unsigned require_better)
+{
+  loop_host_phase_begin("coarsen");
+  enum mem_category cat = loop_host_set_category(MEM_ADAPT);
+  unsigned ret = coarsen_pass(m, quality_floor, require_better);
+  loop_host_set_category(cat);
+  loop_host_phase_end();
+  return ret;
+}
@@ -4,9 +4,41 @@
 
 #include "loop.h"
 
+/* each deferred variable is one slot of a single buffer,
+   tagged with how to combine it, so that one collective
+   with a custom operation resolves all of them */
+
+enum reduce_kind {
+  ADD_ULONG,
+  MAX_ULONG,
+  MAX_UINT,
+  ADD_DOUBLE,
+  MIN_DOUBLE,
+  MAX_DOUBLE
+};
+
+struct reduce_slot {
+  unsigned kind;
+  int padding__;
+  union {
+    unsigned long u;
+    double d;
+  } v;
+};
+
+#define MAX_DEFERRED 16
+
+struct comm_reduction {
+  unsigned n;
+  int padding__;
+  void* vars[MAX_DEFERRED];
+  struct reduce_slot slots[MAX_DEFERRED];
+};
+
 #if USE_MPI
 
 #include "compat_mpi.h"
+#include "trace.h"
 
 static struct comm world = { MPI_COMM_WORLD };
 static struct comm self = { MPI_COMM_SELF };
@@ -14,6 +46,10 @@ static struct comm* using = &world;
 
 static int we_called_mpi_init = 0;
 
+static MPI_Datatype slot_type;
+static MPI_Op slot_op;
+static int made_slot_op = 0;
+
 void comm_init(void)
 {
   int was_initialized;
@@ -26,6 +62,11 @@ void comm_init(void)
 
 void comm_fini(void)
 {
+  if (made_slot_op) {
+    CALL(MPI_Op_free(&slot_op));
+    CALL(MPI_Type_free(&slot_type));
+    made_slot_op = 0;
+  }
   if (we_called_mpi_init) {
     CALL(MPI_Finalize());
     we_called_mpi_init = 0;
@@ -137,6 +178,14 @@ void comm_recvs(struct comm* c,
   loop_host_free(destweights);
 }
 
+static int* scale_counts(unsigned n, unsigned const* a, unsigned width)
+{
+  int* out = LOOP_HOST_MALLOC(int, n);
+  for (unsigned i = 0; i < n; ++i)
+    out[i] = (int) (a[i] * width);
+  return out;
+}
+
 static void comm_exch_any(struct comm* c,
     unsigned width,
     void const* out, unsigned const* outcounts, unsigned const* outoffsets,
@@ -145,26 +194,135 @@ static void comm_exch_any(struct comm* c,
 {
   int indegree, outdegree, weighted;
   CALL(MPI_Dist_graph_neighbors_count(c->c, &indegree, &outdegree, &weighted));
-  int* sendcounts = LOOP_HOST_MALLOC(int, (unsigned) outdegree);
-  int* sdispls = LOOP_HOST_MALLOC(int, (unsigned) outdegree);
-  for (int i = 0; i < outdegree; ++i) {
-    sendcounts[i] = (int) (outcounts[i] * width);
-    sdispls[i] = (int) (outoffsets[i] * width);
-  }
-  int* recvcounts = LOOP_HOST_MALLOC(int, (unsigned) indegree);
-  int* rdispls = LOOP_HOST_MALLOC(int, (unsigned) indegree);
-  for (int i = 0; i < indegree; ++i) {
-    recvcounts[i] = (int) (incounts[i] * width);
-    rdispls[i] = (int) (inoffsets[i] * width);
-  }
+  int* sendcounts = scale_counts((unsigned) outdegree, outcounts, width);
+  int* sdispls = scale_counts((unsigned) outdegree, outoffsets, width);
+  int* recvcounts = scale_counts((unsigned) indegree, incounts, width);
+  int* rdispls = scale_counts((unsigned) indegree, inoffsets, width);
+  trace_begin("comm_exch");
   CALL(compat_Neighbor_alltoallv(out, sendcounts, sdispls, type,
         in, recvcounts, rdispls, type, c->c));
+  trace_end();
   loop_host_free(sendcounts);
   loop_host_free(sdispls);
   loop_host_free(recvcounts);
   loop_host_free(rdispls);
 }
 
+/* the count arrays given to a non-blocking
+   collective have to live until it completes */
+
+struct comm_req {
+  int* sendcounts;
+  int* sdispls;
+  int* recvcounts;
+  int* rdispls;
+  MPI_Request* reqs;
+  int nreqs;
+  int padding__;
+};
+
+static struct comm_req* comm_iexch_any(struct comm* c,
+    unsigned width,
+    void const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    void* in, unsigned const* incounts, unsigned const* inoffsets,
+    MPI_Datatype type)
+{
+  int indegree, outdegree, weighted;
+  CALL(MPI_Dist_graph_neighbors_count(c->c, &indegree, &outdegree, &weighted));
+  struct comm_req* r = LOOP_HOST_MALLOC(struct comm_req, 1);
+  r->sendcounts = scale_counts((unsigned) outdegree, outcounts, width);
+  r->sdispls = scale_counts((unsigned) outdegree, outoffsets, width);
+  r->recvcounts = scale_counts((unsigned) indegree, incounts, width);
+  r->rdispls = scale_counts((unsigned) indegree, inoffsets, width);
+  CALL(compat_Ineighbor_alltoallv(out, r->sendcounts, r->sdispls, type,
+        in, r->recvcounts, r->rdispls, type, c->c, &r->nreqs, &r->reqs));
+  return r;
+}
+
+void comm_wait(struct comm_req* r)
+{
+  trace_begin("comm_wait");
+  CALL(MPI_Waitall(r->nreqs, r->reqs, MPI_STATUSES_IGNORE));
+  trace_end();
+  loop_host_free(r->reqs);
+  loop_host_free(r->sendcounts);
+  loop_host_free(r->sdispls);
+  loop_host_free(r->recvcounts);
+  loop_host_free(r->rdispls);
+  loop_host_free(r);
+}
+
+#define GENERIC_IEXCH(T, name, type) \
+struct comm_req* comm_iexch_##name(struct comm* c, \
+    unsigned width, \
+    T const* out, unsigned const* outcounts, unsigned const* outoffsets, \
+    T* in, unsigned const* incounts, unsigned const* inoffsets) \
+{ \
+  return comm_iexch_any(c, width, out, outcounts, outoffsets, \
+      in, incounts, inoffsets, type); \
+}
+
+GENERIC_IEXCH(unsigned, uints, MPI_UNSIGNED)
+GENERIC_IEXCH(double, doubles, MPI_DOUBLE)
+GENERIC_IEXCH(unsigned long, ulongs, MPI_UNSIGNED_LONG)
+GENERIC_IEXCH(unsigned char, uchars, MPI_BYTE)
+
+/* a persistent exchange between fixed buffers,
+   started and completed any number of times */
+
+struct comm_plan {
+  int* sendcounts;
+  int* sdispls;
+  int* recvcounts;
+  int* rdispls;
+  MPI_Request* reqs;
+  int nreqs;
+  int padding__;
+};
+
+struct comm_plan* comm_plan_uchars(struct comm* c,
+    unsigned width,
+    unsigned char const* out, unsigned const* outcounts,
+    unsigned const* outoffsets,
+    unsigned char* in, unsigned const* incounts, unsigned const* inoffsets)
+{
+  int indegree, outdegree, weighted;
+  CALL(MPI_Dist_graph_neighbors_count(c->c, &indegree, &outdegree, &weighted));
+  struct comm_plan* p = LOOP_HOST_MALLOC(struct comm_plan, 1);
+  p->sendcounts = scale_counts((unsigned) outdegree, outcounts, width);
+  p->sdispls = scale_counts((unsigned) outdegree, outoffsets, width);
+  p->recvcounts = scale_counts((unsigned) indegree, incounts, width);
+  p->rdispls = scale_counts((unsigned) indegree, inoffsets, width);
+  CALL(compat_Neighbor_alltoallv_init(out, p->sendcounts, p->sdispls,
+        MPI_BYTE, in, p->recvcounts, p->rdispls, MPI_BYTE, c->c,
+        &p->nreqs, &p->reqs));
+  return p;
+}
+
+void comm_plan_start(struct comm_plan* p)
+{
+  CALL(MPI_Startall(p->nreqs, p->reqs));
+}
+
+void comm_plan_wait(struct comm_plan* p)
+{
+  trace_begin("comm_plan_wait");
+  CALL(MPI_Waitall(p->nreqs, p->reqs, MPI_STATUSES_IGNORE));
+  trace_end();
+}
+
+void comm_plan_free(struct comm_plan* p)
+{
+  for (int i = 0; i < p->nreqs; ++i)
+    CALL(MPI_Request_free(p->reqs + i));
+  loop_host_free(p->reqs);
+  loop_host_free(p->sendcounts);
+  loop_host_free(p->sdispls);
+  loop_host_free(p->recvcounts);
+  loop_host_free(p->rdispls);
+  loop_host_free(p);
+}
+
 void comm_exch_uints(struct comm* c,
     unsigned width,
     unsigned const* out, unsigned const* outcounts, unsigned const* outoffsets,
@@ -192,6 +350,15 @@ void comm_exch_ulongs(struct comm* c,
       MPI_UNSIGNED_LONG);
 }
 
+void comm_exch_uchars(struct comm* c,
+    unsigned width,
+    unsigned char const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    unsigned char* in, unsigned const* incounts, unsigned const* inoffsets)
+{
+  comm_exch_any(c, width, out, outcounts, outoffsets, in, incounts, inoffsets,
+      MPI_BYTE);
+}
+
 static void comm_sync_any(struct comm* c, void const* out, void* in, MPI_Datatype type)
 {
   CALL(compat_Neighbor_allgather(out, 1, type, in, 1, type, c->c));
@@ -282,6 +449,75 @@ unsigned comm_max_uint(unsigned x)
   return x;
 }
 
+static void combine_slots(void* in, void* inout, int* len,
+    MPI_Datatype* type)
+{
+  (void) type;
+  struct reduce_slot const* a = in;
+  struct reduce_slot* b = inout;
+  for (int i = 0; i < *len; ++i)
+    switch (b[i].kind) {
+      case ADD_ULONG:
+        b[i].v.u += a[i].v.u;
+        break;
+      case MAX_ULONG:
+      case MAX_UINT:
+        if (a[i].v.u > b[i].v.u)
+          b[i].v.u = a[i].v.u;
+        break;
+      case ADD_DOUBLE:
+        b[i].v.d += a[i].v.d;
+        break;
+      case MIN_DOUBLE:
+        if (a[i].v.d < b[i].v.d)
+          b[i].v.d = a[i].v.d;
+        break;
+      case MAX_DOUBLE:
+        if (a[i].v.d > b[i].v.d)
+          b[i].v.d = a[i].v.d;
+        break;
+    }
+}
+
+void comm_reduce(struct comm_reduction* r)
+{
+  if (!r->n)
+    return;
+  if (!made_slot_op) {
+    CALL(MPI_Type_contiguous((int) sizeof(struct reduce_slot), MPI_BYTE,
+          &slot_type));
+    CALL(MPI_Type_commit(&slot_type));
+    CALL(MPI_Op_create(combine_slots, 1, &slot_op));
+    made_slot_op = 1;
+  }
+  for (unsigned i = 0; i < r->n; ++i)
+    switch (r->slots[i].kind) {
+      case MAX_UINT:
+        r->slots[i].v.u = *((unsigned*) r->vars[i]);
+        break;
+      case ADD_ULONG:
+      case MAX_ULONG:
+        r->slots[i].v.u = *((unsigned long*) r->vars[i]);
+        break;
+      default:
+        r->slots[i].v.d = *((double*) r->vars[i]);
+    }
+  CALL(MPI_Allreduce(MPI_IN_PLACE, r->slots, (int) r->n, slot_type, slot_op,
+        using->c));
+  for (unsigned i = 0; i < r->n; ++i)
+    switch (r->slots[i].kind) {
+      case MAX_UINT:
+        *((unsigned*) r->vars[i]) = (unsigned) r->slots[i].v.u;
+        break;
+      case ADD_ULONG:
+      case MAX_ULONG:
+        *((unsigned long*) r->vars[i]) = r->slots[i].v.u;
+        break;
+      default:
+        *((double*) r->vars[i]) = r->slots[i].v.d;
+    }
+}
+
 #else
 
 void comm_init(void)
@@ -415,6 +651,82 @@ void comm_exch_ulongs(struct comm* c,
   GENERIC_EXCH
 }
 
+void comm_exch_uchars(struct comm* c,
+    unsigned width,
+    unsigned char const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    unsigned char* in, unsigned const* incounts, unsigned const* inoffsets)
+{
+  GENERIC_EXCH
+}
+
+/* there is nothing to overlap in serial,
+   the exchange is done right away */
+
+#define GENERIC_IEXCH(T, name) \
+struct comm_req* comm_iexch_##name(struct comm* c, \
+    unsigned width, \
+    T const* out, unsigned const* outcounts, unsigned const* outoffsets, \
+    T* in, unsigned const* incounts, unsigned const* inoffsets) \
+{ \
+  comm_exch_##name(c, width, out, outcounts, outoffsets, \
+      in, incounts, inoffsets); \
+  return 0; \
+}
+
+GENERIC_IEXCH(unsigned, uints)
+GENERIC_IEXCH(double, doubles)
+GENERIC_IEXCH(unsigned long, ulongs)
+GENERIC_IEXCH(unsigned char, uchars)
+
+void comm_wait(struct comm_req* r)
+{
+  (void) r;
+}
+
+struct comm_plan {
+  unsigned char const* out;
+  unsigned char* in;
+  unsigned nbytes;
+  int padding__;
+};
+
+struct comm_plan* comm_plan_uchars(struct comm* c,
+    unsigned width,
+    unsigned char const* out, unsigned const* outcounts,
+    unsigned const* outoffsets,
+    unsigned char* in, unsigned const* incounts, unsigned const* inoffsets)
+{
+  (void) outoffsets;
+  (void) inoffsets;
+  struct graph_comm* gc = (struct graph_comm*) c;
+  struct comm_plan* p = LOOP_HOST_MALLOC(struct comm_plan, 1);
+  p->out = out;
+  p->in = in;
+  p->nbytes = 0;
+  if (gc->nout == 1) {
+    assert(outcounts[0] == incounts[0]);
+    p->nbytes = outcounts[0] * width;
+  } else
+    assert(gc->nout == 0);
+  return p;
+}
+
+void comm_plan_start(struct comm_plan* p)
+{
+  for (unsigned i = 0; i < p->nbytes; ++i)
+    p->in[i] = p->out[i];
+}
+
+void comm_plan_wait(struct comm_plan* p)
+{
+  (void) p;
+}
+
+void comm_plan_free(struct comm_plan* p)
+{
+  loop_host_free(p);
+}
+
 void comm_sync_uint(struct comm* c, unsigned out, unsigned* in)
 {
   struct graph_comm* gc = (struct graph_comm*) c;
@@ -485,6 +797,11 @@ unsigned comm_max_uint(unsigned x)
   return x;
 }
 
+void comm_reduce(struct comm_reduction* r)
+{
+  (void) r;
+}
+
 #endif
 
 double comm_add_double(double x)
@@ -493,3 +810,53 @@ double comm_add_double(double x)
   comm_add_doubles(a, 1);
   return a[0];
 }
+
+struct comm_reduction* comm_new_reduction(void)
+{
+  struct comm_reduction* r = LOOP_HOST_MALLOC(struct comm_reduction, 1);
+  r->n = 0;
+  return r;
+}
+
+static void defer(struct comm_reduction* r, void* p, enum reduce_kind kind)
+{
+  assert(r->n < MAX_DEFERRED);
+  r->vars[r->n] = p;
+  r->slots[r->n].kind = kind;
+  ++r->n;
+}
+
+void comm_defer_add_ulong(struct comm_reduction* r, unsigned long* p)
+{
+  defer(r, p, ADD_ULONG);
+}
+
+void comm_defer_max_ulong(struct comm_reduction* r, unsigned long* p)
+{
+  defer(r, p, MAX_ULONG);
+}
+
+void comm_defer_max_uint(struct comm_reduction* r, unsigned* p)
+{
+  defer(r, p, MAX_UINT);
+}
+
+void comm_defer_add_double(struct comm_reduction* r, double* p)
+{
+  defer(r, p, ADD_DOUBLE);
+}
+
+void comm_defer_min_double(struct comm_reduction* r, double* p)
+{
+  defer(r, p, MIN_DOUBLE);
+}
+
+void comm_defer_max_double(struct comm_reduction* r, double* p)
+{
+  defer(r, p, MAX_DOUBLE);
+}
+
+void comm_free_reduction(struct comm_reduction* r)
+{
+  loop_host_free(r);
+}
@@ -2,6 +2,8 @@
 #define COMM_H
 
 struct comm;
+struct comm_req;
+struct comm_plan;
 
 void comm_init(void);
 void comm_fini(void);
@@ -33,6 +35,42 @@ void comm_exch_ulongs(struct comm* c,
     unsigned width,
     unsigned long const* out, unsigned const* outcounts, unsigned const* outoffsets,
     unsigned long* in, unsigned const* incounts, unsigned const* inoffsets);
+void comm_exch_uchars(struct comm* c,
+    unsigned width,
+    unsigned char const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    unsigned char* in, unsigned const* incounts, unsigned const* inoffsets);
+
+/* non-blocking versions of comm_exch_*:
+   neither buffer may be touched until comm_wait
+   is called on the returned request */
+struct comm_req* comm_iexch_uints(struct comm* c,
+    unsigned width,
+    unsigned const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    unsigned* in, unsigned const* incounts, unsigned const* inoffsets);
+struct comm_req* comm_iexch_doubles(struct comm* c,
+    unsigned width,
+    double const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    double* in, unsigned const* incounts, unsigned const* inoffsets);
+struct comm_req* comm_iexch_ulongs(struct comm* c,
+    unsigned width,
+    unsigned long const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    unsigned long* in, unsigned const* incounts, unsigned const* inoffsets);
+struct comm_req* comm_iexch_uchars(struct comm* c,
+    unsigned width,
+    unsigned char const* out, unsigned const* outcounts, unsigned const* outoffsets,
+    unsigned char* in, unsigned const* incounts, unsigned const* inoffsets);
+void comm_wait(struct comm_req* r);
+
+/* persistent exchanges: the buffers are bound once, then
+   each start/wait pair moves their current contents */
+struct comm_plan* comm_plan_uchars(struct comm* c,
+    unsigned width,
+    unsigned char const* out, unsigned const* outcounts,
+    unsigned const* outoffsets,
+    unsigned char* in, unsigned const* incounts, unsigned const* inoffsets);
+void comm_plan_start(struct comm_plan* p);
+void comm_plan_wait(struct comm_plan* p);
+void comm_plan_free(struct comm_plan* p);
 
 void comm_sync_uint(struct comm* c, unsigned out, unsigned* in);
 unsigned comm_bcast_uint(unsigned x);
@@ -52,4 +90,21 @@ unsigned long comm_exscan_ulong(unsigned long x);
 unsigned long comm_max_ulong(unsigned long x);
 unsigned comm_max_uint(unsigned x);
 
+/* deferred reductions: any number of scalar reductions
+   are registered by the address of a variable holding the
+   local value, then comm_reduce combines all of them in a
+   single collective and overwrites each variable with the
+   global value. the registrations stay, so the same
+   struct can be reduced again after the variables change. */
+struct comm_reduction;
+struct comm_reduction* comm_new_reduction(void);
+void comm_defer_add_ulong(struct comm_reduction* r, unsigned long* p);
+void comm_defer_max_ulong(struct comm_reduction* r, unsigned long* p);
+void comm_defer_max_uint(struct comm_reduction* r, unsigned* p);
+void comm_defer_add_double(struct comm_reduction* r, double* p);
+void comm_defer_min_double(struct comm_reduction* r, double* p);
+void comm_defer_max_double(struct comm_reduction* r, double* p);
+void comm_reduce(struct comm_reduction* r);
+void comm_free_reduction(struct comm_reduction* r);
+
 #endif
@@ -23,6 +23,25 @@ int compat_Neighbor_alltoallv(
       recvbuf, recvcounts, rdispls, recvtype, comm);
 }
 
+int compat_Ineighbor_alltoallv(
+    const void *sendbuf,
+    const int sendcounts[],
+    const int sdispls[],
+    MPI_Datatype sendtype,
+    void *recvbuf,
+    const int recvcounts[],
+    const int rdispls[],
+    MPI_Datatype recvtype,
+    MPI_Comm comm,
+    int* nrequests,
+    MPI_Request** requests)
+{
+  *nrequests = 1;
+  *requests = LOOP_HOST_MALLOC(MPI_Request, 1);
+  return MPI_Ineighbor_alltoallv(sendbuf, sendcounts, sdispls, sendtype,
+      recvbuf, recvcounts, rdispls, recvtype, comm, *requests);
+}
+
 int compat_Neighbor_allgather(
     const void *sendbuf,
     int sendcount,
@@ -89,6 +108,51 @@ int compat_Neighbor_alltoallv(
   return MPI_SUCCESS;
 }
 
+int compat_Ineighbor_alltoallv(
+    const void *sendbuf,
+    const int sendcounts[],
+    const int sdispls[],
+    MPI_Datatype sendtype,
+    void *recvbuf,
+    const int recvcounts[],
+    const int rdispls[],
+    MPI_Datatype recvtype,
+    MPI_Comm comm,
+    int* nrequests,
+    MPI_Request** requests)
+{
+  int indegree, outdegree, weighted;
+  CALL(MPI_Dist_graph_neighbors_count(comm, &indegree, &outdegree, &weighted));
+  int* sources = LOOP_HOST_MALLOC(int, (unsigned) indegree);
+  int* sourceweights = LOOP_HOST_MALLOC(int, (unsigned) indegree);
+  int* destinations = LOOP_HOST_MALLOC(int, (unsigned) outdegree);
+  int* destweights = LOOP_HOST_MALLOC(int, (unsigned) outdegree);
+  CALL(MPI_Dist_graph_neighbors(comm, indegree, sources, sourceweights,
+        outdegree, destinations, destweights));
+  loop_host_free(sourceweights);
+  loop_host_free(destweights);
+  int sendwidth;
+  CALL(MPI_Type_size(sendtype, &sendwidth));
+  int recvwidth;
+  CALL(MPI_Type_size(recvtype, &recvwidth));
+  /* no barrier here, the caller is meant to keep working */
+  MPI_Request* reqs = LOOP_HOST_MALLOC(MPI_Request,
+      (unsigned) (indegree + outdegree));
+  for (int i = 0; i < indegree; ++i)
+    CALL(MPI_Irecv(((char*)recvbuf) + rdispls[i] * recvwidth,
+          recvcounts[i], recvtype, sources[i], MY_TAG, comm,
+          reqs + i));
+  loop_host_free(sources);
+  for (int i = 0; i < outdegree; ++i)
+    CALL(MPI_Isend(((char const*)sendbuf) + sdispls[i] * sendwidth,
+          sendcounts[i], sendtype, destinations[i], MY_TAG, comm,
+          reqs + indegree + i));
+  loop_host_free(destinations);
+  *nrequests = indegree + outdegree;
+  *requests = reqs;
+  return MPI_SUCCESS;
+}
+
 int compat_Neighbor_allgather(
     const void *sendbuf,
     int sendcount,
@@ -131,3 +195,79 @@ int compat_Neighbor_allgather(
 }
 
 #endif
+
+/* persistent neighbor collectives came with MPI 4.
+   before that, persistent point-to-point requests
+   give the same reuse of matching and setup. */
+
+#if MPI_VERSION >= 4 && USE_MPI3
+
+int compat_Neighbor_alltoallv_init(
+    const void *sendbuf,
+    const int sendcounts[],
+    const int sdispls[],
+    MPI_Datatype sendtype,
+    void *recvbuf,
+    const int recvcounts[],
+    const int rdispls[],
+    MPI_Datatype recvtype,
+    MPI_Comm comm,
+    int* nrequests,
+    MPI_Request** requests)
+{
+  *nrequests = 1;
+  *requests = LOOP_HOST_MALLOC(MPI_Request, 1);
+  return MPI_Neighbor_alltoallv_init(sendbuf, sendcounts, sdispls, sendtype,
+      recvbuf, recvcounts, rdispls, recvtype, comm, MPI_INFO_NULL,
+      *requests);
+}
+
+#else
+
+#define PLAN_TAG 43
+
+int compat_Neighbor_alltoallv_init(
+    const void *sendbuf,
+    const int sendcounts[],
+    const int sdispls[],
+    MPI_Datatype sendtype,
+    void *recvbuf,
+    const int recvcounts[],
+    const int rdispls[],
+    MPI_Datatype recvtype,
+    MPI_Comm comm,
+    int* nrequests,
+    MPI_Request** requests)
+{
+  int indegree, outdegree, weighted;
+  CALL(MPI_Dist_graph_neighbors_count(comm, &indegree, &outdegree, &weighted));
+  int* sources = LOOP_HOST_MALLOC(int, (unsigned) indegree);
+  int* sourceweights = LOOP_HOST_MALLOC(int, (unsigned) indegree);
+  int* destinations = LOOP_HOST_MALLOC(int, (unsigned) outdegree);
+  int* destweights = LOOP_HOST_MALLOC(int, (unsigned) outdegree);
+  CALL(MPI_Dist_graph_neighbors(comm, indegree, sources, sourceweights,
+        outdegree, destinations, destweights));
+  loop_host_free(sourceweights);
+  loop_host_free(destweights);
+  int sendwidth;
+  CALL(MPI_Type_size(sendtype, &sendwidth));
+  int recvwidth;
+  CALL(MPI_Type_size(recvtype, &recvwidth));
+  MPI_Request* reqs = LOOP_HOST_MALLOC(MPI_Request,
+      (unsigned) (indegree + outdegree));
+  for (int i = 0; i < indegree; ++i)
+    CALL(MPI_Recv_init(((char*)recvbuf) + rdispls[i] * recvwidth,
+          recvcounts[i], recvtype, sources[i], PLAN_TAG, comm,
+          reqs + i));
+  loop_host_free(sources);
+  for (int i = 0; i < outdegree; ++i)
+    CALL(MPI_Send_init(((char const*)sendbuf) + sdispls[i] * sendwidth,
+          sendcounts[i], sendtype, destinations[i], PLAN_TAG, comm,
+          reqs + indegree + i));
+  loop_host_free(destinations);
+  *nrequests = indegree + outdegree;
+  *requests = reqs;
+  return MPI_SUCCESS;
+}
+
+#endif
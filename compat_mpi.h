@@ -26,6 +26,37 @@ int compat_Neighbor_alltoallv(
     MPI_Datatype recvtype,
     MPI_Comm comm);
 
+/* the request array is allocated with LOOP_HOST_MALLOC
+   and all (*nrequests) of them must be waited on */
+int compat_Ineighbor_alltoallv(
+    const void *sendbuf,
+    const int sendcounts[],
+    const int sdispls[],
+    MPI_Datatype sendtype,
+    void *recvbuf,
+    const int recvcounts[],
+    const int rdispls[],
+    MPI_Datatype recvtype,
+    MPI_Comm comm,
+    int* nrequests,
+    MPI_Request** requests);
+
+/* same as above, but the requests are persistent
+   ones to be started with MPI_Startall and released
+   with MPI_Request_free */
+int compat_Neighbor_alltoallv_init(
+    const void *sendbuf,
+    const int sendcounts[],
+    const int sdispls[],
+    MPI_Datatype sendtype,
+    void *recvbuf,
+    const int recvcounts[],
+    const int rdispls[],
+    MPI_Datatype recvtype,
+    MPI_Comm comm,
+    int* nrequests,
+    MPI_Request** requests);
+
 int compat_Neighbor_allgather(
     const void *sendbuf,
     int sendcount,
@@ -0,0 +1,277 @@
+#include "derive_by_sort.h"
+
+#include <assert.h>
+
+#include "arrays.h"
+#include "ints.h"
+#include "loop.h"
+#include "sort.h"
+#include "tables.h"
+
+/* the tuples being sorted: first the (nlows) existing lows,
+   if any, then one per (high, local low) pair */
+
+struct tuples {
+  unsigned high_dim;
+  unsigned low_dim;
+  unsigned nlows;
+  unsigned const* verts_of_lows;
+  unsigned const* verts_of_highs;
+};
+
+LOOP_INOUT static inline void get_tuple(
+    struct tuples t,
+    unsigned i,
+    unsigned* v)
+{
+  unsigned verts_per_low = the_down_degrees[t.low_dim][0];
+  if (i < t.nlows) {
+    for (unsigned j = 0; j < verts_per_low; ++j)
+      v[j] = t.verts_of_lows[i * verts_per_low + j];
+  } else {
+    unsigned s = i - t.nlows;
+    unsigned lows_per_high = the_down_degrees[t.high_dim][t.low_dim];
+    unsigned verts_per_high = the_down_degrees[t.high_dim][0];
+    unsigned const* verts_of_high = t.verts_of_highs +
+      (s / lows_per_high) * verts_per_high;
+    unsigned const* high_verts_of_low =
+      the_canonical_orders[t.high_dim][t.low_dim][0][s % lows_per_high];
+    for (unsigned j = 0; j < verts_per_low; ++j)
+      v[j] = verts_of_high[high_verts_of_low[j]];
+  }
+}
+
+LOOP_INOUT static inline void get_sorted_tuple(
+    struct tuples t,
+    unsigned i,
+    unsigned* v)
+{
+  unsigned verts_per_low = the_down_degrees[t.low_dim][0];
+  unsigned u[3];
+  get_tuple(t, i, u);
+  for (unsigned j = 0; j < verts_per_low; ++j) {
+    unsigned k = j;
+    for (; k > 0 && v[k - 1] > u[j]; --k)
+      v[k] = v[k - 1];
+    v[k] = u[j];
+  }
+}
+
+/* packs the sorted vertices [first, first + nkey_verts)
+   of the tuple in position (i) of the current order */
+
+LOOP_KERNEL(tuple_key,
+    struct tuples t,
+    unsigned const* order,
+    unsigned first,
+    unsigned nkey_verts,
+    unsigned bits,
+    unsigned long* keys)
+  unsigned v[3];
+  get_sorted_tuple(t, order ? order[i] : i, v);
+  unsigned long key = 0;
+  for (unsigned j = 0; j < nkey_verts; ++j)
+    key = (key << bits) | v[first + j];
+  keys[i] = key;
+}
+
+LOOP_KERNEL(compose_order,
+    unsigned const* order,
+    unsigned const* suborder,
+    unsigned* out)
+  out[i] = order[suborder[i]];
+}
+
+/* a least-significant-first sort over groups of vertices,
+   as many per group as fit in a 64-bit key. all lows fit in
+   one group unless triangles have over 2^21 vertices.
+   the sort is stable, so equal tuples keep their order. */
+
+static unsigned* sort_tuples(struct tuples t, unsigned n, unsigned nverts)
+{
+  unsigned verts_per_low = the_down_degrees[t.low_dim][0];
+  unsigned bits = count_bits(nverts ? nverts - 1 : 0);
+  if (!bits)
+    bits = 1;
+  unsigned nkey_verts = 64 / bits;
+  unsigned* order = 0;
+  unsigned long* keys = LOOP_MALLOC(unsigned long, n);
+  for (unsigned end = verts_per_low; end > 0;) {
+    unsigned first = end > nkey_verts ? end - nkey_verts : 0;
+    LOOP_EXEC(tuple_key, n, t, order, first, end - first, bits, keys);
+    unsigned* suborder = sort_ulongs(n, keys);
+    if (order) {
+      unsigned* composed = LOOP_MALLOC(unsigned, n);
+      LOOP_EXEC(compose_order, n, order, suborder, composed);
+      loop_free(order);
+      loop_free(suborder);
+      order = composed;
+    } else {
+      order = suborder;
+    }
+    end = first;
+  }
+  loop_free(keys);
+  return order;
+}
+
+LOOP_KERNEL(mark_run_starts,
+    struct tuples t,
+    unsigned const* order,
+    unsigned* starts)
+  if (i == 0) {
+    starts[i] = 1;
+    return;
+  }
+  unsigned verts_per_low = the_down_degrees[t.low_dim][0];
+  unsigned a[3];
+  unsigned b[3];
+  get_sorted_tuple(t, order[i - 1], a);
+  get_sorted_tuple(t, order[i], b);
+  unsigned differ = 0;
+  for (unsigned j = 0; j < verts_per_low; ++j)
+    if (a[j] != b[j])
+      differ = 1;
+  starts[i] = differ;
+}
+
+/* since the sort is stable, the start of each run is
+   the first slot that sees its low */
+
+LOOP_KERNEL(mark_first_slots,
+    unsigned const* order,
+    unsigned const* starts,
+    unsigned* is_first)
+  is_first[order[i]] = starts[i];
+}
+
+LOOP_KERNEL(number_runs,
+    unsigned const* order,
+    unsigned const* starts,
+    unsigned const* run_offsets,
+    unsigned const* low_of_firsts,
+    unsigned* low_of_runs)
+  if (starts[i])
+    low_of_runs[run_offsets[i]] = low_of_firsts[order[i]];
+}
+
+LOOP_KERNEL(number_slots,
+    unsigned const* order,
+    unsigned const* run_offsets,
+    unsigned const* low_of_runs,
+    unsigned* lows_of_highs)
+  lows_of_highs[order[i]] = low_of_runs[run_offsets[i + 1] - 1];
+}
+
+LOOP_KERNEL(copy_first_verts,
+    struct tuples t,
+    unsigned const* is_first,
+    unsigned const* low_of_firsts,
+    unsigned* verts_of_lows)
+  if (!is_first[i])
+    return;
+  unsigned verts_per_low = the_down_degrees[t.low_dim][0];
+  get_tuple(t, i, verts_of_lows + low_of_firsts[i] * verts_per_low);
+}
+
+void derive_by_sort(
+    unsigned high_dim,
+    unsigned low_dim,
+    unsigned nhighs,
+    unsigned nverts,
+    unsigned const* verts_of_highs,
+    unsigned* nlows_out,
+    unsigned** verts_of_lows_out,
+    unsigned** lows_of_highs_out)
+{
+  assert(0 < low_dim && low_dim < high_dim);
+  struct tuples t = { high_dim, low_dim, 0, 0, verts_of_highs };
+  unsigned nslots = nhighs * the_down_degrees[high_dim][low_dim];
+  unsigned* order = sort_tuples(t, nslots, nverts);
+  unsigned* starts = LOOP_MALLOC(unsigned, nslots);
+  LOOP_EXEC(mark_run_starts, nslots, t, order, starts);
+  unsigned* is_first = LOOP_MALLOC(unsigned, nslots);
+  LOOP_EXEC(mark_first_slots, nslots, order, starts, is_first);
+  unsigned* low_of_firsts = uints_exscan(is_first, nslots);
+  unsigned nlows = uints_at(low_of_firsts, nslots);
+  unsigned* run_offsets = uints_exscan(starts, nslots);
+  unsigned* low_of_runs = LOOP_MALLOC(unsigned, nlows);
+  LOOP_EXEC(number_runs, nslots, order, starts, run_offsets,
+      low_of_firsts, low_of_runs);
+  loop_free(starts);
+  unsigned* lows_of_highs = LOOP_MALLOC(unsigned, nslots);
+  LOOP_EXEC(number_slots, nslots, order, run_offsets, low_of_runs,
+      lows_of_highs);
+  loop_free(order);
+  loop_free(run_offsets);
+  loop_free(low_of_runs);
+  unsigned* verts_of_lows = LOOP_MALLOC(unsigned,
+      nlows * the_down_degrees[low_dim][0]);
+  LOOP_EXEC(copy_first_verts, nslots, t, is_first, low_of_firsts,
+      verts_of_lows);
+  loop_free(is_first);
+  loop_free(low_of_firsts);
+  *nlows_out = nlows;
+  *verts_of_lows_out = verts_of_lows;
+  *lows_of_highs_out = lows_of_highs;
+}
+
+/* the existing lows come first in the tuples, so each
+   run of equal tuples starts with its low and is
+   followed by the slots that name it */
+
+LOOP_KERNEL(mark_lows,
+    unsigned nlows,
+    unsigned const* order,
+    unsigned* is_low)
+  is_low[i] = order[i] < nlows;
+}
+
+LOOP_KERNEL(take_run_lows,
+    unsigned nlows,
+    unsigned const* order,
+    unsigned const* run_offsets,
+    unsigned* low_of_runs)
+  if (order[i] < nlows)
+    low_of_runs[run_offsets[i]] = order[i];
+}
+
+LOOP_KERNEL(give_run_lows,
+    unsigned nlows,
+    unsigned const* order,
+    unsigned const* run_offsets,
+    unsigned const* low_of_runs,
+    unsigned* lows_of_highs)
+  if (order[i] >= nlows)
+    lows_of_highs[order[i] - nlows] = low_of_runs[run_offsets[i] - 1];
+}
+
+unsigned* reflect_down_by_sort(
+    unsigned high_dim,
+    unsigned low_dim,
+    unsigned nhighs,
+    unsigned nlows,
+    unsigned nverts,
+    unsigned const* verts_of_highs,
+    unsigned const* verts_of_lows)
+{
+  assert(0 < low_dim && low_dim < high_dim);
+  struct tuples t = { high_dim, low_dim, nlows, verts_of_lows,
+    verts_of_highs };
+  unsigned nslots = nhighs * the_down_degrees[high_dim][low_dim];
+  unsigned n = nlows + nslots;
+  unsigned* order = sort_tuples(t, n, nverts);
+  unsigned* is_low = LOOP_MALLOC(unsigned, n);
+  LOOP_EXEC(mark_lows, n, nlows, order, is_low);
+  unsigned* run_offsets = uints_exscan(is_low, n);
+  loop_free(is_low);
+  unsigned* low_of_runs = LOOP_MALLOC(unsigned, nlows);
+  LOOP_EXEC(take_run_lows, n, nlows, order, run_offsets, low_of_runs);
+  unsigned* lows_of_highs = LOOP_MALLOC(unsigned, nslots);
+  LOOP_EXEC(give_run_lows, n, nlows, order, run_offsets, low_of_runs,
+      lows_of_highs);
+  loop_free(order);
+  loop_free(run_offsets);
+  loop_free(low_of_runs);
+  return lows_of_highs;
+}
@@ -0,0 +1,37 @@
+#ifndef DERIVE_BY_SORT_H
+#define DERIVE_BY_SORT_H
+
+/* these derive intermediate entities without any upward
+ * adjacency: every (high, low) pair names its low by the
+ * sorted vertices of that low, and sorting these tuples
+ * brings together all the pairs that name the same low.
+ */
+
+/* finds the unique (low) entities of the (high) entities.
+ * lows are numbered in the order they are first seen and take
+ * their orientation from that first (high), which is how
+ * bridge_dual_graph numbers sides.
+ */
+void derive_by_sort(
+    unsigned high_dim,
+    unsigned low_dim,
+    unsigned nhighs,
+    unsigned nverts,
+    unsigned const* verts_of_highs,
+    unsigned* nlows_out,
+    unsigned** verts_of_lows_out,
+    unsigned** lows_of_highs_out);
+
+/* the same as mesh_reflect_down, but it matches the
+ * (high, low) pairs against the existing lows by sorting
+ */
+unsigned* reflect_down_by_sort(
+    unsigned high_dim,
+    unsigned low_dim,
+    unsigned nhighs,
+    unsigned nlows,
+    unsigned nverts,
+    unsigned const* verts_of_highs,
+    unsigned const* verts_of_lows);
+
+#endif
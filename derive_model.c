@@ -6,10 +6,14 @@
 #include "algebra.h"
 #include "arrays.h"
 #include "bfs.h"
+#include "comm.h"
+#include "global.h"
 #include "ints.h"
+#include "invert_map.h"
 #include "loop.h"
 #include "mark.h"
 #include "mesh.h"
+#include "parallel_mesh.h"
 #include "tables.h"
 
 /* a mesh will have these dimensions:
@@ -19,6 +23,97 @@
    hinge = side - 1
 */
 
+/* on a distributed mesh, anything counted over adjacent
+   entities is counted only over the owned ones and then
+   summed over all copies, so that each entity is counted
+   exactly once no matter how the mesh is split or ghosted */
+
+static void sum_over_copies(struct mesh* m, unsigned dim, unsigned width,
+    double** a)
+{
+  if (!mesh_is_parallel(m))
+    return;
+  unsigned n = mesh_count(m, dim);
+  mesh_add_tag(m, dim, TAG_F64, "derive_sum", width, *a);
+  mesh_accumulate_tag(m, dim, "derive_sum");
+  mesh_conform_tag(m, dim, "derive_sum");
+  *a = doubles_copy(mesh_find_tag(m, dim, "derive_sum")->d.f64, n * width);
+  mesh_free_tag(m, dim, "derive_sum");
+}
+
+static void min_over_copies(struct mesh* m, unsigned dim, unsigned width,
+    unsigned** a)
+{
+  mesh_reduce_uints_min(m, dim, width, a);
+  mesh_conform_uints(m, dim, width, a);
+}
+
+LOOP_KERNEL(count_owned_ups,
+    unsigned const* highs_of_lows_offsets,
+    unsigned const* highs_of_lows,
+    unsigned const* owned_highs,
+    unsigned const* marked_highs,
+    double* counts)
+  unsigned f = highs_of_lows_offsets[i];
+  unsigned e = highs_of_lows_offsets[i + 1];
+  double c = 0;
+  for (unsigned j = f; j < e; ++j) {
+    unsigned high = highs_of_lows[j];
+    if (owned_highs[high] && (!marked_highs || marked_highs[high]))
+      c += 1;
+  }
+  counts[i] = c;
+}
+
+/* the number of (marked) entities of dimension (high_dim)
+   adjacent to each entity of dimension (low_dim), over
+   the whole distributed mesh */
+
+static double* count_global_ups(struct mesh* m,
+    unsigned low_dim, unsigned high_dim, unsigned const* marked_highs)
+{
+  unsigned nlows = mesh_count(m, low_dim);
+  unsigned* owned_highs = mesh_get_owned(m, high_dim);
+  double* counts = LOOP_MALLOC(double, nlows);
+  LOOP_EXEC(count_owned_ups, nlows,
+      mesh_ask_up(m, low_dim, high_dim)->offsets,
+      mesh_ask_up(m, low_dim, high_dim)->adj,
+      owned_highs, marked_highs, counts);
+  loop_free(owned_highs);
+  sum_over_copies(m, low_dim, 1, &counts);
+  return counts;
+}
+
+LOOP_KERNEL(mark_count_below,
+    double const* counts,
+    double limit,
+    unsigned* out)
+  out[i] = counts[i] < limit;
+}
+
+LOOP_KERNEL(mark_count_above,
+    double const* counts,
+    double limit,
+    unsigned* out)
+  out[i] = counts[i] > limit;
+}
+
+/* sides with only one element in the whole mesh,
+   as opposed to those on the boundary of this part */
+
+static unsigned* mark_global_boundary(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  if (!mesh_is_parallel(m))
+    return mesh_mark_part_boundary(m);
+  unsigned nsides = mesh_count(m, dim - 1);
+  double* nelems = count_global_ups(m, dim - 1, dim, 0);
+  unsigned* out = LOOP_MALLOC(unsigned, nsides);
+  LOOP_EXEC(mark_count_below, nsides, nelems, 2.0, out);
+  loop_free(nelems);
+  return out;
+}
+
 LOOP_KERNEL(boundary_edge_normal,
     unsigned const* boundary_edges,
     unsigned const* verts_of_edges,
@@ -123,6 +218,74 @@ static double* get_hinge_angles(
   return angles;
 }
 
+LOOP_KERNEL(sum_owned_side_normals,
+    unsigned const* sides_of_hinges,
+    unsigned const* sides_of_hinges_offsets,
+    unsigned const* boundary_sides,
+    unsigned const* owned_sides,
+    double const* side_normals,
+    double* sums)
+  unsigned f = sides_of_hinges_offsets[i];
+  unsigned e = sides_of_hinges_offsets[i + 1];
+  for (unsigned k = 0; k < 4; ++k)
+    sums[i * 4 + k] = 0;
+  for (unsigned j = f; j < e; ++j) {
+    unsigned side = sides_of_hinges[j];
+    if (boundary_sides[side] && owned_sides[side]) {
+      for (unsigned k = 0; k < 3; ++k)
+        sums[i * 4 + k] += side_normals[side * 3 + k];
+      sums[i * 4 + 3] += 1;
+    }
+  }
+}
+
+LOOP_KERNEL(hinge_angle_from_sum,
+    double const* sums,
+    unsigned* boundary_hinges,
+    double* angles)
+  double const* s = sums + i * 4;
+  boundary_hinges[i] = (s[3] > 0);
+  if (!boundary_hinges[i]) {
+    angles[i] = 0;
+    return;
+  }
+  /* |n0 + n1|^2 = 2 + 2 cos(angle) */
+  double c = dot_product(s, s, 3) / 2 - 1;
+  if (c > 1)
+    c = 1;
+  if (c < -1)
+    c = -1;
+  angles[i] = acos(c);
+}
+
+/* on a distributed mesh the two boundary sides of a hinge
+   may be on different parts, so each part contributes the
+   normals of its owned boundary sides and the angle comes
+   from their sum */
+
+static double* get_global_hinge_angles(struct mesh* m,
+    unsigned const* boundary_sides,
+    double const* side_normals,
+    unsigned** p_boundary_hinges)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nhinges = mesh_count(m, dim - 2);
+  unsigned* owned_sides = mesh_get_owned(m, dim - 1);
+  double* sums = LOOP_MALLOC(double, nhinges * 4);
+  LOOP_EXEC(sum_owned_side_normals, nhinges,
+      mesh_ask_up(m, dim - 2, dim - 1)->adj,
+      mesh_ask_up(m, dim - 2, dim - 1)->offsets,
+      boundary_sides, owned_sides, side_normals, sums);
+  loop_free(owned_sides);
+  sum_over_copies(m, dim - 2, 4, &sums);
+  unsigned* boundary_hinges = LOOP_MALLOC(unsigned, nhinges);
+  double* angles = LOOP_MALLOC(double, nhinges);
+  LOOP_EXEC(hinge_angle_from_sum, nhinges, sums, boundary_hinges, angles);
+  loop_free(sums);
+  *p_boundary_hinges = boundary_hinges;
+  return angles;
+}
+
 LOOP_KERNEL(mark_crease,
     double const* hingle_angles,
     double crease_angle,
@@ -221,7 +384,7 @@ void mesh_derive_class_dim(struct mesh* m, double crease_angle)
   mesh_add_tag(m, dim, TAG_U32, "class_dim", 1, elem_class_dim);
   if (dim == 0)
     return;
-  unsigned* boundary_sides = mesh_mark_part_boundary(m);
+  unsigned* boundary_sides = mark_global_boundary(m);
   unsigned nsides = mesh_count(m, dim - 1);
   unsigned* side_class_dim = LOOP_MALLOC(unsigned, nsides);
   LOOP_EXEC(get_side_class_dim, nsides, dim, boundary_sides, side_class_dim);
@@ -233,13 +396,19 @@ void mesh_derive_class_dim(struct mesh* m, double crease_angle)
   double* side_normals = get_boundary_side_normals(dim - 1, nsides,
       boundary_sides, mesh_ask_down(m, dim - 1, 0),
       mesh_find_tag(m, 0, "coordinates")->d.f64);
-  unsigned* boundary_hinges = mesh_mark_down(m, dim - 1, dim - 2,
-      boundary_sides);
   unsigned nhinges = mesh_count(m, dim - 2);
-  double* hinge_angles = get_hinge_angles(nhinges,
-      mesh_ask_up(m, dim - 2, dim - 1)->adj,
-      mesh_ask_up(m, dim - 2, dim - 1)->offsets,
-      boundary_sides, boundary_hinges, side_normals);
+  unsigned* boundary_hinges;
+  double* hinge_angles;
+  if (mesh_is_parallel(m)) {
+    hinge_angles = get_global_hinge_angles(m, boundary_sides, side_normals,
+        &boundary_hinges);
+  } else {
+    boundary_hinges = mesh_mark_down(m, dim - 1, dim - 2, boundary_sides);
+    hinge_angles = get_hinge_angles(nhinges,
+        mesh_ask_up(m, dim - 2, dim - 1)->adj,
+        mesh_ask_up(m, dim - 2, dim - 1)->offsets,
+        boundary_sides, boundary_hinges, side_normals);
+  }
   loop_free(boundary_sides);
   loop_free(side_normals);
   unsigned* crease_hinges = mark_creases(nhinges, hinge_angles, crease_angle);
@@ -254,29 +423,67 @@ void mesh_derive_class_dim(struct mesh* m, double crease_angle)
     return;
   }
   unsigned nverts = mesh_count(m, 0);
-  unsigned* corner_verts = mark_corners(nverts,
-      mesh_ask_up(m, 0, 1)->adj, mesh_ask_up(m, 0, 1)->offsets,
-      crease_hinges);
+  unsigned* corner_verts;
+  if (mesh_is_parallel(m)) {
+    double* ncreases = count_global_ups(m, 0, 1, crease_hinges);
+    corner_verts = LOOP_MALLOC(unsigned, nverts);
+    LOOP_EXEC(mark_count_above, nverts, ncreases, 2.0, corner_verts);
+    loop_free(ncreases);
+  } else {
+    corner_verts = mark_corners(nverts,
+        mesh_ask_up(m, 0, 1)->adj, mesh_ask_up(m, 0, 1)->offsets,
+        crease_hinges);
+  }
   loop_free(crease_hinges);
   unsigned* vert_class_dim = get_vert_class_dim(nverts, corner_verts,
       mesh_ask_up(m, 0, 1)->adj, mesh_ask_up(m, 0, 1)->offsets,
       hinge_class_dim);
   loop_free(corner_verts);
+  /* the edge of lowest dimension may be on another part */
+  if (mesh_is_parallel(m))
+    min_over_copies(m, 0, 1, &vert_class_dim);
   mesh_add_tag(m, 0, TAG_U32, "class_dim", 1, vert_class_dim);
 }
 
+/* the other entity of equal order across a bridge,
+   which on a distributed mesh may be on another part */
+
+LOOP_INOUT static inline unsigned
+bridged_eq(
+    unsigned ent,
+    unsigned bridge,
+    unsigned const* eq_offsets,
+    unsigned const* ents_of_bridges_offsets,
+    unsigned const* ents_of_bridges)
+{
+  unsigned a = ents_of_bridges_offsets[bridge];
+  unsigned b = ents_of_bridges_offsets[bridge + 1];
+  for (unsigned l = a; l < b; ++l) {
+    unsigned other = ents_of_bridges[l];
+    if (other == ent)
+      continue;
+    if (eq_offsets[other] != eq_offsets[other + 1])
+      return eq_offsets[other];
+  }
+  return INVALID;
+}
+
 LOOP_KERNEL(count_boundary_graph,
     unsigned const* eq_offsets,
     unsigned const* bridges_of_ents,
     unsigned bridges_per_ent,
     unsigned const* bridges,
+    unsigned const* ents_of_bridges_offsets,
+    unsigned const* ents_of_bridges,
     unsigned* degrees)
   if (eq_offsets[i] == eq_offsets[i + 1])
     return;
   unsigned d = 0;
   unsigned const* bridges_of_ent = bridges_of_ents + i * bridges_per_ent;
   for (unsigned j = 0; j < bridges_per_ent; ++j)
-    if (bridges[bridges_of_ent[j]])
+    if (bridges[bridges_of_ent[j]] &&
+        bridged_eq(i, bridges_of_ent[j], eq_offsets,
+          ents_of_bridges_offsets, ents_of_bridges) != INVALID)
       ++d;
   degrees[eq_offsets[i]] = d;
 }
@@ -296,22 +503,12 @@ LOOP_KERNEL(fill_boundary_graph,
   unsigned k = offsets[eq];
   unsigned const* bridges_of_ent = bridges_of_ents + i * bridges_per_ent;
   for (unsigned j = 0; j < bridges_per_ent; ++j) {
-    unsigned bridge = bridges_of_ent[j];
-    if (bridges[bridges_of_ent[j]]) {
-      unsigned a = ents_of_bridges_offsets[bridge];
-      unsigned b = ents_of_bridges_offsets[bridge + 1];
-      unsigned l;
-      for (l = a; l < b; ++l) {
-        unsigned other = ents_of_bridges[l];
-        if (other == i)
-          continue;
-        if (eq_offsets[other] != eq_offsets[other + 1]) {
-          adj[k++] = eq_offsets[other];
-          break;
-        }
-      }
-      assert(l < b);
-    }
+    if (!bridges[bridges_of_ent[j]])
+      continue;
+    unsigned other = bridged_eq(i, bridges_of_ent[j], eq_offsets,
+        ents_of_bridges_offsets, ents_of_bridges);
+    if (other != INVALID)
+      adj[k++] = other;
   }
 }
 
@@ -327,26 +524,25 @@ static void form_boundary_graph(struct mesh* m, unsigned dim,
   unsigned* bridges = mesh_mark_class(m, dim - 1, dim, INVALID);
   unsigned bridges_per_ent = the_down_degrees[dim][dim - 1];
   unsigned const* bridges_of_ents = mesh_ask_down(m, dim, dim - 1);
+  unsigned const* ents_of_bridges_offsets =
+    mesh_ask_up(m, dim - 1, dim)->offsets;
+  unsigned const* ents_of_bridges =
+    mesh_ask_up(m, dim - 1, dim)->adj;
   unsigned* degrees = LOOP_MALLOC(unsigned, neqs);
   LOOP_EXEC(count_boundary_graph, nents, eq_offsets, bridges_of_ents,
-      bridges_per_ent, bridges, degrees);
+      bridges_per_ent, bridges, ents_of_bridges_offsets, ents_of_bridges,
+      degrees);
   unsigned* offsets = uints_exscan(degrees, neqs);
   loop_free(degrees);
   unsigned nadj = uints_at(offsets, neqs);
   unsigned* adj = LOOP_MALLOC(unsigned, nadj);
-  unsigned const* ents_of_bridges_offsets =
-    mesh_ask_up(m, dim - 1, dim)->offsets;
-  unsigned const* ents_of_bridges =
-    mesh_ask_up(m, dim - 1, dim)->adj;
   LOOP_EXEC(fill_boundary_graph, nents, eq_offsets, bridges_of_ents,
       bridges_per_ent, bridges, ents_of_bridges_offsets, ents_of_bridges,
       offsets, adj);
   loop_free(bridges);
   *p_eq_offsets = eq_offsets;
-  *p_offsets = uints_to_host(offsets, neqs + 1);
-  loop_free(offsets);
-  *p_adj = uints_to_host(adj, nadj);
-  loop_free(adj);
+  *p_offsets = offsets;
+  *p_adj = adj;
 }
 
 LOOP_KERNEL(extract_eq_class_id,
@@ -357,6 +553,202 @@ LOOP_KERNEL(extract_eq_class_id,
     class_id[i] = comp[eq_offsets[i]];
 }
 
+/* on a distributed mesh, the components found on each part
+   are pieces of the global ones. every piece takes the
+   smallest value among its entities, the pieces meet at
+   copies of bridges and entities, which agree on the
+   smallest value among them, and this repeats until
+   nothing changes anywhere. */
+
+LOOP_KERNEL(piece_min,
+    unsigned const* eqs_of_pieces_offsets,
+    unsigned const* eqs_of_pieces,
+    unsigned const* ents_of_eqs,
+    unsigned long const* values,
+    unsigned long* piece_values)
+  unsigned long v = ~((unsigned long) 0);
+  unsigned f = eqs_of_pieces_offsets[i];
+  unsigned e = eqs_of_pieces_offsets[i + 1];
+  for (unsigned j = f; j < e; ++j) {
+    unsigned long ev = values[ents_of_eqs[eqs_of_pieces[j]]];
+    if (ev < v)
+      v = ev;
+  }
+  piece_values[i] = v;
+}
+
+LOOP_KERNEL(spread_piece_min,
+    unsigned const* eq_offsets,
+    unsigned const* comp,
+    unsigned long const* piece_values,
+    unsigned long* values)
+  if (eq_offsets[i] != eq_offsets[i + 1])
+    values[i] = piece_values[comp[eq_offsets[i]]];
+}
+
+LOOP_KERNEL(bridge_min,
+    unsigned const* bridges,
+    unsigned const* ents_of_bridges_offsets,
+    unsigned const* ents_of_bridges,
+    unsigned const* eq_offsets,
+    unsigned long const* values,
+    unsigned long* bridge_values)
+  unsigned long v = ~((unsigned long) 0);
+  if (bridges[i]) {
+    unsigned f = ents_of_bridges_offsets[i];
+    unsigned e = ents_of_bridges_offsets[i + 1];
+    for (unsigned j = f; j < e; ++j) {
+      unsigned ent = ents_of_bridges[j];
+      if (eq_offsets[ent] != eq_offsets[ent + 1] && values[ent] < v)
+        v = values[ent];
+    }
+  }
+  bridge_values[i] = v;
+}
+
+LOOP_KERNEL(take_bridge_min,
+    unsigned const* eq_offsets,
+    unsigned const* bridges_of_ents,
+    unsigned bridges_per_ent,
+    unsigned long const* bridge_values,
+    unsigned long* values)
+  if (eq_offsets[i] == eq_offsets[i + 1])
+    return;
+  for (unsigned j = 0; j < bridges_per_ent; ++j) {
+    unsigned long v = bridge_values[bridges_of_ents[i * bridges_per_ent + j]];
+    if (v < values[i])
+      values[i] = v;
+  }
+}
+
+LOOP_KERNEL(ulongs_differ,
+    unsigned long const* a,
+    unsigned long const* b,
+    unsigned* out)
+  out[i] = (a[i] != b[i]);
+}
+
+LOOP_KERNEL(ent_of_eq,
+    unsigned const* eq_offsets,
+    unsigned* ents_of_eqs)
+  if (eq_offsets[i] != eq_offsets[i + 1])
+    ents_of_eqs[eq_offsets[i]] = i;
+}
+
+static void spread_global_min(struct mesh* m, unsigned dim,
+    unsigned const* eq_offsets, unsigned const* comp, unsigned npieces,
+    unsigned long** p_values)
+{
+  unsigned nents = mesh_count(m, dim);
+  unsigned neqs = uints_at(eq_offsets, nents);
+  unsigned* ents_of_eqs = LOOP_MALLOC(unsigned, neqs);
+  LOOP_EXEC(ent_of_eq, nents, eq_offsets, ents_of_eqs);
+  unsigned* eqs_of_pieces;
+  unsigned* eqs_of_pieces_offsets;
+  invert_map(neqs, comp, npieces, &eqs_of_pieces, &eqs_of_pieces_offsets);
+  unsigned nbridges = mesh_count(m, dim - 1);
+  unsigned* bridges = mesh_mark_class(m, dim - 1, dim, INVALID);
+  unsigned const* ents_of_bridges_offsets =
+    mesh_ask_up(m, dim - 1, dim)->offsets;
+  unsigned const* ents_of_bridges = mesh_ask_up(m, dim - 1, dim)->adj;
+  unsigned const* bridges_of_ents = mesh_ask_down(m, dim, dim - 1);
+  unsigned bridges_per_ent = the_down_degrees[dim][dim - 1];
+  unsigned long* values = *p_values;
+  unsigned long* piece_values = LOOP_MALLOC(unsigned long, npieces);
+  unsigned* changed = LOOP_MALLOC(unsigned, nents);
+  while (1) {
+    LOOP_EXEC(piece_min, npieces, eqs_of_pieces_offsets, eqs_of_pieces,
+        ents_of_eqs, values, piece_values);
+    unsigned long* old_values = ulongs_copy(values, nents);
+    LOOP_EXEC(spread_piece_min, nents, eq_offsets, comp, piece_values, values);
+    unsigned long* bridge_values = LOOP_MALLOC(unsigned long, nbridges);
+    LOOP_EXEC(bridge_min, nbridges, bridges, ents_of_bridges_offsets,
+        ents_of_bridges, eq_offsets, values, bridge_values);
+    mesh_reduce_ulongs_min(m, dim - 1, 1, &bridge_values);
+    mesh_conform_ulongs(m, dim - 1, 1, &bridge_values);
+    LOOP_EXEC(take_bridge_min, nents, eq_offsets, bridges_of_ents,
+        bridges_per_ent, bridge_values, values);
+    loop_free(bridge_values);
+    mesh_reduce_ulongs_min(m, dim, 1, &values);
+    mesh_conform_ulongs(m, dim, 1, &values);
+    LOOP_EXEC(ulongs_differ, nents, old_values, values, changed);
+    loop_free(old_values);
+    if (!comm_max_uint(nents ? uints_max(changed, nents) : 0))
+      break;
+  }
+  loop_free(changed);
+  loop_free(piece_values);
+  loop_free(bridges);
+  loop_free(eqs_of_pieces);
+  loop_free(eqs_of_pieces_offsets);
+  loop_free(ents_of_eqs);
+  *p_values = values;
+}
+
+LOOP_KERNEL(eq_globals,
+    unsigned const* eq_offsets,
+    unsigned long const* globals,
+    unsigned long* labels)
+  labels[i] = (eq_offsets[i] != eq_offsets[i + 1]) ?
+    globals[i] : ~((unsigned long) 0);
+}
+
+LOOP_KERNEL(mark_roots,
+    unsigned const* eq_offsets,
+    unsigned const* owned,
+    unsigned long const* globals,
+    unsigned long const* labels,
+    unsigned* roots)
+  roots[i] = (eq_offsets[i] != eq_offsets[i + 1]) && owned[i] &&
+    (labels[i] == globals[i]);
+}
+
+LOOP_KERNEL(root_numbers,
+    unsigned const* roots,
+    unsigned long const* root_offsets,
+    unsigned long* numbers)
+  numbers[i] = roots[i] ? root_offsets[i] : ~((unsigned long) 0);
+}
+
+LOOP_KERNEL(eq_numbers_to_class_id,
+    unsigned const* eq_offsets,
+    unsigned long const* numbers,
+    unsigned* class_id)
+  if (eq_offsets[i] != eq_offsets[i + 1])
+    class_id[i] = (unsigned) numbers[i];
+}
+
+/* each global component is labeled by its entity of
+   smallest global number, the owner of that entity
+   numbers it among its part's roots, and the numbers
+   spread the same way the labels did */
+
+static void set_global_class_id(struct mesh* m, unsigned dim,
+    unsigned const* eq_offsets, unsigned const* comp, unsigned npieces,
+    unsigned* class_id)
+{
+  unsigned nents = mesh_count(m, dim);
+  unsigned long const* globals = mesh_ask_globals(m, dim);
+  unsigned long* labels = LOOP_MALLOC(unsigned long, nents);
+  LOOP_EXEC(eq_globals, nents, eq_offsets, globals, labels);
+  spread_global_min(m, dim, eq_offsets, comp, npieces, &labels);
+  unsigned* owned = mesh_get_owned(m, dim);
+  unsigned* roots = LOOP_MALLOC(unsigned, nents);
+  LOOP_EXEC(mark_roots, nents, eq_offsets, owned, globals, labels, roots);
+  loop_free(owned);
+  loop_free(labels);
+  unsigned* local_offsets = uints_exscan(roots, nents);
+  unsigned long* root_offsets = globalize_offsets(local_offsets, nents);
+  loop_free(local_offsets);
+  unsigned long* numbers = LOOP_MALLOC(unsigned long, nents);
+  LOOP_EXEC(root_numbers, nents, roots, root_offsets, numbers);
+  loop_free(roots);
+  loop_free(root_offsets);
+  spread_global_min(m, dim, eq_offsets, comp, npieces, &numbers);
+  LOOP_EXEC(eq_numbers_to_class_id, nents, eq_offsets, numbers, class_id);
+  loop_free(numbers);
+}
+
 static void set_equal_order_class_id(struct mesh* m, unsigned dim)
 {
   unsigned* eq_offsets;
@@ -365,14 +757,17 @@ static void set_equal_order_class_id(struct mesh* m, unsigned dim)
   form_boundary_graph(m, dim, &eq_offsets, &offsets, &adj);
   unsigned nents = mesh_count(m, dim);
   unsigned neqs = uints_at(eq_offsets, nents);
-  unsigned* host_comp = LOOP_HOST_MALLOC(unsigned, neqs);
-  connected_components(neqs, offsets, adj, host_comp);
-  loop_host_free(offsets);
-  loop_host_free(adj);
-  unsigned* comp = uints_to_device(host_comp, neqs);
-  loop_host_free(host_comp);
-  unsigned* class_id = LOOP_MALLOC(unsigned, nents);
-  LOOP_EXEC(extract_eq_class_id, nents, eq_offsets, comp, class_id);
+  unsigned* comp = LOOP_MALLOC(unsigned, neqs);
+  connected_components_parallel(neqs, offsets, adj, comp);
+  loop_free(offsets);
+  loop_free(adj);
+  unsigned* class_id = uints_filled(nents, INVALID);
+  if (mesh_is_parallel(m)) {
+    unsigned npieces = neqs ? uints_max(comp, neqs) + 1 : 0;
+    set_global_class_id(m, dim, eq_offsets, comp, npieces, class_id);
+  } else {
+    LOOP_EXEC(extract_eq_class_id, nents, eq_offsets, comp, class_id);
+  }
   loop_free(comp);
   loop_free(eq_offsets);
   mesh_add_tag(m, dim, TAG_U32, "class_id", 1, class_id);
@@ -411,25 +806,64 @@ static void project_class_id_onto(struct mesh* m, unsigned low_dim)
       up_offsets, up,
       high_class_dim, high_class_id,
       low_class_dim, low_class_id);
+  /* the entities a copy takes its classification from
+     may all be on other parts */
+  if (mesh_is_parallel(m)) {
+    unsigned* class_id = uints_copy(low_class_id, nlows);
+    min_over_copies(m, low_dim, 1, &class_id);
+    mesh_free_tag(m, low_dim, "class_id");
+    mesh_add_tag(m, low_dim, TAG_U32, "class_id", 1, class_id);
+  }
+}
+
+LOOP_KERNEL(mark_model_vert,
+    unsigned const* class_dim,
+    unsigned const* owned,
+    unsigned* marks)
+  marks[i] = (class_dim[i] == 0) && (!owned || owned[i]);
+}
+
+LOOP_KERNEL(model_vert_class_id,
+    unsigned const* class_dim,
+    unsigned const* marks,
+    unsigned const* offsets,
+    unsigned offset,
+    unsigned* class_id)
+  if (marks[i])
+    class_id[i] = offset + offsets[i];
+  else if (class_dim[i] != 0)
+    class_id[i] = INVALID;
+}
+
+/* model vertices are numbered in order, by their owners */
+
+static void set_vert_class_id(struct mesh* m)
+{
+  unsigned nverts = mesh_count(m, 0);
+  unsigned const* class_dim = mesh_find_tag(m, 0, "class_dim")->d.u32;
+  unsigned* owned = 0;
+  if (mesh_is_parallel(m))
+    owned = mesh_get_owned(m, 0);
+  unsigned* marks = LOOP_MALLOC(unsigned, nverts);
+  LOOP_EXEC(mark_model_vert, nverts, class_dim, owned, marks);
+  loop_free(owned);
+  unsigned* offsets = uints_exscan(marks, nverts);
+  unsigned long offset = 0;
+  if (mesh_is_parallel(m))
+    offset = comm_exscan_ulong(uints_at(offsets, nverts));
+  unsigned* class_id = LOOP_MALLOC(unsigned, nverts);
+  LOOP_EXEC(model_vert_class_id, nverts, class_dim, marks, offsets,
+      (unsigned) offset, class_id);
+  loop_free(marks);
+  loop_free(offsets);
+  if (mesh_is_parallel(m))
+    mesh_conform_uints(m, 0, 1, &class_id);
+  mesh_add_tag(m, 0, TAG_U32, "class_id", 1, class_id);
 }
 
 void mesh_derive_class_id(struct mesh* m)
 {
-  /* we'll do this part on the host as well, for laziness */
-  {
-    unsigned nverts = mesh_count(m, 0);
-    unsigned* vert_class_dim = uints_to_host(
-        mesh_find_tag(m, 0, "class_dim")->d.u32, nverts);
-    unsigned* vert_class_id = LOOP_HOST_MALLOC(unsigned, nverts);
-    unsigned nmodel_verts = 0;
-    for (unsigned i = 0; i < nverts; ++i)
-      if (vert_class_dim[i] == 0)
-        vert_class_id[i] = nmodel_verts++;
-    loop_host_free(vert_class_dim);
-    mesh_add_tag(m, 0, TAG_U32, "class_id", 1,
-        uints_to_device(vert_class_id, nverts));
-    loop_host_free(vert_class_id);
-  }
+  set_vert_class_id(m);
   unsigned dim = mesh_dim(m);
   for (unsigned d = 1; d <= dim; ++d)
     set_equal_order_class_id(m, d);
@@ -0,0 +1,367 @@
+#include "diffusive_balance.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "arrays.h"
+#include "comm.h"
+#include "doubles.h"
+#include "exchanger.h"
+#include "ghost_mesh.h"
+#include "ints.h"
+#include "loop.h"
+#include "mark.h"
+#include "mesh.h"
+#include "migrate_mesh.h"
+#include "parallel_inertial_bisect.h"
+#include "parallel_mesh.h"
+#include "tables.h"
+#include "trace.h"
+
+/* this is first-order diffusion, as in:
+
+   Cybenko, George.
+   "Dynamic load balancing for distributed memory multiprocessors."
+   Journal of parallel and distributed computing 7.2 (1989): 279-301.
+
+   each round, every rank sends (load difference) / (degree + 1)
+   of its weight to each lighter neighbor, with the larger degree
+   of the two, so no rank gives away more than it has. */
+
+#define MAX_ROUNDS 32
+#define MAX_LAYERS 8
+
+static double* element_weights(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  struct const_tag* wt = mesh_find_tag(m, dim, "balance_weight");
+  if (!wt)
+    return doubles_filled(nelems, 1.0);
+  assert(wt->type == TAG_F64 && wt->ncomps == 1);
+  return doubles_copy(wt->d.f64, nelems);
+}
+
+unsigned long mesh_migration_bytes_per_elem(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned long b = the_down_degrees[dim][0] * sizeof(unsigned)
+    + sizeof(unsigned long);
+  struct tags* ts = mesh_tags(m, dim);
+  for (unsigned i = 0; i < count_tags(ts); ++i) {
+    struct const_tag* t = get_tag(ts, i);
+    b += t->ncomps * tag_size(t->type);
+  }
+  return b;
+}
+
+/* the ranks holding each vertex, (width) slots per vertex
+   padded with INVALID. the owner knows all the copies of
+   its vertices and tells each of them, so two ranks that
+   both hold copies of a vertex owned by a third also see
+   each other. */
+
+LOOP_KERNEL(fill_sharers_kern,
+    unsigned width,
+    unsigned const* copies_offsets,
+    unsigned const* msg_of_copies,
+    unsigned const* msg_ranks,
+    unsigned* sharers)
+  unsigned first = copies_offsets[i];
+  unsigned end = copies_offsets[i + 1];
+  for (unsigned j = 0; j < width; ++j)
+    sharers[i * width + j] = (first + j < end) ?
+      msg_ranks[msg_of_copies[first + j]] : INVALID;
+}
+
+static unsigned* get_vert_sharers(struct mesh* m, unsigned* p_width)
+{
+  unsigned nverts = mesh_count(m, 0);
+  struct exchanger* ex = mesh_ask_exchanger(m, 0);
+  unsigned const* copies_offsets = ex->items_of_roots_offsets[EX_FOR];
+  unsigned* ncopies = uints_unscan(copies_offsets, nverts);
+  unsigned width = comm_max_uint(nverts ? uints_max(ncopies, nverts) : 0);
+  loop_free(ncopies);
+  unsigned* sharers = LOOP_MALLOC(unsigned, nverts * width);
+  LOOP_EXEC(fill_sharers_kern, nverts,
+      width,
+      copies_offsets,
+      ex->msg_of_items[EX_FOR],
+      ex->ranks[EX_FOR],
+      sharers);
+  mesh_conform_uints(m, 0, width, &sharers);
+  *p_width = width;
+  return sharers;
+}
+
+/* the part-adjacency graph: every other rank holding one
+   of our vertices. collecting the distinct ranks is
+   sequential, so it runs on a host copy */
+
+static unsigned* get_neighbor_ranks(struct mesh* m,
+    unsigned const* sharers, unsigned width, unsigned* p_n)
+{
+  unsigned nslots = mesh_count(m, 0) * width;
+  unsigned* host_sharers = uints_to_host(sharers, nslots);
+  unsigned self = comm_rank();
+  unsigned* ranks = LOOP_HOST_MALLOC(unsigned, comm_size());
+  unsigned n = 0;
+  for (unsigned i = 0; i < nslots; ++i) {
+    unsigned rank = host_sharers[i];
+    if (rank == INVALID || rank == self)
+      continue;
+    unsigned j;
+    for (j = 0; j < n; ++j)
+      if (ranks[j] == rank)
+        break;
+    if (j == n)
+      ranks[n++] = rank;
+  }
+  loop_host_free(host_sharers);
+  *p_n = n;
+  return ranks;
+}
+
+/* every neighbor sends its load and degree to every neighbor.
+   (ranks), (loads) and (degrees) are host arrays, the
+   exchanger works on device arrays */
+
+static void get_neighbor_loads(
+    unsigned nneighbors,
+    unsigned const* ranks,
+    double load,
+    double* loads,
+    unsigned* degrees)
+{
+  unsigned* dest_ranks = uints_to_device(ranks, nneighbors);
+  struct exchanger* ex = new_exchanger(nneighbors, dest_ranks);
+  loop_free(dest_ranks);
+  double* host_sent = LOOP_HOST_MALLOC(double, nneighbors * 2);
+  for (unsigned i = 0; i < nneighbors; ++i) {
+    host_sent[i * 2 + 0] = load;
+    host_sent[i * 2 + 1] = nneighbors;
+  }
+  double* sent = doubles_to_device(host_sent, nneighbors * 2);
+  loop_host_free(host_sent);
+  double* dev_recvd = exchange_doubles(ex, 2, sent, EX_FOR, EX_ITEM);
+  loop_free(sent);
+  assert(ex->nitems[EX_REV] == nneighbors);
+  double* recvd = doubles_to_host(dev_recvd, nneighbors * 2);
+  loop_free(dev_recvd);
+  unsigned* msg_ranks = uints_to_host(ex->ranks[EX_REV], ex->nmsgs[EX_REV]);
+  unsigned* msg_of_recvd = uints_to_host(ex->msg_of_items[EX_REV],
+      nneighbors);
+  for (unsigned i = 0; i < nneighbors; ++i) {
+    unsigned rank = msg_ranks[msg_of_recvd[i]];
+    unsigned j;
+    for (j = 0; j < nneighbors; ++j)
+      if (ranks[j] == rank)
+        break;
+    assert(j < nneighbors);
+    loads[j] = recvd[i * 2 + 0];
+    degrees[j] = (unsigned) recvd[i * 2 + 1];
+  }
+  loop_host_free(recvd);
+  loop_host_free(msg_ranks);
+  loop_host_free(msg_of_recvd);
+  free_exchanger(ex);
+}
+
+LOOP_KERNEL(mark_shared_kern,
+    unsigned rank,
+    unsigned width,
+    unsigned const* sharers,
+    unsigned* marked)
+  marked[i] = 0;
+  for (unsigned j = 0; j < width; ++j)
+    if (sharers[i * width + j] == rank)
+      marked[i] = 1;
+}
+
+static unsigned* mark_verts_shared_with(struct mesh* m, unsigned rank,
+    unsigned const* sharers, unsigned width)
+{
+  unsigned nverts = mesh_count(m, 0);
+  unsigned* marked = LOOP_MALLOC(unsigned, nverts);
+  LOOP_EXEC(mark_shared_kern, nverts, rank, width, sharers, marked);
+  return marked;
+}
+
+/* gives (rank) about (flow) worth of elements, starting with
+   those touching the vertices shared with it and going one
+   layer deeper at a time. taking elements until the flow is
+   met is sequential, so (weights) and (dests) are host arrays
+   and each layer is copied over to the host */
+
+static void send_layers(
+    struct mesh* m,
+    unsigned const* sharers,
+    unsigned width,
+    unsigned rank,
+    double const* weights,
+    double flow,
+    unsigned* dests)
+{
+  unsigned self = comm_rank();
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  unsigned* verts = mark_verts_shared_with(m, rank, sharers, width);
+  double sent = 0;
+  for (unsigned layer = 0; layer < MAX_LAYERS; ++layer) {
+    unsigned* elems = mesh_mark_up(m, 0, dim, verts);
+    loop_free(verts);
+    unsigned* host_elems = uints_to_host(elems, nelems);
+    unsigned full = 0;
+    for (unsigned i = 0; i < nelems; ++i) {
+      if (!host_elems[i] || dests[i] != self)
+        continue;
+      if (sent + weights[i] / 2 >= flow) {
+        full = 1;
+        break;
+      }
+      dests[i] = rank;
+      sent += weights[i];
+    }
+    loop_host_free(host_elems);
+    if (full || layer + 1 == MAX_LAYERS) {
+      loop_free(elems);
+      return;
+    }
+    verts = mesh_mark_down_local(m, dim, 0, elems);
+    loop_free(elems);
+  }
+}
+
+static unsigned* choose_dests(struct mesh* m, double const* weights,
+    double load)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  double* host_weights = doubles_to_host(weights, nelems);
+  unsigned* host_dests = LOOP_HOST_MALLOC(unsigned, nelems);
+  for (unsigned i = 0; i < nelems; ++i)
+    host_dests[i] = comm_rank();
+  unsigned width;
+  unsigned* sharers = get_vert_sharers(m, &width);
+  unsigned nneighbors;
+  unsigned* ranks = get_neighbor_ranks(m, sharers, width, &nneighbors);
+  double* loads = LOOP_HOST_MALLOC(double, nneighbors);
+  unsigned* degrees = LOOP_HOST_MALLOC(unsigned, nneighbors);
+  get_neighbor_loads(nneighbors, ranks, load, loads, degrees);
+  for (unsigned i = 0; i < nneighbors; ++i) {
+    if (loads[i] >= load)
+      continue;
+    unsigned degree = nneighbors;
+    if (degrees[i] > degree)
+      degree = degrees[i];
+    double flow = (load - loads[i]) / (degree + 1);
+    send_layers(m, sharers, width, ranks[i], host_weights, flow,
+        host_dests);
+  }
+  loop_free(sharers);
+  loop_host_free(ranks);
+  loop_host_free(loads);
+  loop_host_free(degrees);
+  loop_host_free(host_weights);
+  unsigned* dests = uints_to_device(host_dests, nelems);
+  loop_host_free(host_dests);
+  return dests;
+}
+
+static void migrate_to_dests(struct mesh* m, unsigned const* dests)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  struct exchanger* ex = new_exchanger(nelems, dests);
+  unsigned* ids = uints_linear(nelems, 1);
+  unsigned* recvd_ids = exchange_uints(ex, 1, ids, EX_FOR, EX_ITEM);
+  loop_free(ids);
+  unsigned* ranks = uints_filled(nelems, comm_rank());
+  unsigned* recvd_ranks = exchange_uints(ex, 1, ranks, EX_FOR, EX_ITEM);
+  loop_free(ranks);
+  unsigned nrecvd = ex->nitems[EX_REV];
+  free_exchanger(ex);
+  migrate_mesh(m, nrecvd, recvd_ranks, recvd_ids);
+  loop_free(recvd_ranks);
+  loop_free(recvd_ids);
+}
+
+LOOP_KERNEL(leaving_kern,
+    unsigned self,
+    unsigned const* dests,
+    unsigned* leaving)
+  leaving[i] = (dests[i] != self);
+}
+
+static unsigned count_leaving(unsigned n, unsigned const* dests)
+{
+  unsigned* leaving = LOOP_MALLOC(unsigned, n);
+  LOOP_EXEC(leaving_kern, n, comm_rank(), dests, leaving);
+  unsigned c = uints_sum(leaving, n);
+  loop_free(leaving);
+  return c;
+}
+
+static double get_imbalance(double load)
+{
+  double total = load;
+  double max = load;
+  struct comm_reduction* r = comm_new_reduction();
+  comm_defer_add_double(r, &total);
+  comm_defer_max_double(r, &max);
+  comm_reduce(r);
+  comm_free_reduction(r);
+  return max / (total / comm_size());
+}
+
+unsigned long balance_mesh_diffusive(struct mesh* m, double max_imbalance)
+{
+  assert(mesh_is_parallel(m));
+  trace_begin("balance_mesh_diffusive");
+  mesh_ensure_ghosting(m, 0);
+  unsigned dim = mesh_dim(m);
+  unsigned long nmoved = 0;
+  unsigned long nbytes = 0;
+  unsigned round;
+  double imbalance;
+  for (round = 0; 1; ++round) {
+    unsigned nelems = mesh_count(m, dim);
+    double* weights = element_weights(m);
+    double load = doubles_sum(weights, nelems);
+    imbalance = get_imbalance(load);
+    if (imbalance <= max_imbalance || round == MAX_ROUNDS) {
+      loop_free(weights);
+      break;
+    }
+    unsigned* dests = choose_dests(m, weights, load);
+    loop_free(weights);
+    unsigned long nleaving = comm_add_ulong(count_leaving(nelems, dests));
+    if (!nleaving) {
+      loop_free(dests);
+      break;
+    }
+    nmoved += nleaving;
+    nbytes += nleaving * mesh_migration_bytes_per_elem(m);
+    migrate_to_dests(m, dests);
+    loop_free(dests);
+  }
+  if (comm_rank() == 0)
+    printf("diffusive rebalance moved %lu elements (%lu bytes) "
+        "in %u rounds, imbalance %.3f\n",
+        nmoved, nbytes, round, imbalance);
+  trace_end();
+  return nbytes;
+}
+
+unsigned long mesh_inertial_migration_bytes(struct mesh* m)
+{
+  assert(mesh_is_parallel(m));
+  unsigned n;
+  unsigned* orig_ranks;
+  unsigned* orig_ids;
+  mesh_inertial_partition(m, &n, &orig_ranks, &orig_ids);
+  loop_free(orig_ids);
+  unsigned long nmoved = comm_add_ulong(count_leaving(n, orig_ranks));
+  loop_free(orig_ranks);
+  return nmoved * mesh_migration_bytes_per_elem(m);
+}
@@ -0,0 +1,33 @@
+#ifndef DIFFUSIVE_BALANCE_H
+#define DIFFUSIVE_BALANCE_H
+
+struct mesh;
+
+/* an incremental alternative to balance_mesh_inertial for
+ * meshes that are already nearly balanced, as they are
+ * between adapt passes. each round, ranks heavier than a
+ * neighbor (any rank holding one of their vertices, not
+ * just its owner or copies, so parts meeting at vertices
+ * owned by a third part see each other) hand it the
+ * layers of elements along their shared boundary, so only
+ * a thin band of elements changes ranks instead of most
+ * of the mesh. rounds repeat until the heaviest rank is at
+ * most (max_imbalance) times the average, or nothing moves.
+ * element weights come from the "balance_weight" tag as for
+ * balance_mesh_inertial.
+ * prints and returns the number of bytes of element data
+ * migrated (connectivity, global numbers and tags).
+ */
+unsigned long balance_mesh_diffusive(struct mesh* m, double max_imbalance);
+
+/* what migrate_mesh ships per element: its vertices,
+   its global number and its tags */
+unsigned long mesh_migration_bytes_per_elem(struct mesh* m);
+
+/* the bytes of element data balance_mesh_inertial would
+   migrate, counted the same way. this runs the whole
+   inertial partition, but leaves the mesh (and its
+   ghosting) as it is */
+unsigned long mesh_inertial_migration_bytes(struct mesh* m);
+
+#endif
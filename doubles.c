@@ -94,7 +94,7 @@ double doubles_max(double const* a, unsigned n)
   /* DBL_MIN is the smallest positive value, for dealing
      with negatives we should actually initialize to -DBL_MAX */
   double max = -DBL_MAX;
-  for (unsigned i = 1; i < n; ++i)
+  for (unsigned i = 0; i < n; ++i)
     if (a[i] > max)
       max = a[i];
   return max;
@@ -103,7 +103,7 @@ double doubles_max(double const* a, unsigned n)
 double doubles_min(double const* a, unsigned n)
 {
   double min = DBL_MAX;
-  for (unsigned i = 1; i < n; ++i)
+  for (unsigned i = 0; i < n; ++i)
     if (a[i] < min)
       min = a[i];
   return min;
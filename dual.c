@@ -42,12 +42,14 @@ LOOP_KERNEL(element_dual_from_verts,
     unsigned verts_per_elem,
     unsigned sides_per_elem,
     unsigned verts_per_side,
+    unsigned const* rows,
     unsigned* elems_of_elems)
 
   unsigned const* const* elem_verts_of_sides =
       the_canonical_orders[elem_dim][side_dim][0];
-  unsigned const* verts_of_elem = verts_of_elems + i * verts_per_elem;
-  unsigned* elems_of_elem = elems_of_elems + i * sides_per_elem;
+  unsigned elem = rows ? rows[i] : i;
+  unsigned const* verts_of_elem = verts_of_elems + elem * verts_per_elem;
+  unsigned* elems_of_elem = elems_of_elems + elem * sides_per_elem;
   for (unsigned j = 0; j < sides_per_elem; ++j) {
     unsigned const* elem_verts_of_side = elem_verts_of_sides[j];
     unsigned buf[MAX_UP];
@@ -68,7 +70,7 @@ LOOP_KERNEL(element_dual_from_verts,
             elems_of_verts + first_use,
             buf,
             end_use - first_use,
-            i);
+            elem);
       }
     }
     assert(buf_size <= 1);
@@ -97,10 +99,34 @@ unsigned* dual_from_verts(
       verts_per_elem,
       sides_per_elem,
       verts_per_side,
+      0,
       elems_of_elems);
   return elems_of_elems;
 }
 
+void dual_from_verts_rows(
+    unsigned elem_dim,
+    unsigned nrows,
+    unsigned const* rows,
+    unsigned const* verts_of_elems,
+    unsigned const* elems_of_verts_offsets,
+    unsigned const* elems_of_verts,
+    unsigned* elems_of_elems)
+{
+  unsigned side_dim = elem_dim - 1;
+  LOOP_EXEC(element_dual_from_verts, nrows,
+      elem_dim,
+      side_dim,
+      verts_of_elems,
+      elems_of_verts_offsets,
+      elems_of_verts,
+      the_down_degrees[elem_dim][0],
+      the_down_degrees[elem_dim][side_dim],
+      the_down_degrees[side_dim][0],
+      rows,
+      elems_of_elems);
+}
+
 unsigned* mesh_get_dual_from_verts(struct mesh* m)
 {
   unsigned elem_dim = mesh_dim(m);
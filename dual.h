@@ -13,6 +13,16 @@ unsigned* dual_from_verts(
     unsigned const* elems_of_verts_offsets,
     unsigned const* elems_of_verts);
 
+/* fills in only the rows of the (nrows) elements listed in (rows) */
+void dual_from_verts_rows(
+    unsigned elem_dim,
+    unsigned nrows,
+    unsigned const* rows,
+    unsigned const* verts_of_elems,
+    unsigned const* elems_of_verts_offsets,
+    unsigned const* elems_of_verts,
+    unsigned* elems_of_elems);
+
 unsigned* dual_from_sides(
     unsigned elem_dim,
     unsigned nelems,
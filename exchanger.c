@@ -10,82 +10,177 @@
 #include "invert_map.h"
 #include "loop.h"
 #include "tag.h"
+#include "trace.h"
 
 /* given an array that indicates which rank an
    entry is going to,
    this function organizes them into one message
    per destination rank.
-   we rely on the assumption that the number of
-   messages (nsends) is small to settle on a runtime
-   that is O(nsent * nsends * log(nsent)).
-   the log(nsent) comes from the runtime of uints_exscan.
+   it is a stable counting sort by destination rank:
+   the entries are cut into fixed-size blocks,
+   each block counts its entries per message,
+   an exclusive scan over the (message, block) table
+   gives each block its place inside each message,
+   and each block then scatters its entries there.
+   messages are ordered by the first entry going
+   to them, and entries keep their relative order
+   inside a message.
+   the runtime is O(nsent + nsends * nblocks + nranks).
 */
 
-static void sends_from_dest_ranks(
+#define SORT_BLOCK 1024
+
+LOOP_KERNEL(mark_dest_rank,
+    unsigned const* dest_rank_of_sent,
+    unsigned* is_dest)
+  is_dest[dest_rank_of_sent[i]] = 1;
+}
+
+LOOP_INOUT static inline unsigned
+block_end(unsigned nsent, unsigned block)
+{
+  unsigned end = (block + 1) * SORT_BLOCK;
+  if (end > nsent)
+    return nsent;
+  return end;
+}
+
+LOOP_KERNEL(count_block,
+    unsigned nsent,
+    unsigned nblocks,
+    unsigned const* dest_rank_of_sent,
+    unsigned const* msg_of_ranks,
+    unsigned* counts,
+    unsigned* firsts)
+  unsigned end = block_end(nsent, i);
+  for (unsigned j = i * SORT_BLOCK; j < end; ++j) {
+    unsigned k = msg_of_ranks[dest_rank_of_sent[j]] * nblocks + i;
+    if (!counts[k])
+      firsts[k] = j;
+    ++counts[k];
+  }
+}
+
+LOOP_KERNEL(mark_first_of_msg,
+    unsigned nblocks,
+    unsigned const* counts,
+    unsigned const* firsts,
+    unsigned* first_of_msgs,
+    unsigned* is_first)
+  unsigned b;
+  for (b = 0; !counts[i * nblocks + b]; ++b);
+  first_of_msgs[i] = firsts[i * nblocks + b];
+  is_first[first_of_msgs[i]] = 1;
+}
+
+LOOP_KERNEL(order_msg,
+    unsigned const* first_of_msgs,
+    unsigned const* first_offsets,
+    unsigned* new_of_msgs)
+  new_of_msgs[i] = first_offsets[first_of_msgs[i]];
+}
+
+LOOP_KERNEL(order_rank,
+    unsigned const* is_dest,
+    unsigned const* new_of_msgs,
+    unsigned* msg_of_ranks,
+    unsigned* send_ranks)
+  if (!is_dest[i])
+    return;
+  msg_of_ranks[i] = new_of_msgs[msg_of_ranks[i]];
+  send_ranks[msg_of_ranks[i]] = i;
+}
+
+LOOP_KERNEL(order_counts,
+    unsigned nblocks,
+    unsigned const* new_of_msgs,
+    unsigned const* counts,
+    unsigned* sorted_counts)
+  unsigned msg = i / nblocks;
+  unsigned b = i % nblocks;
+  sorted_counts[new_of_msgs[msg] * nblocks + b] = counts[i];
+}
+
+LOOP_KERNEL(msg_offset,
+    unsigned nblocks,
+    unsigned const* block_offsets,
+    unsigned* send_offsets)
+  send_offsets[i] = block_offsets[i * nblocks];
+}
+
+LOOP_KERNEL(scatter_block,
     unsigned nsent,
+    unsigned nblocks,
     unsigned const* dest_rank_of_sent,
+    unsigned const* msg_of_ranks,
+    unsigned* cursors,
+    unsigned* send_of_sent,
+    unsigned* send_shuffle)
+  unsigned end = block_end(nsent, i);
+  for (unsigned j = i * SORT_BLOCK; j < end; ++j) {
+    unsigned msg = msg_of_ranks[dest_rank_of_sent[j]];
+    send_of_sent[j] = msg;
+    send_shuffle[j] = cursors[msg * nblocks + i]++;
+  }
+}
+
+void sends_from_dest_ranks(
+    unsigned nsent,
+    unsigned const* dest_rank_of_sent,
+    unsigned nranks,
     unsigned** p_send_of_sent,
     unsigned** p_send_shuffle,
     unsigned* p_nsends,
     unsigned** p_send_ranks,
     unsigned** p_send_offsets)
 {
-  /* queued[i]==1 iff (i) is not part of a message yet */
-  unsigned* queued = LOOP_MALLOC(unsigned, nsent);
-  for (unsigned i = 0; i < nsent; ++i)
-    queued[i] = 1;
+  unsigned nblocks = (nsent + SORT_BLOCK - 1) / SORT_BLOCK;
+  /* number the destination ranks in ascending order first */
+  unsigned* is_dest = uints_filled(nranks, 0);
+  LOOP_EXEC(mark_dest_rank, nsent, dest_rank_of_sent, is_dest);
+  unsigned* msg_of_ranks = uints_exscan(is_dest, nranks);
+  unsigned nsends = uints_at(msg_of_ranks, nranks);
+  unsigned ncells = nsends * nblocks;
+  unsigned* counts = uints_filled(ncells, 0);
+  unsigned* firsts = LOOP_MALLOC(unsigned, ncells);
+  LOOP_EXEC(count_block, nblocks, nsent, nblocks, dest_rank_of_sent,
+      msg_of_ranks, counts, firsts);
+  /* then renumber messages by their first entry */
+  unsigned* first_of_msgs = LOOP_MALLOC(unsigned, nsends);
+  unsigned* is_first = uints_filled(nsent, 0);
+  LOOP_EXEC(mark_first_of_msg, nsends, nblocks, counts, firsts,
+      first_of_msgs, is_first);
+  loop_free(firsts);
+  unsigned* first_offsets = uints_exscan(is_first, nsent);
+  loop_free(is_first);
+  unsigned* new_of_msgs = LOOP_MALLOC(unsigned, nsends);
+  LOOP_EXEC(order_msg, nsends, first_of_msgs, first_offsets, new_of_msgs);
+  loop_free(first_of_msgs);
+  loop_free(first_offsets);
+  unsigned* send_ranks = LOOP_MALLOC(unsigned, nsends);
+  LOOP_EXEC(order_rank, nranks, is_dest, new_of_msgs, msg_of_ranks,
+      send_ranks);
+  loop_free(is_dest);
+  unsigned* sorted_counts = LOOP_MALLOC(unsigned, ncells);
+  LOOP_EXEC(order_counts, ncells, nblocks, new_of_msgs, counts,
+      sorted_counts);
+  loop_free(new_of_msgs);
+  loop_free(counts);
+  unsigned* cursors = uints_exscan(sorted_counts, ncells);
+  loop_free(sorted_counts);
+  unsigned* send_offsets = LOOP_MALLOC(unsigned, nsends + 1);
+  LOOP_EXEC(msg_offset, nsends + 1, nblocks, cursors, send_offsets);
   unsigned* send_of_sent = LOOP_MALLOC(unsigned, nsent);
   unsigned* send_shuffle = LOOP_MALLOC(unsigned, nsent);
-  unsigned* send_offsets = LOOP_MALLOC(unsigned, nsent + 1);
-  unsigned* send_ranks = LOOP_MALLOC(unsigned, nsent);
-  /* loop over messages, we don't know how many but
-     there certainly won't be more than (nsent) */
-  send_offsets[0] = 0;
-  unsigned send;
-  for (send = 0; send < nsent; ++send) {
-    unsigned current_rank = 0;
-    unsigned* queue_offsets = uints_exscan(queued, nsent);
-    unsigned nqueued = uints_at(queue_offsets, nsent);
-    if (nqueued == 0) {
-      loop_free(queue_offsets);
-      break; /* stop when all entries are part of a message */
-    }
-    /* process the rank of the first queued entry */
-    for (unsigned i = 0; i < nsent; ++i)
-      if ((queue_offsets[i + 1] - queue_offsets[i] == 1) &&
-          queue_offsets[i] == 0)
-        current_rank = dest_rank_of_sent[i];
-    send_ranks[send] = current_rank;
-    loop_free(queue_offsets);
-    unsigned* to_rank = LOOP_MALLOC(unsigned, nsent);
-    for (unsigned i = 0; i < nsent; ++i) {
-      if (dest_rank_of_sent[i] == current_rank) {
-        send_of_sent[i] = send;
-        to_rank[i] = 1;
-        queued[i] = 0;
-      } else {
-        to_rank[i] = 0;
-      }
-    }
-    unsigned* send_idxs = uints_exscan(to_rank, nsent);
-    send_offsets[send + 1] = send_offsets[send] + uints_at(send_idxs, nsent);
-    for (unsigned i = 0; i < nsent; ++i)
-      if (to_rank[i])
-        send_shuffle[i] = send_idxs[i] + send_offsets[send];
-    loop_free(to_rank);
-    loop_free(send_idxs);
-  }
-  unsigned nsends = send;
-  loop_free(queued);
+  LOOP_EXEC(scatter_block, nblocks, nsent, nblocks, dest_rank_of_sent,
+      msg_of_ranks, cursors, send_of_sent, send_shuffle);
+  loop_free(cursors);
+  loop_free(msg_of_ranks);
   *p_send_of_sent = send_of_sent;
   *p_send_shuffle = send_shuffle;
   *p_nsends = nsends;
-  /* shrink these arrays to fit, they were
-     allocated to the maximum possible size of (nsent) */
-  *p_send_ranks = uints_copy(send_ranks, nsends);
-  loop_free(send_ranks);
-  *p_send_offsets = uints_copy(send_offsets, nsends + 1);
-  loop_free(send_offsets);
+  *p_send_ranks = send_ranks;
+  *p_send_offsets = send_offsets;
 }
 
 /* given the number of items to receive,
@@ -117,10 +212,12 @@ struct exchanger* new_exchanger(
     unsigned nsent,
     unsigned const* dest_rank_of_sent)
 {
+  trace_begin("new_exchanger");
+  enum mem_category cat = loop_host_set_category(MEM_EXCHANGER);
   struct exchanger* ex = LOOP_HOST_MALLOC(struct exchanger, 1);
   memset(ex, 0, sizeof(struct exchanger));
   ex->nitems[F] = nsent;
-  sends_from_dest_ranks(nsent, dest_rank_of_sent,
+  sends_from_dest_ranks(nsent, dest_rank_of_sent, comm_size(),
       &ex->msg_of_items[F], &ex->shuffles[F], &ex->nmsgs[F], &ex->ranks[F],
       &ex->msg_offsets[F]);
   ex->msg_counts[F] = uints_unscan(ex->msg_offsets[F], ex->nmsgs[F]);
@@ -134,6 +231,8 @@ struct exchanger* new_exchanger(
       ex->nmsgs[R], ex->ranks[R], ex->msg_counts[R]);
   ex->msg_of_items[R] = make_recv_of_recvd(ex->nitems[R], ex->nmsgs[R],
       ex->msg_offsets[R]);
+  loop_host_set_category(cat);
+  trace_end();
   return ex;
 }
 
@@ -170,11 +269,28 @@ static enum exch_dir opp_dir(enum exch_dir d)
   return EX_FOR;
 }
 
+/* an exchange in flight: the packed send buffer
+   and the receive buffer both belong to it */
+
+struct exchange {
+  struct exchanger* ex;
+  struct comm_req* req;
+  void* sent;
+  void* recvd;
+  unsigned width;
+  enum exch_dir dir;
+  /* byte widths of the arrays packed by exchange_many_begin */
+  unsigned* nbytes;
+  unsigned narrays;
+  int padding__;
+};
+
 #define GENERIC_EXCHANGE(T, name) \
-T* exchange_##name(struct exchanger* ex, unsigned width, \
-    T const* data, enum exch_dir dir, enum exch_start start) \
+struct exchange* exchange_##name##_begin(struct exchanger* ex, \
+    unsigned width, T const* data, enum exch_dir dir, enum exch_start start) \
 { \
   enum exch_dir odir = opp_dir(dir); \
+  enum mem_category cat = loop_host_set_category(MEM_EXCHANGER); \
   T const* current = data; \
   T* last = 0; \
   if (start == EX_ROOT && ex->items_of_roots_offsets[dir]) { \
@@ -189,24 +305,248 @@ T* exchange_##name(struct exchanger* ex, unsigned width, \
     current = last = shuffled; \
   } \
   T* recvd = LOOP_MALLOC(T, ex->nitems[odir] * width); \
-  comm_exch_##name(ex->comms[dir], width, \
+  struct exchange* x = LOOP_HOST_MALLOC(struct exchange, 1); \
+  x->ex = ex; \
+  x->req = comm_iexch_##name(ex->comms[dir], width, \
       current, ex->msg_counts[dir], ex->msg_offsets[dir], \
       recvd,  ex->msg_counts[odir], ex->msg_offsets[odir]); \
-  loop_free(last); \
-  current = last = recvd; \
+  x->sent = last; \
+  x->recvd = recvd; \
+  x->width = width; \
+  x->dir = dir; \
+  x->nbytes = 0; \
+  x->narrays = 0; \
+  loop_host_set_category(cat); \
+  return x; \
+} \
+\
+T* exchange_##name##_end(struct exchange* x) \
+{ \
+  struct exchanger* ex = x->ex; \
+  enum exch_dir odir = opp_dir(x->dir); \
+  comm_wait(x->req); \
+  loop_free(x->sent); \
+  T* last = x->recvd; \
   if (ex->shuffles[odir]) { \
-    T* unshuffled = name##_unshuffle(ex->nitems[odir], current, width, \
+    T* unshuffled = name##_unshuffle(ex->nitems[odir], last, x->width, \
         ex->shuffles[odir]); \
     loop_free(last); \
-    current = last = unshuffled; \
+    last = unshuffled; \
   } \
+  loop_host_free(x); \
   return last; \
+} \
+\
+T* exchange_##name(struct exchanger* ex, unsigned width, \
+    T const* data, enum exch_dir dir, enum exch_start start) \
+{ \
+  return exchange_##name##_end( \
+      exchange_##name##_begin(ex, width, data, dir, start)); \
 }
 
 GENERIC_EXCHANGE(unsigned, uints)
 GENERIC_EXCHANGE(unsigned long, ulongs)
 GENERIC_EXCHANGE(double, doubles)
 
+/* the arrays given to exchange_many are interleaved into
+   one record per item, so the whole batch goes out as a
+   single message per neighbor. packing also does the
+   expansion and shuffle, and unpacking the unshuffle */
+
+LOOP_KERNEL(pack_kern,
+    unsigned char const* a,
+    unsigned nbytes,
+    unsigned const* offsets,
+    unsigned const* shuffle,
+    unsigned record,
+    unsigned at,
+    unsigned char* packed)
+  unsigned first = offsets ? offsets[i] : i;
+  unsigned end = offsets ? offsets[i + 1] : i + 1;
+  for (unsigned j = first; j < end; ++j) {
+    unsigned k = shuffle ? shuffle[j] : j;
+    for (unsigned b = 0; b < nbytes; ++b)
+      packed[k * record + at + b] = a[i * nbytes + b];
+  }
+}
+
+LOOP_KERNEL(unpack_kern,
+    unsigned char const* packed,
+    unsigned record,
+    unsigned at,
+    unsigned const* shuffle,
+    unsigned nbytes,
+    unsigned char* a)
+  unsigned k = shuffle ? shuffle[i] : i;
+  for (unsigned b = 0; b < nbytes; ++b)
+    a[i * nbytes + b] = packed[k * record + at + b];
+}
+
+static unsigned record_size(unsigned narrays, unsigned const* nbytes)
+{
+  unsigned record = 0;
+  for (unsigned i = 0; i < narrays; ++i)
+    record += nbytes[i];
+  return record;
+}
+
+static void pack_many(struct exchanger* ex, unsigned narrays,
+    unsigned const* nbytes, void const* const* data,
+    enum exch_dir dir, enum exch_start start, unsigned char* packed)
+{
+  unsigned const* offsets = 0;
+  unsigned nsrcs = ex->nitems[dir];
+  if (start == EX_ROOT && ex->items_of_roots_offsets[dir]) {
+    offsets = ex->items_of_roots_offsets[dir];
+    nsrcs = ex->nroots[dir];
+  }
+  unsigned record = record_size(narrays, nbytes);
+  unsigned at = 0;
+  for (unsigned k = 0; k < narrays; ++k) {
+    LOOP_EXEC(pack_kern, nsrcs, data[k], nbytes[k], offsets,
+        ex->shuffles[dir], record, at, packed);
+    at += nbytes[k];
+  }
+}
+
+static void unpack_many(struct exchanger* ex, unsigned narrays,
+    unsigned const* nbytes, unsigned char const* packed,
+    enum exch_dir dir, void* const* out)
+{
+  enum exch_dir odir = opp_dir(dir);
+  unsigned n = ex->nitems[odir];
+  unsigned record = record_size(narrays, nbytes);
+  unsigned at = 0;
+  for (unsigned k = 0; k < narrays; ++k) {
+    LOOP_EXEC(unpack_kern, n, packed, record, at, ex->shuffles[odir],
+        nbytes[k], out[k]);
+    at += nbytes[k];
+  }
+}
+
+struct exchange* exchange_many_begin(struct exchanger* ex, unsigned narrays,
+    unsigned const* nbytes, void const* const* data,
+    enum exch_dir dir, enum exch_start start)
+{
+  enum exch_dir odir = opp_dir(dir);
+  enum mem_category cat = loop_host_set_category(MEM_EXCHANGER);
+  unsigned record = record_size(narrays, nbytes);
+  unsigned char* packed = LOOP_MALLOC(unsigned char,
+      ex->nitems[dir] * record);
+  pack_many(ex, narrays, nbytes, data, dir, start, packed);
+  unsigned char* recvd = LOOP_MALLOC(unsigned char,
+      ex->nitems[odir] * record);
+  struct exchange* x = LOOP_HOST_MALLOC(struct exchange, 1);
+  x->ex = ex;
+  x->req = comm_iexch_uchars(ex->comms[dir], record,
+      packed, ex->msg_counts[dir], ex->msg_offsets[dir],
+      recvd, ex->msg_counts[odir], ex->msg_offsets[odir]);
+  x->sent = packed;
+  x->recvd = recvd;
+  x->width = record;
+  x->dir = dir;
+  x->nbytes = LOOP_HOST_MALLOC(unsigned, narrays);
+  for (unsigned i = 0; i < narrays; ++i)
+    x->nbytes[i] = nbytes[i];
+  x->narrays = narrays;
+  loop_host_set_category(cat);
+  return x;
+}
+
+void exchange_many_end(struct exchange* x, void** out)
+{
+  struct exchanger* ex = x->ex;
+  enum exch_dir odir = opp_dir(x->dir);
+  comm_wait(x->req);
+  loop_free(x->sent);
+  unsigned n = ex->nitems[odir];
+  for (unsigned k = 0; k < x->narrays; ++k)
+    out[k] = LOOP_MALLOC(unsigned char, n * x->nbytes[k]);
+  unpack_many(ex, x->narrays, x->nbytes, x->recvd, x->dir, out);
+  loop_free(x->recvd);
+  loop_host_free(x->nbytes);
+  loop_host_free(x);
+}
+
+void exchange_many(struct exchanger* ex, unsigned narrays,
+    unsigned const* nbytes, void const* const* data,
+    enum exch_dir dir, enum exch_start start, void** out)
+{
+  exchange_many_end(exchange_many_begin(ex, narrays, nbytes, data,
+        dir, start), out);
+}
+
+/* a plan fixes the arrays layout of exchange_many
+   and keeps its buffers and MPI requests around */
+
+struct exchange_plan {
+  struct exchanger* ex;
+  struct comm_plan* plan;
+  unsigned char* sent;
+  unsigned char* recvd;
+  unsigned* nbytes;
+  unsigned narrays;
+  enum exch_dir dir;
+  enum exch_start start;
+  int padding__;
+};
+
+struct exchange_plan* new_exchange_plan(struct exchanger* ex,
+    unsigned narrays, unsigned const* nbytes,
+    enum exch_dir dir, enum exch_start start)
+{
+  enum exch_dir odir = opp_dir(dir);
+  enum mem_category cat = loop_host_set_category(MEM_EXCHANGER);
+  struct exchange_plan* p = LOOP_HOST_MALLOC(struct exchange_plan, 1);
+  unsigned record = record_size(narrays, nbytes);
+  p->ex = ex;
+  p->sent = LOOP_MALLOC(unsigned char, ex->nitems[dir] * record);
+  p->recvd = LOOP_MALLOC(unsigned char, ex->nitems[odir] * record);
+  p->plan = comm_plan_uchars(ex->comms[dir], record,
+      p->sent, ex->msg_counts[dir], ex->msg_offsets[dir],
+      p->recvd, ex->msg_counts[odir], ex->msg_offsets[odir]);
+  p->nbytes = LOOP_HOST_MALLOC(unsigned, narrays);
+  for (unsigned i = 0; i < narrays; ++i)
+    p->nbytes[i] = nbytes[i];
+  p->narrays = narrays;
+  p->dir = dir;
+  p->start = start;
+  loop_host_set_category(cat);
+  return p;
+}
+
+unsigned exchange_plan_fits(struct exchange_plan* p,
+    unsigned narrays, unsigned const* nbytes)
+{
+  if (p->narrays != narrays)
+    return 0;
+  for (unsigned i = 0; i < narrays; ++i)
+    if (p->nbytes[i] != nbytes[i])
+      return 0;
+  return 1;
+}
+
+void exchange_plan_begin(struct exchange_plan* p, void const* const* data)
+{
+  pack_many(p->ex, p->narrays, p->nbytes, data, p->dir, p->start, p->sent);
+  comm_plan_start(p->plan);
+}
+
+void exchange_plan_end(struct exchange_plan* p, void* const* out)
+{
+  comm_plan_wait(p->plan);
+  unpack_many(p->ex, p->narrays, p->nbytes, p->recvd, p->dir, out);
+}
+
+void free_exchange_plan(struct exchange_plan* p)
+{
+  comm_plan_free(p->plan);
+  loop_free(p->sent);
+  loop_free(p->recvd);
+  loop_host_free(p->nbytes);
+  loop_host_free(p);
+}
+
 void free_exchanger(struct exchanger* ex)
 {
   for (unsigned i = 0; i < 2; ++i) {
@@ -262,3 +602,19 @@ double* exchange_doubles_max(struct exchanger* ex, unsigned width,
   loop_free(to_reduce);
   return out;
 }
+
+#define GENERIC_EXCHANGE_MIN(T, name) \
+T* exchange_##name##_min(struct exchanger* ex, unsigned width, \
+    T const* data, enum exch_dir dir, enum exch_start start) \
+{ \
+  T* to_reduce = exchange_##name(ex, width, data, dir, start); \
+  enum exch_dir od = opp_dir(dir); \
+  T* out = LOOP_MALLOC(T, width * ex->nroots[od]); \
+  name##_min_into(ex->nroots[od], width, to_reduce, \
+      ex->items_of_roots_offsets[od], out); \
+  loop_free(to_reduce); \
+  return out; \
+}
+
+GENERIC_EXCHANGE_MIN(unsigned, uints)
+GENERIC_EXCHANGE_MIN(unsigned long, ulongs)
@@ -2,6 +2,8 @@
 #define EXCHANGER_H
 
 struct comm;
+struct exchange;
+struct exchange_plan;
 
 enum exch_dir {
   EX_FOR,
@@ -68,6 +70,18 @@ struct exchanger* new_exchanger(
     unsigned nsent,
     unsigned const* dest_rank_of_sent);
 
+/* sorts (nsent) items by destination rank into
+   one message per rank, the ranks being less than (nranks) */
+void sends_from_dest_ranks(
+    unsigned nsent,
+    unsigned const* dest_rank_of_sent,
+    unsigned nranks,
+    unsigned** p_send_of_sent,
+    unsigned** p_send_shuffle,
+    unsigned* p_nsends,
+    unsigned** p_send_ranks,
+    unsigned** p_send_offsets);
+
 void set_exchanger_dests(
     struct exchanger* ex,
     /* number of destinations on this MPI rank
@@ -88,6 +102,49 @@ double* exchange_doubles(struct exchanger* ex, unsigned width,
 unsigned long* exchange_ulongs(struct exchanger* ex, unsigned width,
     unsigned long const* data, enum exch_dir dir, enum exch_start start);
 
+/* split-phase versions of the above, so that work can
+   be done while messages are in flight.
+   (data) is packed into a send buffer by _begin when
+   expanding or shuffling, otherwise it must stay untouched
+   until the matching _end, which returns what the
+   blocking call would have returned */
+struct exchange* exchange_uints_begin(struct exchanger* ex, unsigned width,
+    unsigned const* data, enum exch_dir dir, enum exch_start start);
+unsigned* exchange_uints_end(struct exchange* x);
+struct exchange* exchange_doubles_begin(struct exchanger* ex, unsigned width,
+    double const* data, enum exch_dir dir, enum exch_start start);
+double* exchange_doubles_end(struct exchange* x);
+struct exchange* exchange_ulongs_begin(struct exchanger* ex, unsigned width,
+    unsigned long const* data, enum exch_dir dir, enum exch_start start);
+unsigned long* exchange_ulongs_end(struct exchange* x);
+
+/* exchanges (narrays) arrays of any types at once,
+   in a single message per neighbor.
+   (nbytes[i]) is the size in bytes of one entry of (data[i])
+   (the width times the size of the type), and
+   (out[i]) receives what exchange_* would have returned */
+struct exchange* exchange_many_begin(struct exchanger* ex, unsigned narrays,
+    unsigned const* nbytes, void const* const* data,
+    enum exch_dir dir, enum exch_start start);
+void exchange_many_end(struct exchange* x, void** out);
+void exchange_many(struct exchanger* ex, unsigned narrays,
+    unsigned const* nbytes, void const* const* data,
+    enum exch_dir dir, enum exch_start start, void** out);
+
+/* a persistent exchange_many for one layout of arrays,
+   with its buffers and messages set up once.
+   _end writes into the given (out) arrays, which must
+   already have room for the results and may be the
+   same arrays that were given to _begin */
+struct exchange_plan* new_exchange_plan(struct exchanger* ex,
+    unsigned narrays, unsigned const* nbytes,
+    enum exch_dir dir, enum exch_start start);
+unsigned exchange_plan_fits(struct exchange_plan* p,
+    unsigned narrays, unsigned const* nbytes);
+void exchange_plan_begin(struct exchange_plan* p, void const* const* data);
+void exchange_plan_end(struct exchange_plan* p, void* const* out);
+void free_exchange_plan(struct exchange_plan* p);
+
 void free_exchanger(struct exchanger* ex);
 
 void reverse_exchanger(struct exchanger* ex);
@@ -97,5 +154,9 @@ struct exchanger* make_reverse_exchanger(unsigned nsent, unsigned nrecvd,
 
 double* exchange_doubles_max(struct exchanger* ex, unsigned width,
     double const* data, enum exch_dir dir, enum exch_start start);
+unsigned* exchange_uints_min(struct exchanger* ex, unsigned width,
+    unsigned const* data, enum exch_dir dir, enum exch_start start);
+unsigned long* exchange_ulongs_min(struct exchanger* ex, unsigned width,
+    unsigned long const* data, enum exch_dir dir, enum exch_start start);
 
 #endif
@@ -13,6 +13,7 @@
 #include "parallel_mesh.h"
 #include "subset.h"
 #include "tables.h"
+#include "trace.h"
 
 /* this function is analogous to
    get_vert_use_owners_of_elems
@@ -220,6 +221,7 @@ void ghost_mesh(struct mesh* m, unsigned nlayers)
   assert(mesh_ghost_layers(m) == 0);
   if (nlayers == 0)
     return;
+  trace_begin("ghost_mesh");
   struct ghost_state s;
   memset(&s, 0, sizeof(s));
   init_ghosts(&s, m);
@@ -247,10 +249,12 @@ void ghost_mesh(struct mesh* m, unsigned nlayers)
       s.resident[ELEM].ranks, s.resident[ELEM].ids);
   free_resident(&s.resident[ELEM]);
   mesh_set_ghost_layers(m, nlayers);
+  trace_end();
 }
 
 void unghost_mesh(struct mesh* m)
 {
+  trace_begin("unghost_mesh");
   unsigned dim = mesh_dim(m);
   for (unsigned d = 0; d <= dim; ++d)
     if (mesh_has_dim(m, d))
@@ -259,9 +263,9 @@ void unghost_mesh(struct mesh* m)
   unsigned* owned_elems = mesh_get_owned(m, dim);
   unsigned* offsets = uints_exscan(owned_elems, nelems);
   loop_free(owned_elems);
-  struct mesh* m_out = subset_mesh(m, dim, offsets);
+  overwrite_with_subset(m, dim, offsets);
   loop_free(offsets);
-  overwrite_mesh(m, m_out);
+  trace_end();
 }
 
 void mesh_ensure_ghosting(struct mesh* m, unsigned nlayers)
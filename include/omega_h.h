@@ -73,9 +73,13 @@ unsigned osh_adapt(osh_t m,
     double good_element_quality,
     unsigned nsliver_layers,
     unsigned max_passes) OSH_PUBLIC;
+void osh_adapt_imbalance(double max_imbalance) OSH_PUBLIC;
 
 void osh_identity_size(osh_t m, char const* name) OSH_PUBLIC;
 
+void osh_trace_open(char const* filename) OSH_PUBLIC;
+void osh_trace_close(void) OSH_PUBLIC;
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
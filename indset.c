@@ -6,8 +6,10 @@
 #include "comm.h"
 #include "ints.h"
 #include "loop.h"
+#include "mark.h"
 #include "mesh.h"
 #include "parallel_mesh.h"
+#include "trace.h"
 
 /* given an undirected graph (usually obtained from get_star),
  * an initial filtered subset of the vertices,
@@ -23,7 +25,7 @@
  */
 
 /* the runtime of the independent set algorithm
- * as written below is O(iterations * vertices).
+ * as written below is O(iterations * undecided vertices).
  * as such we would want iterations to be small
  * and this constant is a hard ceiling above
  * which the function aborts the program
@@ -51,34 +53,33 @@ enum {
     of the longest such path). */
 
 LOOP_KERNEL(indset_at_vert,
+    unsigned const* verts,
     unsigned const* offsets,
     unsigned const* adj,
     double const* goodness,
     unsigned long const* global,
     unsigned const* old_state,
     unsigned* state)
-
-  if (old_state[i] != UNKNOWN)
-    return;
-  unsigned first_adj = offsets[i];
-  unsigned end_adj = offsets[i + 1];
+  unsigned v = verts[i];
+  unsigned first_adj = offsets[v];
+  unsigned end_adj = offsets[v + 1];
   for (unsigned j = first_adj; j < end_adj; ++j)
     if (old_state[adj[j]] == IN_SET) {
-      state[i] = NOT_IN_SET;
+      state[v] = NOT_IN_SET;
       return;
     }
-  double myg = goodness[i];
+  double myg = goodness[v];
   for (unsigned j = first_adj; j < end_adj; ++j) {
     unsigned other = adj[j];
     if (old_state[other] == NOT_IN_SET)
       continue;
     double og = goodness[other];
-    if (myg == og && global[other] < global[i])
+    if (myg == og && global[other] < global[v])
       return;
     if (myg < og)
       return;
   }
-  state[i] = IN_SET;
+  state[v] = IN_SET;
 }
 
 LOOP_KERNEL(init_state,
@@ -90,6 +91,94 @@ LOOP_KERNEL(init_state,
     state[i] = NOT_IN_SET;
 }
 
+/* the vertices still UNKNOWN form a worklist per conform
+   phase, which shrinks as the set is decided. the state
+   is double buffered: the listed entries of (old_state)
+   are brought up to date after each iteration, and the
+   rest never change again. */
+
+struct worklist {
+  unsigned n;
+  int padding__;
+  unsigned* verts;
+};
+
+LOOP_KERNEL(mark_unknown_in_phase,
+    unsigned const* phases,
+    unsigned phase,
+    unsigned const* state,
+    unsigned* marked)
+  marked[i] = (phases[i] == phase && state[i] == UNKNOWN);
+}
+
+static struct worklist make_worklist(unsigned nverts,
+    unsigned const* phases, unsigned phase, unsigned const* state)
+{
+  struct worklist w;
+  unsigned* marked = LOOP_MALLOC(unsigned, nverts);
+  LOOP_EXEC(mark_unknown_in_phase, nverts, phases, phase, state, marked);
+  w.verts = collect_marked(nverts, marked, 0, &w.n);
+  loop_free(marked);
+  return w;
+}
+
+LOOP_KERNEL(update_listed,
+    unsigned const* verts,
+    unsigned const* state,
+    unsigned* old_state,
+    unsigned* still_unknown,
+    unsigned* joined)
+  unsigned v = verts[i];
+  old_state[v] = state[v];
+  still_unknown[i] = (state[v] == UNKNOWN);
+  joined[i] = (state[v] == IN_SET);
+}
+
+LOOP_KERNEL(compact_listed,
+    unsigned const* verts,
+    unsigned const* still_unknown,
+    unsigned const* offsets,
+    unsigned* out)
+  if (still_unknown[i])
+    out[offsets[i]] = verts[i];
+}
+
+/* returns how many of the listed vertices joined the set */
+
+static unsigned shrink_worklist(struct worklist* w,
+    unsigned const* state, unsigned* old_state)
+{
+  unsigned* still_unknown = LOOP_MALLOC(unsigned, w->n);
+  unsigned* joined = LOOP_MALLOC(unsigned, w->n);
+  LOOP_EXEC(update_listed, w->n, w->verts, state, old_state, still_unknown,
+      joined);
+  unsigned njoined = uints_sum(joined, w->n);
+  loop_free(joined);
+  unsigned* offsets = uints_exscan(still_unknown, w->n);
+  unsigned n = uints_at(offsets, w->n);
+  unsigned* verts = LOOP_MALLOC(unsigned, n);
+  LOOP_EXEC(compact_listed, w->n, w->verts, still_unknown, offsets, verts);
+  loop_free(still_unknown);
+  loop_free(offsets);
+  loop_free(w->verts);
+  w->verts = verts;
+  w->n = n;
+  return njoined;
+}
+
+static unsigned last_iterations = 0;
+static unsigned long last_size = 0;
+
+unsigned indset_iterations(void)
+{
+  return last_iterations;
+}
+
+unsigned long indset_size(void)
+{
+  return last_size;
+}
+
 static unsigned* find_indset(
     struct mesh* m,
     unsigned ent_dim,
@@ -102,14 +191,57 @@ static unsigned* find_indset(
 {
   unsigned* state = LOOP_MALLOC(unsigned, nverts);
   LOOP_EXEC(init_state, nverts, filter, state);
+  unsigned* old_state = uints_copy(state, nverts);
+  /* vertices owned elsewhere are overwritten by the conform
+     anyway, so only owned ones are computed: first those
+     that other ranks are waiting for, then the rest while
+     the messages are in flight */
+  unsigned* phases = mesh_conform_phases(m, ent_dim);
+  struct worklist lists[3];
+  for (unsigned phase = 0; phase < 3; ++phase)
+    lists[phase] = make_worklist(nverts, phases, phase, state);
+  loop_free(phases);
+  struct boundary_conform* bc = mesh_new_boundary_conform(m, ent_dim);
+  /* the owned vertices are exactly those in the shared and
+     interior lists, so counting the ones that join gives
+     the size of the set, which rides along with the
+     termination check in the same collective */
+  unsigned long nowned_in = 0;
+  unsigned nunknown;
+  unsigned long size;
+  struct comm_reduction* r = comm_new_reduction();
+  comm_defer_max_uint(r, &nunknown);
+  comm_defer_add_ulong(r, &size);
   for (unsigned it = 0; it < MAX_ITERATIONS; ++it) {
-    unsigned* old_state = uints_copy(state, nverts);
-    LOOP_EXEC(indset_at_vert, nverts,
+    trace_begin("indset_iteration");
+    struct worklist* shared = &lists[CONFORM_SHARED];
+    struct worklist* interior = &lists[CONFORM_INTERIOR];
+    LOOP_EXEC(indset_at_vert, shared->n, shared->verts,
         offsets, adj, goodness, global, old_state, state);
-    loop_free(old_state);
-    mesh_conform_uints(m, ent_dim, 1, &state);
-    if (comm_max_uint(uints_max(state, nverts)) < UNKNOWN)
+    boundary_conform_uints_begin(bc, state);
+    LOOP_EXEC(indset_at_vert, interior->n, interior->verts,
+        offsets, adj, goodness, global, old_state, state);
+    boundary_conform_uints_end(bc, state);
+    nunknown = 0;
+    for (unsigned phase = 0; phase < 3; ++phase) {
+      unsigned njoined = shrink_worklist(&lists[phase], state, old_state);
+      if (phase != CONFORM_GHOST)
+        nowned_in += njoined;
+      nunknown += lists[phase].n;
+    }
+    size = nowned_in;
+    comm_reduce(r);
+    trace_end();
+    if (!nunknown) {
+      last_iterations = it + 1;
+      last_size = size;
+      for (unsigned phase = 0; phase < 3; ++phase)
+        loop_free(lists[phase].verts);
+      comm_free_reduction(r);
+      free_boundary_conform(bc);
+      loop_free(old_state);
       return state;
+    }
   }
   LOOP_NORETURN(0);
 }
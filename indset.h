@@ -9,4 +9,13 @@ unsigned* mesh_find_indset(struct mesh* m, unsigned ent_dim,
 unsigned* mesh_indset_offsets(struct mesh* m, unsigned ent_dim,
     unsigned const* candidates, double const* qualities);
 
+/* how many iterations the last independent set took to
+   decide, which is the length of the longest path of
+   decreasing goodness among the candidates */
+unsigned indset_iterations(void);
+
+/* the number of members of the last independent set
+   over all ranks, counting each entity once */
+unsigned long indset_size(void);
+
 #endif
@@ -7,6 +7,7 @@
 #include "doubles.h"
 #include "loop.h"
 #include "qr.h"
+#include "trace.h"
 
 static inline void zero_3x3(double a[3][3])
 {
@@ -77,35 +78,42 @@ static void positivize_axis(double a[3])
       a[i] = -a[i];
 }
 
+/* the first three entries of (s) get the weighted sum
+   of the coordinates and the last one the total mass,
+   so one collective covers both */
+
 static void get_weighted_coords(
     unsigned n,
     double const* coords,
     double const* masses,
-    double* c,
+    double* s,
     unsigned is_global)
 {
-  for (unsigned i = 0; i < 3; ++i)
-    c[i] = 0;
-  for (unsigned i = 0; i < n; ++i)
-  for (unsigned j = 0; j < 3; ++j) {
+  for (unsigned i = 0; i < 4; ++i)
+    s[i] = 0;
+  for (unsigned i = 0; i < n; ++i) {
     double m = masses ? masses[i] : 1;
-    c[j] += coords[i * 3 + j] * m;
+    for (unsigned j = 0; j < 3; ++j)
+      s[j] += coords[i * 3 + j] * m;
+    s[3] += m;
   }
   if (is_global)
-    comm_add_doubles(c, 3);
+    comm_add_doubles(s, 4);
 }
 
 static void get_center_of_mass(
     unsigned n,
     double const* coords,
     double const* masses,
-    double lm,
+    double* p_total_mass,
     double* c,
     unsigned is_global)
 {
-  get_weighted_coords(n, coords, masses, c, is_global);
+  double s[4];
+  get_weighted_coords(n, coords, masses, s, is_global);
   for (unsigned i = 0; i < 3; ++i)
-    c[i] /= lm;
+    c[i] = s[i] / s[3];
+  *p_total_mass = s[3];
 }
 
 static void get_total_inertia(
@@ -168,53 +176,140 @@ static unsigned* mark_in(
   return in;
 }
 
-static double get_weighted_in_count(
+/* the median is found by histogram refinement: the
+   range of radii is cut into MEDIAN_BINS bins, one
+   collective sums the mass and the number of points
+   in each bin over all ranks, and the bin where the
+   mass above crosses the target becomes the range of
+   the next round. the search stops when a bin edge
+   hits the target, when the crossing bin holds a single
+   point, or after MEDIAN_MAX_ROUNDS rounds, which is
+   as fine as double precision can resolve. then the
+   end of the range closer to the target is used.
+   spread out radii take only a few rounds, about
+   log_MEDIAN_BINS of the number of points. */
+
+#define MEDIAN_BINS 256
+#define MEDIAN_MAX_ROUNDS 7
+
+static double bin_edge(double lo, double hi, double w, unsigned j)
+{
+  if (j == MEDIAN_BINS)
+    return hi;
+  return lo + j * w;
+}
+
+/* bin (MEDIAN_BINS) holds everything at or above (hi),
+   and the bins are decided by the same comparisons
+   that mark_in uses, so the mass above each edge is
+   exactly the mass that choosing it would mark.
+   the point counts follow the masses in (hist). */
+
+static void get_histogram(
     unsigned n,
-    unsigned const* in,
+    double const* radii,
     double const* masses,
-    unsigned is_global)
+    double lo,
+    double hi,
+    unsigned is_global,
+    double* hist)
 {
-  double s = 0;
-  for (unsigned i = 0; i < n; ++i)
-    if (in[i]) {
-      double m = masses ? masses[i] : 1;
-      s += m;
+  double w = (hi - lo) / MEDIAN_BINS;
+  double* counts = hist + MEDIAN_BINS + 1;
+  for (unsigned j = 0; j <= MEDIAN_BINS; ++j)
+    hist[j] = counts[j] = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    double x = radii[i];
+    if (x < lo)
+      continue;
+    unsigned k = MEDIAN_BINS;
+    if (x < hi) {
+      k = (w > 0) ? (unsigned) ((x - lo) / w) : 0;
+      if (k > MEDIAN_BINS - 1)
+        k = MEDIAN_BINS - 1;
+      while (k && x < bin_edge(lo, hi, w, k))
+        --k;
+      while (x >= bin_edge(lo, hi, w, k + 1))
+        ++k;
     }
+    hist[k] += masses ? masses[i] : 1;
+    counts[k] += 1;
+  }
   if (is_global)
-    return comm_add_double(s);
-  return s;
+    comm_add_doubles(hist, 2 * (MEDIAN_BINS + 1));
 }
 
+/* finds the radius above which lies (in_fraction)
+   of the total mass, which is the median radius
+   when (in_fraction) is one half */
+
 static void find_median_radius(
     unsigned n,
     double const* radii,
     double const* masses,
     double total_mass,
+    double in_fraction,
     unsigned is_global,
     unsigned** p_in,
     double* p_wi)
 {
-  double r = 0;
-  double dr = doubles_max(radii, n) / 2;
-  if (is_global)
-    dr = comm_max_double(dr);
-  double hm = total_mass / 2;
-  unsigned const fraction_bits = 52;
-  for (unsigned i = 0; 1; ++i) {
-    unsigned* in = mark_in(n, radii, r);
-    double wi = get_weighted_in_count(n, in, masses, is_global);
-    if (i == fraction_bits || wi == hm) {
-      *p_wi = wi;
-      *p_in = in;
-      return;
-    } else
-      loop_free(in);
-    if (wi > hm)
-      r += dr;
-    else
-      r -= dr;
-    dr /= 2;
+  double lo = doubles_min(radii, n);
+  double hi = doubles_max(radii, n);
+  if (is_global) {
+    struct comm_reduction* cr = comm_new_reduction();
+    comm_defer_min_double(cr, &lo);
+    comm_defer_max_double(cr, &hi);
+    comm_reduce(cr);
+    comm_free_reduction(cr);
+  }
+  double hm = total_mass * in_fraction;
+  double hist[2 * (MEDIAN_BINS + 1)];
+  double const* counts = hist + MEDIAN_BINS + 1;
+  double r = hi;
+  double wi = 0;
+  for (unsigned round = 0; round < MEDIAN_MAX_ROUNDS; ++round) {
+    get_histogram(n, radii, masses, lo, hi, is_global, hist);
+    double w = (hi - lo) / MEDIAN_BINS;
+    /* walk down from the top until the mass above
+       the lower edge of bin (k) reaches the target */
+    double above = hist[MEDIAN_BINS];
+    r = hi;
+    wi = above;
+    if (above >= hm)
+      break;
+    unsigned k = MEDIAN_BINS;
+    while (k && above + hist[k - 1] < hm) {
+      --k;
+      above += hist[k];
+    }
+    if (!k) {
+      r = lo;
+      wi = above;
+      break;
+    }
+    --k;
+    double below_edge = above + hist[k];
+    if (below_edge == hm) {
+      r = bin_edge(lo, hi, w, k);
+      wi = below_edge;
+      break;
+    }
+    double top = bin_edge(lo, hi, w, k + 1);
+    double bottom = bin_edge(lo, hi, w, k);
+    if (hm - above <= below_edge - hm) {
+      r = top;
+      wi = above;
+    } else {
+      r = bottom;
+      wi = below_edge;
+    }
+    if (counts[k] <= 1)
+      break;
+    lo = bottom;
+    hi = top;
   }
+  *p_in = mark_in(n, radii, r);
+  *p_wi = wi;
 }
 
 /* some types of input data have points that happen
@@ -233,6 +328,7 @@ static void find_median_radius_perturbed(
     double const* a,
     double const* masses,
     double total_mass,
+    double in_fraction,
     unsigned is_global,
     unsigned** p_in)
 {
@@ -246,9 +342,10 @@ static void find_median_radius_perturbed(
     /* pa[j]=a[j] when i=0 */
     double wi;
     double* radii = get_radii(n, coords, c, pa);
-    find_median_radius(n, radii, masses, total_mass, is_global, p_in, &wi);
+    find_median_radius(n, radii, masses, total_mass, in_fraction,
+        is_global, p_in, &wi);
     loop_free(radii);
-    double imb = fabs(2*(wi / total_mass) - 1);
+    double imb = fabs(2*(wi / total_mass - in_fraction));
     if (imb <= max_imb || i == 7)
       return;
     else
@@ -256,25 +353,31 @@ static void find_median_radius_perturbed(
   }
 }
 
-unsigned* mark_inertial_bisection(
+unsigned* mark_inertial_split(
     unsigned n,
     double const* coords,
     double const* masses,
+    double in_fraction,
     unsigned is_global)
 {
+  trace_begin("mark_inertial_split");
   double total_mass;
-  if (masses)
-    total_mass = doubles_sum(masses, n);
-  else
-    total_mass = n;
-  if (is_global)
-    total_mass = comm_add_double(total_mass);
   double c[3];
-  get_center_of_mass(n, coords, masses, total_mass, c, is_global);
+  get_center_of_mass(n, coords, masses, &total_mass, c, is_global);
   double a[3];
   get_axis(n, coords, masses, c, a, is_global);
   unsigned* in;
   find_median_radius_perturbed(n, coords, c, a,
-      masses, total_mass, is_global, &in);
+      masses, total_mass, in_fraction, is_global, &in);
+  trace_end();
   return in;
 }
+
+unsigned* mark_inertial_bisection(
+    unsigned n,
+    double const* coords,
+    double const* masses,
+    unsigned is_global)
+{
+  return mark_inertial_split(n, coords, masses, 0.5, is_global);
+}
@@ -15,4 +15,13 @@ unsigned* mark_inertial_bisection(
     double const* masses,
     unsigned is_global);
 
+/* like mark_inertial_bisection, but the marked side
+   gets (in_fraction) of the total mass instead of half */
+unsigned* mark_inertial_split(
+    unsigned n,
+    double const* coords,
+    double const* masses,
+    double in_fraction,
+    unsigned is_global);
+
 #endif
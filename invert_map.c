@@ -3,6 +3,7 @@
 #include "arrays.h"
 #include "ints.h"
 #include "loop.h"
+#include "sort.h"
 
 #ifdef LOOP_CUDA_H
 
@@ -63,51 +64,24 @@ void invert_map(
 
 #else
 
-LOOP_KERNEL(count,
-    unsigned nout,
-    unsigned const* in,
-    unsigned* counts)
-  unsigned d = in[i];
-  assert(d < nout);
-  loop_atomic_increment(&(counts[d]));
-}
+/* entry (i) of the sorted keys starts the rows of all
+   destinations after the previous key up to its own,
+   which covers empty rows too */
 
-LOOP_KERNEL(fill,
-    unsigned const* in,
-    unsigned* offsets,
-    unsigned* counts,
-    unsigned* out)
-  unsigned d = in[i];
-  unsigned o = offsets[d];
-  unsigned j = loop_atomic_increment(&(counts[d]));
-  out[o + j] = i;
+LOOP_KERNEL(find_offsets,
+    unsigned nin,
+    unsigned nout,
+    unsigned const* keys,
+    unsigned* offsets)
+  unsigned lo = (i == 0) ? 0 : keys[i - 1] + 1;
+  unsigned hi = (i == nin) ? nout : keys[i];
+  for (unsigned k = lo; k <= hi; ++k)
+    offsets[k] = i;
 }
 
-/* the atomic increments give the fill
-   kernel some non-determinism,
-   which we can counteract by sorting the sub-arrays.
-   given the assumption that these sub-arrays are small
-   (about a dozen entries),
-   we use a hand-coded selection sort.
-   there is a reward for someone who comes up with
-   an equally efficient implementation that is deterministic
-   from the start */
-
-LOOP_KERNEL(sort,
-    unsigned* offsets,
-    unsigned* out)
-  unsigned first = offsets[i];
-  unsigned end = offsets[i + 1];
-  for (unsigned j = first; j < end; ++j) {
-    unsigned min_k = j;
-    for (unsigned k = j + 1; k < end; ++k)
-      if (out[k] < out[min_k])
-        min_k = k;
-    unsigned tmp = out[j];
-    out[j] = out[min_k];
-    out[min_k] = tmp;
-  }
-}
+/* a stable radix sort of the (in) values, carrying along
+   their indices, orders the entries by destination and then
+   by source, which is exactly the sorted rows of the inverse map */
 
 void invert_map(
     unsigned nin,
@@ -116,15 +90,12 @@ void invert_map(
     unsigned** p_out,
     unsigned** p_offsets)
 {
-  unsigned* counts = uints_filled(nout, 0);
-  LOOP_EXEC(count, nin, nout, in, counts);
-  unsigned* offsets = uints_exscan(counts, nout);
-  unsigned* out = LOOP_MALLOC(unsigned, nin);
-  loop_free(counts);
-  counts = uints_filled(nout, 0);
-  LOOP_EXEC(fill, nin, in, offsets, counts, out);
-  loop_free(counts);
-  LOOP_EXEC(sort, nout, offsets, out);
+  unsigned* keys;
+  unsigned* out = sort_uints_by_bits(nin, in,
+      count_bits(nout ? nout - 1 : 0), &keys);
+  unsigned* offsets = LOOP_MALLOC(unsigned, nout + 1);
+  LOOP_EXEC(find_offsets, nin + 1, nin, nout, keys, offsets);
+  loop_free(keys);
   *p_out = out;
   *p_offsets = offsets;
 }
@@ -2,6 +2,7 @@
 #define LOOP_CUDA_H
 
 #include "loop_host.h"
+#include "loop_timing.h"
 
 #include <assert.h>
 
@@ -48,11 +49,21 @@ do { \
   assert(ret == cudaSuccess); \
 } while (0)
 
+/* kernels are asynchronous, so timing them needs a sync */
+#if LOOP_TIMING
+#define LOOP_CUDA_TIMER_SYNC() CUDACALL(cudaDeviceSynchronize())
+#else
+#define LOOP_CUDA_TIMER_SYNC()
+#endif
+
 #define LOOP_EXEC(fname, n, ...) \
+LOOP_TIMER_START(fname) \
 do { \
   fname<<<loop_ceildiv((n),LOOP_BLOCK_SIZE),LOOP_BLOCK_SIZE>>>(n,__VA_ARGS__); \
   CUDACALL(cudaGetLastError()); \
-} while(0)
+  LOOP_CUDA_TIMER_SYNC(); \
+} while(0) \
+LOOP_TIMER_STOP(n)
 
 unsigned loop_size(void);
 
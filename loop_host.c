@@ -1,54 +1,248 @@
 #include "loop_host.h"
 
 #include <assert.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+static enum mem_category current_category = MEM_OTHER;
+
+enum mem_category loop_host_set_category(enum mem_category c)
+{
+  enum mem_category old = current_category;
+  current_category = c;
+  return old;
+}
+
+static char const* const category_names[MEM_CATEGORIES] = {
+  "other",
+  "adjacency",
+  "stars",
+  "tags",
+  "exchanger",
+  "adapt",
+  "io"
+};
+
 #if MEASURE_MEMORY
-static unsigned long memory_usage = 0;
-static unsigned long high_water = 0;
+/* the accounting below is shared, so with OpenMP
+   it is touched by one thread at a time.
+   without MEASURE_MEMORY there is nothing to share
+   and the system allocator is called directly. */
 
-static void* measure_malloc(unsigned long n)
+#ifdef _OPENMP
+#define CRITICAL _Pragma("omp critical (loop_host)")
+#else
+#define CRITICAL
+#endif
+
+/* every block starts with its capacity and the category
+   it is charged to.
+   the header is 16 bytes to keep doubles aligned. */
+
+struct header {
+  unsigned long capacity;
+  unsigned long category;
+};
+
+/* usage and peaks per category, the last entry is the total */
+static unsigned long usage[MEM_CATEGORIES + 1];
+static unsigned long peak[MEM_CATEGORIES + 1];
+
+/* phases are named once and may be entered many times.
+   each open phase keeps the peaks seen since it began,
+   which go to its parent and its record when it ends. */
+
+#define MAX_PHASES 64
+#define MAX_PHASE_DEPTH 16
+#define MAX_PHASE_NAME 32
+
+struct phase {
+  char name[MAX_PHASE_NAME];
+  unsigned calls;
+  unsigned long peak[MEM_CATEGORIES + 1];
+};
+
+struct frame {
+  unsigned phase;
+  unsigned long peak[MEM_CATEGORIES + 1];
+};
+
+static struct phase phases[MAX_PHASES];
+static unsigned nphases = 0;
+static struct frame frames[MAX_PHASE_DEPTH];
+static unsigned depth = 0;
+
+static void raise_peak(unsigned long* to, unsigned c)
 {
-  unsigned long* p = malloc(n + sizeof(unsigned long));
-  p[0] = n;
-  memory_usage += n;
-  if (memory_usage > high_water)
-    high_water = memory_usage;
-  return &p[1];
+  if (usage[c] > to[c])
+    to[c] = usage[c];
 }
 
-static void measure_free(void* p)
+static void raise_peaks(unsigned long* to, unsigned long const* from)
 {
-  if (!p)
-    return;
-  unsigned long* a = p;
-  memory_usage -= a[-1];
-  free(&a[-1]);
+  for (unsigned c = 0; c <= MEM_CATEGORIES; ++c)
+    if (from[c] > to[c])
+      to[c] = from[c];
 }
 
-static void* measure_realloc(void* p, unsigned long n)
+static void charge(unsigned c, unsigned long n)
 {
-  void* q = measure_malloc(n);
-  if (p) {
-    unsigned long* a = p;
-    unsigned long common = a[-1];
-    if (n < common)
-      common = n;
-    memcpy(q, p, common);
-    measure_free(p);
+  usage[c] += n;
+  usage[MEM_CATEGORIES] += n;
+  raise_peak(peak, c);
+  raise_peak(peak, MEM_CATEGORIES);
+  if (depth) {
+    raise_peak(frames[depth - 1].peak, c);
+    raise_peak(frames[depth - 1].peak, MEM_CATEGORIES);
+  }
+}
+
+static void discharge(unsigned c, unsigned long n)
+{
+  usage[c] -= n;
+  usage[MEM_CATEGORIES] -= n;
+}
+
+void loop_host_phase_begin(char const* name)
+{
+  CRITICAL {
+    unsigned p;
+    for (p = 0; p < nphases; ++p)
+      if (!strncmp(phases[p].name, name, MAX_PHASE_NAME - 1))
+        break;
+    if (p == nphases) {
+      assert(nphases < MAX_PHASES);
+      strncpy(phases[p].name, name, MAX_PHASE_NAME - 1);
+      ++nphases;
+    }
+    ++phases[p].calls;
+    assert(depth < MAX_PHASE_DEPTH);
+    frames[depth].phase = p;
+    memcpy(frames[depth].peak, usage, sizeof(usage));
+    ++depth;
+  }
+}
+
+void loop_host_phase_end(void)
+{
+  CRITICAL {
+    assert(depth);
+    --depth;
+    raise_peaks(phases[frames[depth].phase].peak, frames[depth].peak);
+    if (depth)
+      raise_peaks(frames[depth - 1].peak, frames[depth].peak);
   }
-  return q;
 }
 
 unsigned long loop_host_memory(void)
 {
-  return memory_usage;
+  return usage[MEM_CATEGORIES];
 }
 
 unsigned long loop_host_high_water(void)
 {
-  return high_water;
+  return peak[MEM_CATEGORIES];
+}
+
+unsigned long loop_host_category_memory(enum mem_category c)
+{
+  return usage[c];
+}
+
+unsigned long loop_host_category_high_water(enum mem_category c)
+{
+  return peak[c];
+}
+
+static struct phase const* find_phase(char const* name)
+{
+  for (unsigned p = 0; p < nphases; ++p)
+    if (!strncmp(phases[p].name, name, MAX_PHASE_NAME - 1))
+      return &phases[p];
+  return 0;
+}
+
+unsigned long loop_host_phase_high_water(char const* name)
+{
+  struct phase const* p = find_phase(name);
+  return p ? p->peak[MEM_CATEGORIES] : 0;
+}
+
+unsigned long loop_host_phase_category_high_water(char const* name,
+    enum mem_category c)
+{
+  struct phase const* p = find_phase(name);
+  return p ? p->peak[c] : 0;
+}
+
+static void print_row(char const* name, unsigned long a, unsigned long b)
+{
+  printf("  %-10s %14lu %14lu\n", name, a, b);
+}
+
+void loop_host_memory_report(void)
+{
+  printf("host memory in bytes:\n");
+  printf("  %-10s %14s %14s\n", "category", "current", "peak");
+  for (unsigned c = 0; c < MEM_CATEGORIES; ++c)
+    if (peak[c])
+      print_row(category_names[c], usage[c], peak[c]);
+  print_row("total", usage[MEM_CATEGORIES], peak[MEM_CATEGORIES]);
+  for (unsigned p = 0; p < nphases; ++p) {
+    printf("phase %s (%u calls):\n", phases[p].name, phases[p].calls);
+    printf("  %-10s %14s\n", "category", "peak");
+    for (unsigned c = 0; c < MEM_CATEGORIES; ++c)
+      if (phases[p].peak[c])
+        printf("  %-10s %14lu\n", category_names[c], phases[p].peak[c]);
+    printf("  %-10s %14lu\n", "total", phases[p].peak[MEM_CATEGORIES]);
+  }
+}
+static struct header* new_block(unsigned long capacity)
+{
+  struct header* h = malloc(sizeof(struct header) + capacity);
+  assert(h);
+  h->capacity = capacity;
+  h->category = current_category;
+  charge(h->category, capacity);
+  return h;
+}
+
+static void* measure_malloc(unsigned long n)
+{
+  struct header* h;
+  CRITICAL {
+    h = new_block(n);
+  }
+  return h + 1;
+}
+
+static void* measure_realloc(void* p, unsigned long n)
+{
+  if (!p)
+    return measure_malloc(n);
+  struct header* h = ((struct header*)p) - 1;
+  if (n <= h->capacity)
+    return p;
+  CRITICAL {
+    discharge(h->category, h->capacity);
+    h = realloc(h, sizeof(struct header) + n);
+    assert(h);
+    h->capacity = n;
+    charge(h->category, n);
+  }
+  return h + 1;
+}
+
+static void measure_free(void* p)
+{
+  if (!p)
+    return;
+  struct header* h = ((struct header*)p) - 1;
+  CRITICAL {
+    discharge(h->category, h->capacity);
+    free(h);
+  }
 }
 #else
 static void* measure_malloc(unsigned long n)
@@ -66,6 +260,15 @@ static void measure_free(void* p)
   free(p);
 }
 
+void loop_host_phase_begin(char const* name)
+{
+  (void) name;
+}
+
+void loop_host_phase_end(void)
+{
+}
+
 unsigned long loop_host_memory(void)
 {
   return 0;
@@ -75,6 +278,38 @@ unsigned long loop_host_high_water(void)
 {
   return 0;
 }
+
+unsigned long loop_host_category_memory(enum mem_category c)
+{
+  (void) c;
+  return 0;
+}
+
+unsigned long loop_host_category_high_water(enum mem_category c)
+{
+  (void) c;
+  return 0;
+}
+
+unsigned long loop_host_phase_high_water(char const* name)
+{
+  (void) name;
+  return 0;
+}
+
+unsigned long loop_host_phase_category_high_water(char const* name,
+    enum mem_category c)
+{
+  (void) name;
+  (void) c;
+  return 0;
+}
+
+void loop_host_memory_report(void)
+{
+  (void) category_names;
+  printf("host memory is not measured, build with MEASURE_MEMORY=1\n");
+}
 #endif
 
 void* loop_host_malloc(unsigned long n)
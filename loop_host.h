@@ -15,7 +15,36 @@ void* loop_host_copy(void const* p, unsigned long n);
 #define LOOP_HOST_COPY(T, p, n) \
   ((T*)loop_host_copy(p, sizeof(T) * (n)))
 
+/* with MEASURE_MEMORY, host bytes are charged to the
+   category that was current when they were allocated. */
+enum mem_category {
+  MEM_OTHER,
+  MEM_ADJACENCY,
+  MEM_STARS,
+  MEM_TAGS,
+  MEM_EXCHANGER,
+  MEM_ADAPT,
+  MEM_IO,
+  MEM_CATEGORIES
+};
+
+/* returns the previous category so callers can restore it */
+enum mem_category loop_host_set_category(enum mem_category c);
+
+/* phases are named spans whose peaks are recorded
+   per category. they nest, and a name may repeat */
+void loop_host_phase_begin(char const* name);
+void loop_host_phase_end(void);
+
 unsigned long loop_host_memory(void);
 unsigned long loop_host_high_water(void);
+unsigned long loop_host_category_memory(enum mem_category c);
+unsigned long loop_host_category_high_water(enum mem_category c);
+/* the peaks seen during any call of the named phase,
+   zero for a phase that was never entered */
+unsigned long loop_host_phase_high_water(char const* name);
+unsigned long loop_host_phase_category_high_water(char const* name,
+    enum mem_category c);
+void loop_host_memory_report(void);
 
 #endif
@@ -4,6 +4,7 @@
 #include <assert.h>
 
 #include "loop_host.h"
+#include "loop_timing.h"
 
 #define LOOP_MALLOC(T, n) LOOP_HOST_MALLOC(T, n)
 #define loop_free loop_host_free
@@ -15,8 +16,10 @@ static void fname(__VA_ARGS__, unsigned i) \
 {
 
 #define LOOP_EXEC(fname, n, ...) \
+LOOP_TIMER_START(fname) \
 for (unsigned i = 0; i < n; ++i) \
-  fname(__VA_ARGS__, i);
+  fname(__VA_ARGS__, i); \
+LOOP_TIMER_STOP(n)
 
 unsigned loop_size(void);
 
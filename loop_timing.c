@@ -0,0 +1,151 @@
+#include "loop_timing.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "files.h"
+
+/* timers live in a fixed table so that recording never
+   allocates; each LOOP_EXEC site keeps a pointer to its
+   entry after the first lookup */
+
+#define MAX_TIMERS 1024
+
+struct loop_timer {
+  char const* name;
+  char const* file;
+  unsigned long calls;
+  unsigned long iterations;
+  double seconds;
+};
+
+static struct loop_timer timers[MAX_TIMERS];
+static unsigned ntimers = 0;
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+static struct loop_timer* find_timer(char const* name, char const* file)
+{
+  for (unsigned i = 0; i < ntimers; ++i)
+    if (!strcmp(timers[i].name, name) && !strcmp(timers[i].file, file))
+      return &timers[i];
+  assert(ntimers < MAX_TIMERS);
+  struct loop_timer* t = &timers[ntimers++];
+  t->name = name;
+  t->file = file;
+  return t;
+}
+
+double loop_timer_start(struct loop_timer** t,
+    char const* name, char const* file)
+{
+  if (!*t)
+    *t = find_timer(name, file);
+  return get_time();
+}
+
+void loop_timer_stop(struct loop_timer* t, unsigned n, double start)
+{
+  t->seconds += get_time() - start;
+  ++t->calls;
+  t->iterations += n;
+}
+
+static int by_seconds(void const* a, void const* b)
+{
+  struct loop_timer const* ta = *((struct loop_timer const* const*) a);
+  struct loop_timer const* tb = *((struct loop_timer const* const*) b);
+  if (ta->seconds > tb->seconds)
+    return -1;
+  if (ta->seconds < tb->seconds)
+    return 1;
+  return strcmp(ta->name, tb->name);
+}
+
+static struct loop_timer** sorted_timers(void)
+{
+  struct loop_timer** s = malloc(sizeof(struct loop_timer*) * (ntimers + 1));
+  for (unsigned i = 0; i < ntimers; ++i)
+    s[i] = &timers[i];
+  qsort(s, ntimers, sizeof(struct loop_timer*), by_seconds);
+  return s;
+}
+
+static double total_seconds(void)
+{
+  double total = 0;
+  for (unsigned i = 0; i < ntimers; ++i)
+    total += timers[i].seconds;
+  return total;
+}
+
+void loop_timing_print(void)
+{
+  if (!ntimers)
+    return;
+  struct loop_timer** s = sorted_timers();
+  double total = total_seconds();
+  printf("%-28s %-24s %10s %14s %12s %6s %9s\n", "kernel", "file",
+      "calls", "iterations", "seconds", "%", "ns/iter");
+  for (unsigned i = 0; i < ntimers; ++i) {
+    struct loop_timer const* t = s[i];
+    double per_iter = 0;
+    if (t->iterations)
+      per_iter = t->seconds * 1e9 / (double) t->iterations;
+    printf("%-28s %-24s %10lu %14lu %12.6f %6.2f %9.2f\n",
+        t->name, t->file, t->calls, t->iterations, t->seconds,
+        total > 0 ? 100 * t->seconds / total : 0, per_iter);
+  }
+  printf("%-28s %-24s %10s %14s %12.6f\n", "total", "", "", "", total);
+  free(s);
+}
+
+void loop_timing_write_json(char const* filename)
+{
+  FILE* f = safe_fopen(filename, "w");
+  struct loop_timer** s = sorted_timers();
+  fprintf(f, "{\n\"total_seconds\": %.9f,\n\"kernels\": [", total_seconds());
+  for (unsigned i = 0; i < ntimers; ++i) {
+    struct loop_timer const* t = s[i];
+    fprintf(f, "%s\n{\"name\": \"%s\", \"file\": \"%s\", "
+        "\"calls\": %lu, \"iterations\": %lu, \"seconds\": %.9f}",
+        i ? "," : "", t->name, t->file, t->calls, t->iterations, t->seconds);
+  }
+  fprintf(f, "\n]\n}\n");
+  free(s);
+  fclose(f);
+}
+
+void loop_timing_reset(void)
+{
+  for (unsigned i = 0; i < ntimers; ++i) {
+    timers[i].calls = 0;
+    timers[i].iterations = 0;
+    timers[i].seconds = 0;
+  }
+}
+
+void loop_timing_counts(char const* name,
+    unsigned long* p_calls, unsigned long* p_iterations)
+{
+  unsigned long calls = 0;
+  unsigned long iterations = 0;
+  for (unsigned i = 0; i < ntimers; ++i)
+    if (!strcmp(timers[i].name, name)) {
+      calls += timers[i].calls;
+      iterations += timers[i].iterations;
+    }
+  *p_calls = calls;
+  *p_iterations = iterations;
+}
@@ -0,0 +1,40 @@
+#ifndef LOOP_TIMING_H
+#define LOOP_TIMING_H
+
+/* with LOOP_TIMING=1 every LOOP_EXEC records its kernel's
+   calls, iterations and wall time, keyed by kernel name
+   and file. the loop_*.h headers wrap their LOOP_EXEC in
+   LOOP_TIMER_START and LOOP_TIMER_STOP, which expand to
+   nothing otherwise. */
+
+struct loop_timer;
+
+double loop_timer_start(struct loop_timer** t,
+    char const* name, char const* file);
+void loop_timer_stop(struct loop_timer* t, unsigned n, double start);
+
+/* a table sorted by total time, and the same as JSON */
+void loop_timing_print(void);
+void loop_timing_write_json(char const* filename);
+void loop_timing_reset(void);
+
+/* the calls and iterations recorded so far for the kernel
+   (name), summed over the files it is run from */
+void loop_timing_counts(char const* name,
+    unsigned long* p_calls, unsigned long* p_iterations);
+
+#if LOOP_TIMING
+#define LOOP_TIMER_START(fname) \
+do { \
+  static struct loop_timer* loop_timer__ = 0; \
+  double loop_start__ = loop_timer_start(&loop_timer__, #fname, __FILE__);
+#define LOOP_TIMER_STOP(n) \
+  ; \
+  loop_timer_stop(loop_timer__, (n), loop_start__); \
+} while (0)
+#else
+#define LOOP_TIMER_START(fname)
+#define LOOP_TIMER_STOP(n)
+#endif
+
+#endif
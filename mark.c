@@ -2,6 +2,8 @@
 
 #include <assert.h>
 
+#include "arrays.h"
+#include "ints.h"
 #include "loop.h"
 #include "mesh.h"
 #include "parallel_mesh.h"
@@ -69,6 +71,32 @@ unsigned* mark_up(
   return marked_highs;
 }
 
+LOOP_KERNEL(collect_marked_kern,
+    unsigned const* marked,
+    unsigned const* offsets,
+    unsigned* list)
+  if (marked[i])
+    list[offsets[i]] = i;
+}
+
+unsigned* collect_marked(
+    unsigned n,
+    unsigned const* marked,
+    unsigned** p_offsets,
+    unsigned* p_nlisted)
+{
+  unsigned* offsets = uints_exscan(marked, n);
+  unsigned nlisted = uints_at(offsets, n);
+  unsigned* list = LOOP_MALLOC(unsigned, nlisted);
+  LOOP_EXEC(collect_marked_kern, n, marked, offsets, list);
+  if (p_offsets)
+    *p_offsets = offsets;
+  else
+    loop_free(offsets);
+  *p_nlisted = nlisted;
+  return list;
+}
+
 unsigned* mesh_mark_down_local(struct mesh* m, unsigned high_dim, unsigned low_dim,
     unsigned const* marked_highs)
 {
@@ -233,7 +261,7 @@ static unsigned* mark_slivers(
 unsigned* mesh_mark_slivers(struct mesh* m, double good_qual, unsigned nlayers)
 {
   unsigned nelems = mesh_count(m, mesh_dim(m));
-  double* elem_quals = mesh_qualities(m);
+  double* elem_quals = mesh_adapt_qualities(m);
   unsigned* slivers = mark_slivers(nelems, elem_quals, good_qual);
   loop_free(elem_quals);
   mesh_mark_dual_layers(m, &slivers, nlayers);
@@ -14,6 +14,14 @@ unsigned* mark_up(
     unsigned const* lows_of_highs,
     unsigned const* marked_lows);
 
+/* lists the (nlisted) marked entries in order, and optionally
+   gives the exscan of (marked) that numbered them */
+unsigned* collect_marked(
+    unsigned n,
+    unsigned const* marked,
+    unsigned** p_offsets,
+    unsigned* p_nlisted);
+
 struct mesh;
 
 unsigned* mesh_mark_down_local(struct mesh* m, unsigned high_dim, unsigned low_dim,
@@ -5,6 +5,7 @@
 
 #include "arrays.h"
 #include "bridge_graph.h"
+#include "derive_by_sort.h"
 #include "derive_sides.h"
 #include "dual.h"
 #include "graph.h"
@@ -22,9 +23,27 @@ struct up {
   unsigned* directions;
 };
 
+/* the adjacency cache keeps, for each array it may free,
+   its size, when it was last asked for and how many callers
+   have pinned it */
+
+struct use {
+  unsigned long bytes;
+  unsigned long last;
+  unsigned pins;
+};
+
+enum adj_kind {
+  ADJ_DOWN,
+  ADJ_UP,
+  ADJ_STAR,
+  ADJ_DUAL
+};
+
 struct mesh {
   unsigned elem_dim;
   enum mesh_rep rep;
+  enum mesh_derive derive;
   unsigned counts[4];
   unsigned* down[4][4];
   struct up* up[4][4];
@@ -32,6 +51,13 @@ struct mesh {
   unsigned* dual;
   struct tags tags[4];
   struct parallel_mesh* parallel;
+  struct use down_use[4][4];
+  struct use up_use[4][4];
+  struct use star_use[4][4];
+  struct use dual_use;
+  unsigned long adj_budget;
+  unsigned long adj_bytes;
+  unsigned long clock;
 };
 
 static struct up* new_up(unsigned* offsets, unsigned* adj, unsigned* directions)
@@ -124,19 +150,137 @@ struct const_tag* mesh_find_tag(struct mesh* m, unsigned dim,
   return find_tag(&m->tags[dim], name);
 }
 
+static struct use* get_use(struct mesh* m, enum adj_kind kind,
+    unsigned a, unsigned b)
+{
+  switch (kind) {
+    case ADJ_DOWN: return &m->down_use[a][b];
+    case ADJ_UP: return &m->up_use[a][b];
+    case ADJ_STAR: return &m->star_use[a][b];
+    case ADJ_DUAL: return &m->dual_use;
+  }
+  return 0;
+}
+
+static unsigned is_cached(struct mesh* m, enum adj_kind kind,
+    unsigned a, unsigned b)
+{
+  switch (kind) {
+    case ADJ_DOWN: return m->down[a][b] != 0;
+    case ADJ_UP: return m->up[a][b] != 0;
+    case ADJ_STAR: return m->star[a][b] != 0;
+    case ADJ_DUAL: return m->dual != 0 && !a && !b;
+  }
+  return 0;
+}
+
+/* vertex lists define the entities themselves,
+   everything else can be derived again from them */
+
+static unsigned can_free(enum adj_kind kind, unsigned b)
+{
+  return kind != ADJ_DOWN || b != 0;
+}
+
+static void touch(struct mesh* m, enum adj_kind kind,
+    unsigned a, unsigned b)
+{
+  get_use(m, kind, a, b)->last = ++m->clock;
+}
+
+static void cache(struct mesh* m, enum adj_kind kind,
+    unsigned a, unsigned b, unsigned long bytes)
+{
+  if (!can_free(kind, b))
+    return;
+  struct use* u = get_use(m, kind, a, b);
+  u->bytes = bytes;
+  m->adj_bytes += bytes;
+  touch(m, kind, a, b);
+}
+
+static void uncache(struct mesh* m, enum adj_kind kind,
+    unsigned a, unsigned b)
+{
+  switch (kind) {
+    case ADJ_DOWN:
+      loop_free(m->down[a][b]);
+      m->down[a][b] = 0;
+      break;
+    case ADJ_UP:
+      free_up(m->up[a][b]);
+      m->up[a][b] = 0;
+      break;
+    case ADJ_STAR:
+      osh_free_graph(m->star[a][b]);
+      m->star[a][b] = 0;
+      break;
+    case ADJ_DUAL:
+      loop_free(m->dual);
+      m->dual = 0;
+      break;
+  }
+  struct use* u = get_use(m, kind, a, b);
+  m->adj_bytes -= u->bytes;
+  u->bytes = 0;
+}
+
+/* frees the least recently used arrays until the cache fits
+   its budget again, sparing pinned arrays. this only runs where
+   no caller can be holding unpinned adjacency: when the mesh is
+   overwritten or when asked to by mesh_trim_adj. */
+
+static void trim(struct mesh* m)
+{
+  if (!m->adj_budget)
+    return;
+  while (m->adj_bytes > m->adj_budget) {
+    unsigned found = 0;
+    enum adj_kind lru_kind = ADJ_DOWN;
+    unsigned lru_a = 0;
+    unsigned lru_b = 0;
+    unsigned long lru_last = 0;
+    for (unsigned k = ADJ_DOWN; k <= ADJ_DUAL; ++k)
+      for (unsigned a = 0; a < 4; ++a)
+        for (unsigned b = 0; b < 4; ++b) {
+          enum adj_kind kind = (enum adj_kind) k;
+          if (!can_free(kind, b) || !is_cached(m, kind, a, b))
+            continue;
+          struct use* u = get_use(m, kind, a, b);
+          if (u->pins)
+            continue;
+          if (!found || u->last < lru_last) {
+            found = 1;
+            lru_kind = kind;
+            lru_a = a;
+            lru_b = b;
+            lru_last = u->last;
+          }
+        }
+    if (!found)
+      break;
+    uncache(m, lru_kind, lru_a, lru_b);
+  }
+}
+
 static void set_down(struct mesh* m, unsigned high_dim, unsigned low_dim,
     unsigned* adj)
 {
   assert( ! m->down[high_dim][low_dim]);
   m->down[high_dim][low_dim] = adj;
+  cache(m, ADJ_DOWN, high_dim, low_dim, sizeof(unsigned) *
+      m->counts[high_dim] * the_down_degrees[high_dim][low_dim]);
 }
 
 unsigned const* mesh_ask_down(struct mesh* m, unsigned high_dim, unsigned low_dim)
 {
   assert(high_dim <= mesh_dim(m));
   assert(low_dim <= high_dim);
-  if (m->down[high_dim][low_dim])
+  if (m->down[high_dim][low_dim]) {
+    touch(m, ADJ_DOWN, high_dim, low_dim);
     return m->down[high_dim][low_dim];
+  }
+  enum mem_category cat = loop_host_set_category(MEM_ADJACENCY);
   if (low_dim == high_dim) {
     /* waste memory to prevent algorithms from having to deal
        with equal-order cases separately */
@@ -145,11 +289,24 @@ unsigned const* mesh_ask_down(struct mesh* m, unsigned high_dim, unsigned low_di
     set_down(m, high_dim, low_dim, lows_of_highs);
   } else {
     if (low_dim > 0) {/* deriving intermediate downward adjacency */
-      set_down(m, high_dim, low_dim,
-          mesh_reflect_down(m, high_dim, low_dim));
+      /* in sort mode, deriving the lows brings this along */
+      mesh_ask_down(m, low_dim, 0);
+      if (!m->down[high_dim][low_dim])
+        set_down(m, high_dim, low_dim,
+            mesh_reflect_down(m, high_dim, low_dim));
     } else {/* deriving implicit entity to vertex connectivity */
       assert(mesh_get_rep(m) == MESH_REDUCED);
-      if (high_dim == 1 && m->elem_dim == 3) { /* deriving edges in 3D */
+      if (m->derive == MESH_DERIVE_SORT) {
+        /* the elements' downward adjacency comes with it */
+        unsigned nlows;
+        unsigned* verts_of_lows;
+        unsigned* lows_of_elems;
+        derive_by_sort(m->elem_dim, high_dim, m->counts[m->elem_dim],
+            m->counts[0], m->down[m->elem_dim][0],
+            &nlows, &verts_of_lows, &lows_of_elems);
+        mesh_set_ents(m, high_dim, nlows, verts_of_lows);
+        set_down(m, m->elem_dim, high_dim, lows_of_elems);
+      } else if (high_dim == 1 && m->elem_dim == 3) { /* deriving edges in 3D */
         struct const_graph* verts_of_verts = mesh_ask_star(m, 0, m->elem_dim);
         unsigned nverts = m->counts[0];
         unsigned nedges;
@@ -175,6 +332,7 @@ unsigned const* mesh_ask_down(struct mesh* m, unsigned high_dim, unsigned low_di
       }
     }
   }
+  loop_host_set_category(cat);
   return m->down[high_dim][low_dim];
 }
 
@@ -183,13 +341,20 @@ static void set_up(struct mesh* m, unsigned low_dim, unsigned high_dim,
 {
   assert( ! m->up[low_dim][high_dim]);
   m->up[low_dim][high_dim] = adj;
+  unsigned nlows = m->counts[low_dim];
+  unsigned long nuses = uints_at(adj->offsets, nlows);
+  cache(m, ADJ_UP, low_dim, high_dim, sizeof(unsigned) *
+      (nlows + 1 + nuses * (adj->directions ? 2 : 1)));
 }
 
 struct const_up* mesh_ask_up(struct mesh* m, unsigned low_dim, unsigned high_dim)
 {
   assert(low_dim <= high_dim);
-  if (m->up[low_dim][high_dim])
+  if (m->up[low_dim][high_dim]) {
+    touch(m, ADJ_UP, low_dim, high_dim);
     return (struct const_up*) m->up[low_dim][high_dim];
+  }
+  enum mem_category cat = loop_host_set_category(MEM_ADJACENCY);
   if (low_dim == high_dim) {
     /* waste memory to prevent algorithms from having to deal
        with equal-order cases separately */
@@ -211,6 +376,7 @@ struct const_up* mesh_ask_up(struct mesh* m, unsigned low_dim, unsigned high_dim
         &offsets, &highs_of_lows, &directions);
     set_up(m, low_dim, high_dim, new_up(offsets, highs_of_lows, directions));
   }
+  loop_host_set_category(cat);
   return (struct const_up*) m->up[low_dim][high_dim];
 }
 
@@ -219,13 +385,20 @@ static void set_star(struct mesh* m, unsigned low_dim, unsigned high_dim,
 {
   assert( ! m->star[low_dim][high_dim]);
   m->star[low_dim][high_dim] = adj;
+  unsigned nlows = m->counts[low_dim];
+  unsigned long nadj = uints_at(adj->offsets, nlows);
+  cache(m, ADJ_STAR, low_dim, high_dim,
+      sizeof(unsigned) * (nlows + 1 + nadj));
 }
 
 struct const_graph* mesh_ask_star(struct mesh* m, unsigned low_dim, unsigned high_dim)
 {
   assert(low_dim <= high_dim);
-  if (m->star[low_dim][high_dim])
+  if (m->star[low_dim][high_dim]) {
+    touch(m, ADJ_STAR, low_dim, high_dim);
     return (struct const_graph*) m->star[low_dim][high_dim];
+  }
+  enum mem_category cat = loop_host_set_category(MEM_STARS);
   if (low_dim == high_dim) {
     /* waste memory to prevent algorithms from having to deal
        with equal-order cases separately */
@@ -238,6 +411,7 @@ struct const_graph* mesh_ask_star(struct mesh* m, unsigned low_dim, unsigned hig
     mesh_get_star(m, low_dim, high_dim, &offsets, &adj);
     set_star(m, low_dim, high_dim, osh_new_graph(offsets, adj));
   }
+  loop_host_set_category(cat);
   return (struct const_graph*) m->star[low_dim][high_dim];
 }
 
@@ -245,16 +419,22 @@ static void set_dual(struct mesh* m, unsigned* adj)
 {
   assert( ! m->dual);
   m->dual = adj;
+  cache(m, ADJ_DUAL, 0, 0, sizeof(unsigned) * m->counts[m->elem_dim] *
+      the_down_degrees[m->elem_dim][m->elem_dim - 1]);
 }
 
 unsigned const* mesh_ask_dual(struct mesh* m)
 {
-  if (!m->dual) {
-    if (mesh_has_dim(m, mesh_dim(m) - 1))
-      set_dual(m, mesh_get_dual_from_sides(m));
-    else
-      set_dual(m, mesh_get_dual_from_verts(m));
+  if (m->dual) {
+    touch(m, ADJ_DUAL, 0, 0);
+    return m->dual;
   }
+  enum mem_category cat = loop_host_set_category(MEM_ADJACENCY);
+  if (mesh_has_dim(m, mesh_dim(m) - 1))
+    set_dual(m, mesh_get_dual_from_sides(m));
+  else
+    set_dual(m, mesh_get_dual_from_verts(m));
+  loop_host_set_category(cat);
   return m->dual;
 }
 
@@ -264,6 +444,127 @@ void mesh_set_ents(struct mesh* m, unsigned dim, unsigned n, unsigned* verts)
   set_down(m, dim, 0, verts);
 }
 
+/* the find functions return adjacencies only if they are
+   already there, the set functions hand over ones that
+   were built elsewhere (e.g. carried over by a shuffle) */
+
+unsigned const* mesh_find_down(struct mesh* m,
+    unsigned high_dim, unsigned low_dim)
+{
+  if (m->down[high_dim][low_dim])
+    touch(m, ADJ_DOWN, high_dim, low_dim);
+  return m->down[high_dim][low_dim];
+}
+
+struct const_up* mesh_find_up(struct mesh* m,
+    unsigned low_dim, unsigned high_dim)
+{
+  if (m->up[low_dim][high_dim])
+    touch(m, ADJ_UP, low_dim, high_dim);
+  return (struct const_up*) m->up[low_dim][high_dim];
+}
+
+struct const_graph* mesh_find_star(struct mesh* m,
+    unsigned low_dim, unsigned high_dim)
+{
+  if (m->star[low_dim][high_dim])
+    touch(m, ADJ_STAR, low_dim, high_dim);
+  return (struct const_graph*) m->star[low_dim][high_dim];
+}
+
+unsigned const* mesh_find_dual(struct mesh* m)
+{
+  if (m->dual)
+    touch(m, ADJ_DUAL, 0, 0);
+  return m->dual;
+}
+
+void mesh_set_down(struct mesh* m, unsigned high_dim, unsigned low_dim,
+    unsigned* lows_of_highs)
+{
+  assert(low_dim);
+  set_down(m, high_dim, low_dim, lows_of_highs);
+}
+
+void mesh_set_up(struct mesh* m, unsigned low_dim, unsigned high_dim,
+    unsigned* offsets, unsigned* highs_of_lows, unsigned* directions)
+{
+  set_up(m, low_dim, high_dim, new_up(offsets, highs_of_lows, directions));
+}
+
+void mesh_set_star(struct mesh* m, unsigned low_dim, unsigned high_dim,
+    unsigned* offsets, unsigned* adj)
+{
+  set_star(m, low_dim, high_dim, osh_new_graph(offsets, adj));
+}
+
+void mesh_set_dual(struct mesh* m, unsigned* elems_of_elems)
+{
+  set_dual(m, elems_of_elems);
+}
+
+void mesh_set_adj_budget(struct mesh* m, unsigned long bytes)
+{
+  m->adj_budget = bytes;
+}
+
+void mesh_trim_adj(struct mesh* m)
+{
+  trim(m);
+}
+
+unsigned long mesh_adj_bytes(struct mesh* m)
+{
+  return m->adj_bytes;
+}
+
+static void unpin(struct mesh* m, enum adj_kind kind, unsigned a, unsigned b)
+{
+  struct use* u = get_use(m, kind, a, b);
+  assert(u->pins);
+  --u->pins;
+}
+
+void mesh_pin_down(struct mesh* m, unsigned high_dim, unsigned low_dim)
+{
+  ++m->down_use[high_dim][low_dim].pins;
+}
+
+void mesh_unpin_down(struct mesh* m, unsigned high_dim, unsigned low_dim)
+{
+  unpin(m, ADJ_DOWN, high_dim, low_dim);
+}
+
+void mesh_pin_up(struct mesh* m, unsigned low_dim, unsigned high_dim)
+{
+  ++m->up_use[low_dim][high_dim].pins;
+}
+
+void mesh_unpin_up(struct mesh* m, unsigned low_dim, unsigned high_dim)
+{
+  unpin(m, ADJ_UP, low_dim, high_dim);
+}
+
+void mesh_pin_star(struct mesh* m, unsigned low_dim, unsigned high_dim)
+{
+  ++m->star_use[low_dim][high_dim].pins;
+}
+
+void mesh_unpin_star(struct mesh* m, unsigned low_dim, unsigned high_dim)
+{
+  unpin(m, ADJ_STAR, low_dim, high_dim);
+}
+
+void mesh_pin_dual(struct mesh* m)
+{
+  ++m->dual_use.pins;
+}
+
+void mesh_unpin_dual(struct mesh* m)
+{
+  unpin(m, ADJ_DUAL, 0, 0);
+}
+
 struct const_tag* mesh_add_tag(struct mesh* m, unsigned dim, enum tag_type type,
     char const* name, unsigned ncomps, void* data)
 {
@@ -305,6 +606,16 @@ void mesh_set_rep(struct mesh* m, enum mesh_rep rep)
   m->rep = rep;
 }
 
+enum mesh_derive mesh_get_derive(struct mesh* m)
+{
+  return m->derive;
+}
+
+void mesh_set_derive(struct mesh* m, enum mesh_derive derive)
+{
+  m->derive = derive;
+}
+
 unsigned mesh_is_parallel(struct mesh* m)
 {
   return m->parallel != 0;
@@ -326,7 +637,12 @@ void mesh_make_parallel(struct mesh* m)
 
 void overwrite_mesh(struct mesh* old, struct mesh* with)
 {
+  enum mesh_derive derive = old->derive;
+  unsigned long adj_budget = old->adj_budget;
   free_mesh_contents(old);
   *old = *with;
+  old->derive = derive;
+  old->adj_budget = adj_budget;
+  trim(old);
   loop_host_free(with);
 }
@@ -9,6 +9,15 @@ enum mesh_rep {
   MESH_FULL
 };
 
+/* how intermediate entities and their downward adjacencies
+   are derived: by searching the upward adjacency from vertices,
+   or by sorting vertex tuples, which builds no upward adjacency */
+
+enum mesh_derive {
+  MESH_DERIVE_UP,
+  MESH_DERIVE_SORT
+};
+
 struct mesh;
 
 struct const_up {
@@ -35,6 +44,41 @@ struct const_graph* mesh_ask_star(struct mesh* m, unsigned low_dim,
     unsigned high_dim);
 unsigned const* mesh_ask_dual(struct mesh* m);
 
+unsigned const* mesh_find_down(struct mesh* m,
+    unsigned high_dim, unsigned low_dim);
+struct const_up* mesh_find_up(struct mesh* m,
+    unsigned low_dim, unsigned high_dim);
+struct const_graph* mesh_find_star(struct mesh* m,
+    unsigned low_dim, unsigned high_dim);
+unsigned const* mesh_find_dual(struct mesh* m);
+void mesh_set_down(struct mesh* m, unsigned high_dim, unsigned low_dim,
+    unsigned* lows_of_highs);
+void mesh_set_up(struct mesh* m, unsigned low_dim, unsigned high_dim,
+    unsigned* offsets, unsigned* highs_of_lows, unsigned* directions);
+void mesh_set_star(struct mesh* m, unsigned low_dim, unsigned high_dim,
+    unsigned* offsets, unsigned* adj);
+void mesh_set_dual(struct mesh* m, unsigned* elems_of_elems);
+
+/* a budget in bytes for the derived adjacency a mesh keeps, zero
+   (the default) meaning no limit. asking for adjacency never frees
+   any, but when the mesh is overwritten or mesh_trim_adj is called,
+   the least recently used arrays are freed until the mesh fits its
+   budget, to be derived again if asked for. vertex lists are never
+   freed. callers that keep a pointer from mesh_ask_* or mesh_find_*
+   across mesh_trim_adj pin its array first. pins nest and may be
+   placed before the array is derived. */
+void mesh_set_adj_budget(struct mesh* m, unsigned long bytes);
+void mesh_trim_adj(struct mesh* m);
+unsigned long mesh_adj_bytes(struct mesh* m);
+void mesh_pin_down(struct mesh* m, unsigned high_dim, unsigned low_dim);
+void mesh_unpin_down(struct mesh* m, unsigned high_dim, unsigned low_dim);
+void mesh_pin_up(struct mesh* m, unsigned low_dim, unsigned high_dim);
+void mesh_unpin_up(struct mesh* m, unsigned low_dim, unsigned high_dim);
+void mesh_pin_star(struct mesh* m, unsigned low_dim, unsigned high_dim);
+void mesh_unpin_star(struct mesh* m, unsigned low_dim, unsigned high_dim);
+void mesh_pin_dual(struct mesh* m);
+void mesh_unpin_dual(struct mesh* m);
+
 struct const_tag* mesh_add_tag(struct mesh* m, unsigned dim, enum tag_type type,
     char const* name, unsigned ncomps, void* data);
 void mesh_free_tag(struct mesh* m, unsigned dim, char const* name);
@@ -50,6 +94,9 @@ struct parallel_mesh;
 enum mesh_rep mesh_get_rep(struct mesh* m);
 void mesh_set_rep(struct mesh* m, enum mesh_rep rep);
 
+enum mesh_derive mesh_get_derive(struct mesh* m);
+void mesh_set_derive(struct mesh* m, enum mesh_derive derive);
+
 unsigned mesh_is_parallel(struct mesh* m);
 struct parallel_mesh* mesh_parallel(struct mesh* m);
 void mesh_make_parallel(struct mesh* m);
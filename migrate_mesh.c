@@ -9,6 +9,7 @@
 #include "mesh.h"
 #include "parallel_mesh.h"
 #include "tables.h"
+#include "trace.h"
 
 static unsigned* use_lids_from_copy_lids(
     struct exchanger* use_to_own,
@@ -117,6 +118,7 @@ void migrate_mesh(
     unsigned const* recvd_elem_ranks,
     unsigned const* recvd_elem_ids)
 {
+  trace_begin("migrate_mesh");
   unsigned dim = mesh_dim(m);
   unsigned nelems = mesh_count(m, dim);
   struct exchanger* elem_push = make_reverse_exchanger(nelems,
@@ -155,4 +157,5 @@ void migrate_mesh(
   free_exchanger(vert_push);
   free_exchanger(elem_push);
   overwrite_mesh(m, m_out);
+  trace_end();
 }
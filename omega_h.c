@@ -10,6 +10,7 @@
 #include "size.h"
 #include "tag.h"
 #include "tables.h"
+#include "trace.h"
 #include "vtk_io.h"
 
 /*@
@@ -935,6 +936,12 @@ void osh_ghost(osh_t m, unsigned nlayers)
    it must be called "adapt_size".
    The return value will be zero if no connectivity changes are made.
 
+   Partitioned meshes are adapted in place, without gathering
+   them to one MPI rank.
+   The mesh is returned with the same number of ghost layers
+   it had when this function was called.
+   See osh_adapt_imbalance() to repartition between passes.
+
   Collective
 
   Input Parameters:
@@ -952,7 +959,7 @@ void osh_ghost(osh_t m, unsigned nlayers)
   Level: advanced
 
 .keywords: adapt
-.seealso: osh_new_field(), osh_identity_size()
+.seealso: osh_new_field(), osh_identity_size(), osh_adapt_imbalance()
 @*/
 unsigned osh_adapt(osh_t m,
     double size_ratio_floor,
@@ -967,6 +974,33 @@ unsigned osh_adapt(osh_t m,
       max_passes);
 }
 
+/*@
+  osh_adapt_imbalance - Enables rebalancing during adaptation.
+
+   Refinement and coarsening may quickly change the number
+   of elements on each MPI rank.
+   After this call, osh_adapt() will repartition the mesh
+   between modification passes whenever the MPI rank with the
+   most elements has more than max_imbalance times the
+   average number of elements.
+   Repartitioning uses recursive inertial bisection.
+
+   This setting applies to all subsequent calls to osh_adapt().
+
+  Input Parameters:
+. max_imbalance - Range [1.0 - ?], default 0.0. Values less than
+                  or equal to 1.0 disable rebalancing.
+
+  Level: advanced
+
+.keywords: adapt
+.seealso: osh_adapt()
+@*/
+void osh_adapt_imbalance(double max_imbalance)
+{
+  mesh_adapt_set_imbalance(max_imbalance);
+}
+
 /*@
   osh_identity_size - Compute the "current" size field.
 
@@ -1002,3 +1036,47 @@ void osh_identity_size(osh_t m, char const* name)
 {
   mesh_identity_size_field((struct mesh*)m, name);
 }
+
+/*@
+  osh_trace_open - Starts recording a timeline.
+
+   Until osh_trace_close() is called, the major phases
+   of omega_h (adaptation passes, independent set iterations,
+   ghosting, migration, communication and file I/O)
+   are recorded as regions with their MPI rank and thread.
+   The result is written in the Chrome trace event format,
+   which chrome://tracing and Perfetto can display.
+
+  Collective
+
+  Input Parameters:
+. filename - The path of the trace file, for example "adapt.json".
+
+  Level: advanced
+
+.keywords: trace
+.seealso: osh_trace_close()
+@*/
+void osh_trace_open(char const* filename)
+{
+  trace_open(filename);
+}
+
+/*@
+  osh_trace_close - Writes the timeline started by osh_trace_open().
+
+   Each MPI rank writes its regions next to the trace file,
+   and rank 0 then merges them into the one file given
+   to osh_trace_open().
+
+  Collective
+
+  Level: advanced
+
+.keywords: trace
+.seealso: osh_trace_open()
+@*/
+void osh_trace_close(void)
+{
+  trace_close();
+}
@@ -12,8 +12,21 @@
 #include "inertia.h"
 #include "ints.h"
 #include "loop.h"
+#include "mark.h"
 #include "mesh.h"
 #include "migrate_mesh.h"
+#include "parallel_mesh.h"
+#include "trace.h"
+
+/* the lower half of the ranks, rounded down, and
+   the rest. any number of ranks can be split this
+   way, and each side gets the share of the mass
+   that matches its share of the ranks */
+
+static unsigned lower_group_size(void)
+{
+  return comm_size() / 2;
+}
 
 void parallel_inertial_bisect(
     unsigned* p_n,
@@ -22,7 +35,8 @@ void parallel_inertial_bisect(
     unsigned** p_orig_ranks,
     unsigned** p_orig_ids)
 {
-  assert(comm_size() % 2 == 0);
+  assert(comm_size() > 1);
+  trace_begin("parallel_inertial_bisect");
   unsigned n = *p_n;
   double const* coords = *p_coords;
   double const* masses = 0;
@@ -30,10 +44,12 @@ void parallel_inertial_bisect(
     masses = *p_masses;
   unsigned const* orig_ranks = *p_orig_ranks;
   unsigned const* orig_ids = *p_orig_ids;
-  unsigned* marked = mark_inertial_bisection(n, coords, masses, 1);
+  unsigned const nsubranks_of[2] = {lower_group_size(),
+    comm_size() - lower_group_size()};
+  double in_fraction = ((double) nsubranks_of[0]) / comm_size();
+  unsigned* marked = mark_inertial_split(n, coords, masses, in_fraction, 1);
   unsigned* offsets = uints_exscan(marked, n);
   loop_free(marked);
-  unsigned nsubranks = comm_size() / 2;
   unsigned first_rank = 0;
   unsigned n_out = 0;
   double* coords_out = 0;
@@ -41,6 +57,7 @@ void parallel_inertial_bisect(
   unsigned* orig_ranks_out = 0;
   unsigned* orig_ids_out = 0;
   for (unsigned dir = 0; dir < 2; ++dir) {
+    unsigned nsubranks = nsubranks_of[dir];
     unsigned nsub = uints_at(offsets, n);
     unsigned* local = uints_linear(nsub + 1, 1);
     unsigned long* global = globalize_offsets(local, nsub);
@@ -106,6 +123,7 @@ void parallel_inertial_bisect(
   *p_orig_ranks = orig_ranks_out;
   loop_free(*p_orig_ids);
   *p_orig_ids = orig_ids_out;
+  trace_end();
 }
 
 void recursive_inertial_bisect(
@@ -117,12 +135,11 @@ void recursive_inertial_bisect(
 {
   if (comm_size() == 1)
     return;
-  assert(comm_size() % 2 == 0);
   parallel_inertial_bisect(p_n, p_coords, p_masses,
       p_orig_ranks, p_orig_ids);
-  unsigned half = comm_size() / 2;
-  unsigned group = comm_rank() / half;
-  unsigned subrank = comm_rank() % half;
+  unsigned half = lower_group_size();
+  unsigned group = (comm_rank() >= half);
+  unsigned subrank = comm_rank() - group * half;
   struct comm* oldcomm = comm_using();
   struct comm* subcomm = comm_split(oldcomm, group, subrank);
   comm_use(subcomm);
@@ -132,10 +149,9 @@ void recursive_inertial_bisect(
   comm_free(subcomm);
 }
 
-void balance_mesh_inertial(struct mesh* m)
+void mesh_inertial_partition(struct mesh* m, unsigned* p_n,
+    unsigned** p_orig_ranks, unsigned** p_orig_ids)
 {
-  assert(mesh_is_parallel(m));
-  mesh_ensure_ghosting(m, 0);
   unsigned dim = mesh_dim(m);
   unsigned had_elem_coords =
     (0 != mesh_find_tag(m, dim, "coordinates"));
@@ -146,11 +162,54 @@ void balance_mesh_inertial(struct mesh* m)
       mesh_find_tag(m, dim, "coordinates")->d.f64, n * 3);
   if (!had_elem_coords)
     mesh_free_tag(m, dim, "coordinates");
+  struct const_tag* wt = mesh_find_tag(m, dim, "balance_weight");
+  double* weights = 0;
+  if (wt) {
+    assert(wt->type == TAG_F64 && wt->ncomps == 1);
+    weights = doubles_copy(wt->d.f64, n);
+  }
+  unsigned* orig_ids;
+  if (mesh_ghost_layers(m)) {
+    /* ghost elements are left to their owners */
+    unsigned* owned = mesh_get_owned(m, dim);
+    unsigned* offsets;
+    unsigned nowned;
+    orig_ids = collect_marked(n, owned, &offsets, &nowned);
+    loop_free(owned);
+    double* owned_coords = doubles_expand(n, 3, coords, offsets);
+    loop_free(coords);
+    coords = owned_coords;
+    if (weights) {
+      double* owned_weights = doubles_expand(n, 1, weights, offsets);
+      loop_free(weights);
+      weights = owned_weights;
+    }
+    loop_free(offsets);
+    n = nowned;
+  } else {
+    orig_ids = uints_linear(n, 1);
+  }
   unsigned* orig_ranks = uints_filled(n, comm_rank());
-  unsigned* orig_ids = uints_linear(n, 1);
-  recursive_inertial_bisect(&n, &coords, 0, &orig_ranks, &orig_ids);
+  recursive_inertial_bisect(&n, &coords, wt ? &weights : 0,
+      &orig_ranks, &orig_ids);
   loop_free(coords);
+  loop_free(weights);
+  *p_n = n;
+  *p_orig_ranks = orig_ranks;
+  *p_orig_ids = orig_ids;
+}
+
+void balance_mesh_inertial(struct mesh* m)
+{
+  assert(mesh_is_parallel(m));
+  trace_begin("balance_mesh_inertial");
+  mesh_ensure_ghosting(m, 0);
+  unsigned n;
+  unsigned* orig_ranks;
+  unsigned* orig_ids;
+  mesh_inertial_partition(m, &n, &orig_ranks, &orig_ids);
   migrate_mesh(m, n, orig_ranks, orig_ids);
   loop_free(orig_ranks);
   loop_free(orig_ids);
+  trace_end();
 }
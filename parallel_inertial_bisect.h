@@ -17,6 +17,21 @@ void recursive_inertial_bisect(
 
 struct mesh;
 
+/* repartitions the elements by recursive inertial bisection.
+   any number of ranks is allowed: each bisection splits the
+   ranks into two groups and the mass in proportion to them.
+   if the elements have a "balance_weight" tag (TAG_F64, one
+   component) each element counts with that weight, otherwise
+   all elements count the same */
 void balance_mesh_inertial(struct mesh* m);
 
+/* computes the partition balance_mesh_inertial would move
+   the elements to, without moving them: this rank would
+   receive (*p_n) elements, identified by their current
+   ranks and local ids (*p_orig_ranks, *p_orig_ids).
+   the mesh is left as it is. if it is ghosted, only the
+   elements each rank owns take part */
+void mesh_inertial_partition(struct mesh* m, unsigned* p_n,
+    unsigned** p_orig_ranks, unsigned** p_orig_ids);
+
 #endif
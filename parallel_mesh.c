@@ -12,6 +12,7 @@
 #include "global.h"
 #include "ints.h"
 #include "loop.h"
+#include "mark.h"
 #include "mesh.h"
 #include "owners_from_global.h"
 #include "parallel_inertial_bisect.h"
@@ -22,6 +23,7 @@ struct parallel_mesh {
   unsigned* own_ranks[4];
   unsigned* own_ids[4];
   struct exchanger* ex[4];
+  struct exchange_plan* plans[4];
   unsigned nghost_layers;
   int padding__;
 };
@@ -35,6 +37,9 @@ struct parallel_mesh* new_parallel_mesh(void)
 
 static void invalidate_exchanger(struct parallel_mesh* pm, unsigned dim)
 {
+  if (pm->plans[dim])
+    free_exchange_plan(pm->plans[dim]);
+  pm->plans[dim] = 0;
   if (pm->ex[dim])
     free_exchanger(pm->ex[dim]);
   pm->ex[dim] = 0;
@@ -151,13 +156,247 @@ GENERIC_MESH_CONFORM(double, doubles)
 GENERIC_MESH_CONFORM(unsigned, uints)
 GENERIC_MESH_CONFORM(unsigned long, ulongs)
 
-void mesh_conform_tag(struct mesh* m, unsigned dim, const char* name)
+#define GENERIC_MESH_CONFORM_SPLIT(T, name) \
+struct exchange* mesh_conform_##name##_begin(struct mesh* m, unsigned dim, \
+    unsigned width, T const* a) \
+{ \
+  if (!mesh_is_parallel(m)) \
+    return 0; \
+  return exchange_##name##_begin(mesh_ask_exchanger(m, dim), width, a, \
+      EX_FOR, EX_ROOT); \
+} \
+\
+LOOP_KERNEL(copy_unowned_##name, \
+    unsigned width, \
+    unsigned const* own_ranks, \
+    unsigned self, \
+    T const* in, \
+    T* out) \
+  if (own_ranks[i] == self) \
+    return; \
+  for (unsigned j = 0; j < width; ++j) \
+    out[i * width + j] = in[i * width + j]; \
+} \
+\
+void mesh_conform_##name##_end(struct mesh* m, unsigned dim, \
+    unsigned width, struct exchange* x, T* a) \
+{ \
+  if (!x) \
+    return; \
+  T* in = exchange_##name##_end(x); \
+  LOOP_EXEC(copy_unowned_##name, mesh_count(m, dim), width, \
+      mesh_ask_own_ranks(m, dim), comm_rank(), in, a); \
+  loop_free(in); \
+}
+
+GENERIC_MESH_CONFORM_SPLIT(double, doubles)
+GENERIC_MESH_CONFORM_SPLIT(unsigned, uints)
+GENERIC_MESH_CONFORM_SPLIT(unsigned long, ulongs)
+
+LOOP_KERNEL(conform_phase,
+    unsigned const* own_ranks,
+    unsigned self,
+    unsigned const* copies_of_owners_offsets,
+    unsigned* out)
+  if (own_ranks[i] != self)
+    out[i] = CONFORM_GHOST;
+  else if (copies_of_owners_offsets[i + 1] - copies_of_owners_offsets[i] > 1)
+    out[i] = CONFORM_SHARED;
+  else
+    out[i] = CONFORM_INTERIOR;
+}
+
+unsigned* mesh_conform_phases(struct mesh* m, unsigned dim)
+{
+  unsigned n = mesh_count(m, dim);
+  if (!mesh_is_parallel(m))
+    return uints_filled(n, CONFORM_INTERIOR);
+  struct exchanger* ex = mesh_ask_exchanger(m, dim);
+  unsigned* out = LOOP_MALLOC(unsigned, n);
+  LOOP_EXEC(conform_phase, n, mesh_ask_own_ranks(m, dim), comm_rank(),
+      ex->items_of_roots_offsets[EX_FOR], out);
+  return out;
+}
+
+struct boundary_conform {
+  unsigned nents;
+  int padding__;
+  unsigned* ents;
+  unsigned* is_ghost;
+  unsigned* packed;
+  unsigned* recvd;
+  struct exchanger* ex;
+  struct exchange_plan* plan;
+};
+
+LOOP_KERNEL(mark_not_interior,
+    unsigned const* phases,
+    unsigned* marked)
+  marked[i] = (phases[i] != CONFORM_INTERIOR);
+}
+
+LOOP_KERNEL(boundary_owners,
+    unsigned const* ents,
+    unsigned const* own_ranks,
+    unsigned const* own_bids,
+    unsigned self,
+    unsigned* ranks,
+    unsigned* bids,
+    unsigned* is_ghost)
+  unsigned e = ents[i];
+  ranks[i] = own_ranks[e];
+  bids[i] = own_bids[e];
+  is_ghost[i] = (own_ranks[e] != self);
+}
+
+/* the entities other ranks have copies of are numbered
+   among themselves, and conforming those numbers tells
+   each copy where its owner is in the owner's numbering */
+
+struct boundary_conform* mesh_new_boundary_conform(struct mesh* m,
+    unsigned dim)
 {
   if (!mesh_is_parallel(m))
+    return 0;
+  unsigned n = mesh_count(m, dim);
+  unsigned* phases = mesh_conform_phases(m, dim);
+  unsigned* marked = LOOP_MALLOC(unsigned, n);
+  LOOP_EXEC(mark_not_interior, n, phases, marked);
+  loop_free(phases);
+  struct boundary_conform* bc = LOOP_HOST_MALLOC(struct boundary_conform, 1);
+  unsigned* bids;
+  bc->ents = collect_marked(n, marked, &bids, &bc->nents);
+  loop_free(marked);
+  mesh_conform_uints(m, dim, 1, &bids);
+  unsigned* ranks = LOOP_MALLOC(unsigned, bc->nents);
+  unsigned* own_bids = LOOP_MALLOC(unsigned, bc->nents);
+  bc->is_ghost = LOOP_MALLOC(unsigned, bc->nents);
+  LOOP_EXEC(boundary_owners, bc->nents, bc->ents,
+      mesh_ask_own_ranks(m, dim), bids, comm_rank(),
+      ranks, own_bids, bc->is_ghost);
+  loop_free(bids);
+  bc->ex = make_reverse_exchanger(bc->nents, bc->nents, ranks, own_bids);
+  loop_free(ranks);
+  loop_free(own_bids);
+  unsigned const nbytes = sizeof(unsigned);
+  bc->plan = new_exchange_plan(bc->ex, 1, &nbytes, EX_FOR, EX_ROOT);
+  bc->packed = LOOP_MALLOC(unsigned, bc->nents);
+  bc->recvd = LOOP_MALLOC(unsigned, bc->nents);
+  return bc;
+}
+
+LOOP_KERNEL(pack_boundary,
+    unsigned const* ents,
+    unsigned const* a,
+    unsigned* packed)
+  packed[i] = a[ents[i]];
+}
+
+void boundary_conform_uints_begin(struct boundary_conform* bc,
+    unsigned const* a)
+{
+  if (!bc)
     return;
-  struct const_tag* t = mesh_find_tag(m, dim, name);
+  LOOP_EXEC(pack_boundary, bc->nents, bc->ents, a, bc->packed);
+  void const* data = bc->packed;
+  exchange_plan_begin(bc->plan, &data);
+}
+
+LOOP_KERNEL(unpack_boundary,
+    unsigned const* ents,
+    unsigned const* is_ghost,
+    unsigned const* recvd,
+    unsigned* a)
+  if (is_ghost[i])
+    a[ents[i]] = recvd[i];
+}
+
+void boundary_conform_uints_end(struct boundary_conform* bc, unsigned* a)
+{
+  if (!bc)
+    return;
+  void* out = bc->recvd;
+  exchange_plan_end(bc->plan, &out);
+  LOOP_EXEC(unpack_boundary, bc->nents, bc->ents, bc->is_ghost,
+      bc->recvd, a);
+}
+
+void free_boundary_conform(struct boundary_conform* bc)
+{
+  if (!bc)
+    return;
+  free_exchange_plan(bc->plan);
+  free_exchanger(bc->ex);
+  loop_free(bc->ents);
+  loop_free(bc->is_ghost);
+  loop_free(bc->packed);
+  loop_free(bc->recvd);
+  loop_host_free(bc);
+}
+
+void mesh_conform_many(struct mesh* m, unsigned dim, unsigned n,
+    unsigned const* nbytes, void** a)
+{
+  if (!mesh_is_parallel(m))
+    return;
+  void** out = LOOP_HOST_MALLOC(void*, n);
+  exchange_many(mesh_ask_exchanger(m, dim), n, nbytes,
+      (void const* const*) a, EX_FOR, EX_ROOT, out);
+  for (unsigned i = 0; i < n; ++i) {
+    loop_free(a[i]);
+    a[i] = out[i];
+  }
+  loop_host_free(out);
+}
+
+/* the last layout conformed over each dimension keeps
+   its plan, so conforming the same fields over and over
+   costs no setup, buffer allocation or MPI matching */
+
+static struct exchange_plan* ask_conform_plan(struct mesh* m, unsigned dim,
+    unsigned n, unsigned const* nbytes)
+{
   struct exchanger* ex = mesh_ask_exchanger(m, dim);
-  push_tag(ex, t, mesh_tags(m, dim));
+  struct parallel_mesh* pm = mesh_parallel(m);
+  if (pm->plans[dim] && !exchange_plan_fits(pm->plans[dim], n, nbytes)) {
+    free_exchange_plan(pm->plans[dim]);
+    pm->plans[dim] = 0;
+  }
+  if (!pm->plans[dim])
+    pm->plans[dim] = new_exchange_plan(ex, n, nbytes, EX_FOR, EX_ROOT);
+  return pm->plans[dim];
+}
+
+void mesh_conform_in_place(struct mesh* m, unsigned dim, unsigned n,
+    unsigned const* nbytes, void* const* a)
+{
+  if (!mesh_is_parallel(m))
+    return;
+  struct exchange_plan* p = ask_conform_plan(m, dim, n, nbytes);
+  exchange_plan_begin(p, (void const* const*) a);
+  exchange_plan_end(p, a);
+}
+
+void mesh_conform_tag(struct mesh* m, unsigned dim, const char* name)
+{
+  mesh_conform_tags(m, dim, 1, &name);
+}
+
+void mesh_conform_tags(struct mesh* m, unsigned dim, unsigned n,
+    char const* const* names)
+{
+  if (!mesh_is_parallel(m))
+    return;
+  unsigned* nbytes = LOOP_HOST_MALLOC(unsigned, n);
+  void** data = LOOP_HOST_MALLOC(void*, n);
+  for (unsigned i = 0; i < n; ++i) {
+    struct const_tag* t = mesh_find_tag(m, dim, names[i]);
+    nbytes[i] = t->ncomps * tag_size(t->type);
+    data[i] = t->d.raw;
+  }
+  mesh_conform_in_place(m, dim, n, nbytes, data);
+  loop_host_free(nbytes);
+  loop_host_free(data);
 }
 
 /* TODO: consolidate this with the reduction code
@@ -342,3 +581,19 @@ void mesh_reduce_##name##_max(struct mesh* m, unsigned dim, unsigned width, \
 }
 
 GENERIC_MESH_MAX(double, doubles)
+
+#define GENERIC_MESH_MIN(T, name) \
+void mesh_reduce_##name##_min(struct mesh* m, unsigned dim, unsigned width, \
+    T** a) \
+{ \
+  if (!mesh_is_parallel(m)) \
+    return; \
+  T* in = *a; \
+  T* out = exchange_##name##_min(mesh_ask_exchanger(m, dim), width, in, \
+      EX_REV, EX_ITEM); \
+  loop_free(in); \
+  *a = out; \
+}
+
+GENERIC_MESH_MIN(unsigned, uints)
+GENERIC_MESH_MIN(unsigned long, ulongs)
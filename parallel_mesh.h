@@ -4,6 +4,7 @@
 struct mesh;
 struct parallel_mesh;
 struct exchanger;
+struct exchange;
 
 struct parallel_mesh* new_parallel_mesh(void);
 void free_parallel_mesh(struct parallel_mesh* m);
@@ -22,7 +23,61 @@ void mesh_conform_uints(struct mesh* m, unsigned dim, unsigned width,
 void mesh_conform_ulongs(struct mesh* m, unsigned dim, unsigned width,
     unsigned long** a);
 
+/* split-phase conform: the owned values which other
+   ranks have copies of (CONFORM_SHARED) must be final
+   when _begin is called, the rest of the owned values
+   (CONFORM_INTERIOR) may be computed until _end,
+   which fills in the values owned elsewhere
+   (CONFORM_GHOST) in place */
+enum conform_phase {
+  CONFORM_GHOST = 0,
+  CONFORM_SHARED = 1,
+  CONFORM_INTERIOR = 2
+};
+
+unsigned* mesh_conform_phases(struct mesh* m, unsigned dim);
+
+/* a split-phase conform of one unsigned per entity that
+   only packs and sends the entities other ranks have copies
+   of, set up once for a field that is conformed many times.
+   on a serial mesh this is null and conforms nothing. */
+struct boundary_conform;
+struct boundary_conform* mesh_new_boundary_conform(struct mesh* m,
+    unsigned dim);
+void boundary_conform_uints_begin(struct boundary_conform* bc,
+    unsigned const* a);
+void boundary_conform_uints_end(struct boundary_conform* bc, unsigned* a);
+void free_boundary_conform(struct boundary_conform* bc);
+
+struct exchange* mesh_conform_doubles_begin(struct mesh* m, unsigned dim,
+    unsigned width, double const* a);
+void mesh_conform_doubles_end(struct mesh* m, unsigned dim, unsigned width,
+    struct exchange* x, double* a);
+struct exchange* mesh_conform_uints_begin(struct mesh* m, unsigned dim,
+    unsigned width, unsigned const* a);
+void mesh_conform_uints_end(struct mesh* m, unsigned dim, unsigned width,
+    struct exchange* x, unsigned* a);
+struct exchange* mesh_conform_ulongs_begin(struct mesh* m, unsigned dim,
+    unsigned width, unsigned long const* a);
+void mesh_conform_ulongs_end(struct mesh* m, unsigned dim, unsigned width,
+    struct exchange* x, unsigned long* a);
+
+/* conforms (n) arrays in a single message round.
+   (nbytes[i]) is the size in bytes of one entity's
+   worth of (a[i]), which is replaced like the above */
+void mesh_conform_many(struct mesh* m, unsigned dim, unsigned n,
+    unsigned const* nbytes, void** a);
+
+/* like mesh_conform_many, but the arrays are overwritten
+   in place using a persistent plan cached on the mesh,
+   which pays off when the same layout is conformed
+   many times over an unchanged mesh */
+void mesh_conform_in_place(struct mesh* m, unsigned dim, unsigned n,
+    unsigned const* nbytes, void* const* a);
+
 void mesh_conform_tag(struct mesh* m, unsigned dim, const char* name);
+void mesh_conform_tags(struct mesh* m, unsigned dim, unsigned n,
+    char const* const* names);
 void mesh_accumulate_tag(struct mesh* m, unsigned dim, const char* name);
 
 unsigned mesh_ghost_layers(struct mesh* m);
@@ -49,5 +104,9 @@ unsigned* mesh_get_owned(struct mesh* m, unsigned dim);
 
 void mesh_reduce_doubles_max(struct mesh* m, unsigned dim, unsigned width,
     double** a);
+void mesh_reduce_uints_min(struct mesh* m, unsigned dim, unsigned width,
+    unsigned** a);
+void mesh_reduce_ulongs_min(struct mesh* m, unsigned dim, unsigned width,
+    unsigned long** a);
 
 #endif
@@ -1,5 +1,6 @@
 #include "quality.h"
 
+#include "adapt_region.h"
 #include "arrays.h"
 #include "doubles.h"
 #include "loop.h"
@@ -9,18 +10,20 @@
 #include "tag.h"
 
 LOOP_KERNEL(elem_quality_kern,
+    unsigned const* elems,
     unsigned const* verts_of_elems,
     unsigned elem_dim,
     unsigned verts_per_elem,
     double const* coords,
     double* out)
-  unsigned const* verts_of_elem = verts_of_elems + i * verts_per_elem;
+  unsigned elem = elems ? elems[i] : i;
+  unsigned const* verts_of_elem = verts_of_elems + elem * verts_per_elem;
   double elem_x[MAX_DOWN][3];
   for (unsigned j = 0; j < verts_per_elem; ++j) {
     unsigned vert = verts_of_elem[j];
     copy_vector(coords + vert * 3, elem_x[j], 3);
   }
-  out[i] = element_quality(elem_dim, elem_x);
+  out[elem] = element_quality(elem_dim, elem_x);
 }
 
 double* element_qualities(
@@ -34,6 +37,7 @@ double* element_qualities(
   double* out = LOOP_MALLOC(double, nelems);
   unsigned verts_per_elem = the_down_degrees[elem_dim][0];
   LOOP_EXEC(elem_quality_kern, nelems,
+      0,
       verts_of_elems,
       elem_dim,
       verts_per_elem,
@@ -69,3 +73,35 @@ double mesh_min_quality(struct mesh* m)
       mesh_ask_down(m, mesh_dim(m), 0),
       mesh_find_tag(m, 0, "coordinates")->d.f64);
 }
+
+/* elements outside the adapt region count as perfect */
+
+double* mesh_adapt_qualities(struct mesh* m)
+{
+  unsigned elem_dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, elem_dim);
+  unsigned nactive;
+  unsigned* active = 0;
+  if (elem_dim >= 2)
+    active = mesh_list_region(m, elem_dim, &nactive);
+  if (!active)
+    return mesh_qualities(m);
+  double* out = doubles_filled(nelems, 1.0);
+  LOOP_EXEC(elem_quality_kern, nactive,
+      active,
+      mesh_ask_down(m, elem_dim, 0),
+      elem_dim,
+      the_down_degrees[elem_dim][0],
+      mesh_find_tag(m, 0, "coordinates")->d.f64,
+      out);
+  loop_free(active);
+  return out;
+}
+
+double mesh_adapt_min_quality(struct mesh* m)
+{
+  double* quals = mesh_adapt_qualities(m);
+  double mq = doubles_min(quals, mesh_count(m, mesh_dim(m)));
+  loop_free(quals);
+  return mq;
+}
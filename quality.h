@@ -123,4 +123,10 @@ struct mesh;
 double* mesh_qualities(struct mesh* m);
 double mesh_min_quality(struct mesh* m);
 
+/* the same, but only over the adapt region (see adapt_region.h),
+   elements outside of it count as perfect. these are meant for
+   the decisions made during adaptation, not for reporting. */
+double* mesh_adapt_qualities(struct mesh* m);
+double mesh_adapt_min_quality(struct mesh* m);
+
 #endif
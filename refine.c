@@ -1,10 +1,11 @@
 #include "refine.h"
 
-#include "arrays.h"
 #include "loop.h"
 #include "mesh.h"
 #include "refine_common.h"
+#include "refine_uniform.h"
 #include "size.h"
+#include "trace.h"
 
 LOOP_KERNEL(refine_candidate,
     double const* edge_sizes,
@@ -14,6 +15,7 @@ LOOP_KERNEL(refine_candidate,
 
 unsigned refine_by_size(struct mesh* m, double qual_floor)
 {
+  trace_begin("refine_by_size");
   double* edge_sizes = mesh_measure_edges_for_adapt(m);
   unsigned nedges = mesh_count(m, 1);
   unsigned* candidates = LOOP_MALLOC(unsigned, nedges);
@@ -21,12 +23,11 @@ unsigned refine_by_size(struct mesh* m, double qual_floor)
   loop_free(edge_sizes);
   mesh_add_tag(m, 1, TAG_U32, "candidate", 1, candidates);
   unsigned ret = refine_common(m, 1, qual_floor, 0);
+  trace_end();
   return ret;
 }
 
 void uniformly_refine(struct mesh* m)
 {
-  unsigned nedges = mesh_count(m, 1);
-  mesh_add_tag(m, 1, TAG_U32, "candidate", 1, uints_filled(nedges, 1));
-  refine_common(m, 1, 0.0, 0);
+  mesh_refine_uniform(m);
 }
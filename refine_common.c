@@ -3,7 +3,9 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include "adapt_region.h"
 #include "arrays.h"
+#include "carry_topology.h"
 #include "comm.h"
 #include "ghost_mesh.h"
 #include "graph.h"
@@ -84,6 +86,7 @@ static void refine_ents(struct mesh* m, struct mesh* m_out,
       offset_of_doms[dom_dim] = uints_filled(mesh_count(m, dom_dim) + 1, 0);
   }
   loop_free(gen_vert_of_srcs);
+  unsigned* offset_of_same_ents[4] = {0};
   for (unsigned prod_dim = 0; prod_dim <= elem_dim; ++prod_dim) {
     if (mesh_get_rep(m) == MESH_REDUCED &&
         (0 < prod_dim && prod_dim < elem_dim))
@@ -114,9 +117,14 @@ static void refine_ents(struct mesh* m, struct mesh* m_out,
       refine_conserve(m, m_out, ndoms, prods_of_doms_offsets);
       refine_fit(m, m_out, ndoms, prods_of_doms_offsets);
     }
-    for (unsigned i = 0; i < 4; ++i)
+    offset_of_same_ents[prod_dim] = prods_of_doms_offsets[0];
+    for (unsigned i = 1; i < 4; ++i)
       loop_free(prods_of_doms_offsets[i]);
   }
+  carry_topology(m, m_out, offset_of_same_ents);
+  mesh_grow_region(m, m_out, offset_of_same_ents);
+  for (unsigned d = 0; d <= elem_dim; ++d)
+    loop_free(offset_of_same_ents[d]);
   for (unsigned dom_dim = 0; dom_dim <= elem_dim; ++dom_dim) {
     loop_free(offset_of_doms[dom_dim]);
     loop_free(direction_of_doms[dom_dim]);
@@ -155,7 +163,7 @@ static unsigned choose_refinement_indset(
   return 1;
 }
 
-unsigned refine_common(
+static unsigned refine_pass(
     struct mesh* m,
     unsigned src_dim,
     double qual_floor,
@@ -171,7 +179,7 @@ unsigned refine_common(
   }
   unsigned const* indset = mesh_find_tag(m, src_dim, "indset")->d.u32;
   unsigned nsrcs = mesh_count(m, src_dim);
-  unsigned long total = comm_add_ulong(uints_sum(indset, nsrcs));
+  unsigned long total = indset_size();
   unsigned* gen_offset_of_srcs = uints_exscan(indset, nsrcs);
   mesh_free_tag(m, src_dim, "indset");
   struct mesh* m_out = new_mesh(mesh_dim(m), mesh_get_rep(m), mesh_is_parallel(m));
@@ -179,7 +187,24 @@ unsigned refine_common(
   refine_ents(m, m_out, src_dim, gen_offset_of_srcs);
   loop_free(gen_offset_of_srcs);
   if (comm_rank() == 0)
-    printf("split %10lu %s\n", total, get_ent_name(src_dim, total));
+    printf("split %10lu %s (independent set in %u iterations)\n",
+        total, get_ent_name(src_dim, total), indset_iterations());
   overwrite_mesh(m, m_out);
   return 1;
 }
+
+/* the temporaries of a pass are charged to the adapt category */
+
+unsigned refine_common(
+    struct mesh* m,
+    unsigned src_dim,
+    double qual_floor,
+    unsigned require_better)
+{
+  loop_host_phase_begin("refine");
+  enum mem_category cat = loop_host_set_category(MEM_ADAPT);
+  unsigned ret = refine_pass(m, src_dim, qual_floor, require_better);
+  loop_host_set_category(cat);
+  loop_host_phase_end();
+  return ret;
+}
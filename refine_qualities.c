@@ -97,7 +97,7 @@ double* mesh_refine_qualities(struct mesh* m, unsigned src_dim,
   double const* coords = mesh_find_tag(m, 0, "coordinates")->d.f64;
   double* elem_quals = 0;
   if (require_better)
-    elem_quals = mesh_qualities(m);
+    elem_quals = mesh_adapt_qualities(m);
   assert(elem_dim >= src_dim);
   assert(src_dim > 0);
   unsigned base_dim = elem_dim - 1;
@@ -124,7 +124,10 @@ double* mesh_refine_qualities(struct mesh* m, unsigned src_dim,
       *p_candidates,
       src_quals);
   loop_free(elem_quals);
-  mesh_conform_doubles(m, src_dim, 1, &src_quals);
-  mesh_conform_uints(m, src_dim, 1, p_candidates);
+  void* conformed[2] = {src_quals, *p_candidates};
+  unsigned const nbytes[2] = {sizeof(double), sizeof(unsigned)};
+  mesh_conform_many(m, src_dim, 2, nbytes, conformed);
+  src_quals = conformed[0];
+  *p_candidates = conformed[1];
   return src_quals;
 }
@@ -0,0 +1,497 @@
+#include "refine_uniform.h"
+
+#include <assert.h>
+#include <stdio.h>
+
+#include "algebra.h"
+#include "arrays.h"
+#include "comm.h"
+#include "ghost_mesh.h"
+#include "inherit.h"
+#include "ints.h"
+#include "loop.h"
+#include "mesh.h"
+#include "parallel_mesh.h"
+#include "refine_conserve.h"
+#include "refine_fit.h"
+#include "refine_nodal.h"
+#include "tables.h"
+#include "trace.h"
+
+/* uniform refinement by templates: every edge gets a
+   midpoint and every entity is replaced by a fixed pattern
+   of products made of its vertices and the midpoints of
+   its edges, so the whole mesh is refined in one pass,
+   without independent sets and without communication.
+
+   the products are laid out as in refine_common:
+   the surviving entities first (only vertices survive),
+   then the products of edges, of triangles and of tets,
+   with a fixed number of products per domain. */
+
+static unsigned const prods_per_dom[4][4] = {
+  {1, 0, 0, 0},
+  {1, 2, 0, 0},
+  {0, 3, 4, 0},
+  {0, 1, 8, 8}
+};
+
+/* the local points of a domain are its vertices followed
+   by the midpoints of its edges in canonical order.
+   triangle: 3 = (0,1), 4 = (1,2), 5 = (2,0) */
+
+LOOP_CONST static unsigned const tri_corner_tris[3][3] = {
+  {0,3,5},
+  {3,1,4},
+  {5,4,2}
+};
+LOOP_CONST static unsigned const tri_center_tri[3] = {3,4,5};
+/* the interior edge cutting off each corner */
+LOOP_CONST static unsigned const tri_corner_edges[3][2] = {
+  {5,3},
+  {3,4},
+  {4,5}
+};
+
+/* tet: 4 = (0,1), 5 = (1,2), 6 = (2,0),
+        7 = (0,3), 8 = (1,3), 9 = (2,3) */
+
+LOOP_CONST static unsigned const tet_edge_verts[6][2] = {
+  {0,1},{1,2},{2,0},{0,3},{1,3},{2,3}
+};
+LOOP_CONST static unsigned const tet_corner_tets[4][4] = {
+  {0,4,6,7},
+  {4,1,5,8},
+  {6,5,2,9},
+  {7,8,9,3}
+};
+LOOP_CONST static unsigned const tet_corner_tris[4][3] = {
+  {4,6,7},
+  {4,5,8},
+  {6,5,9},
+  {7,8,9}
+};
+/* the octahedron left in the middle is split into 4 tets
+   around one of its 3 diagonals. the ring of 4 points
+   around each diagonal (a,b) is ordered such that
+   (a,b,ring[k],ring[k+1]) is positively oriented */
+LOOP_CONST static unsigned const tet_diagonals[3][2] = {
+  {4,9},
+  {5,7},
+  {6,8}
+};
+LOOP_CONST static unsigned const tet_rings[3][4] = {
+  {5,6,7,8},
+  {4,8,9,6},
+  {4,5,9,7}
+};
+
+/* products shared between ranks are numbered by the order
+   of the global numbers of their domain's vertices,
+   so all copies agree without talking to each other */
+
+LOOP_IN static inline unsigned long vert_key(
+    unsigned long const* keys, unsigned v)
+{
+  return keys ? keys[v] : v;
+}
+
+LOOP_IN static inline void rank_corners(
+    unsigned n,
+    unsigned const* verts,
+    unsigned long const* keys,
+    unsigned* ranks)
+{
+  for (unsigned j = 0; j < n; ++j) {
+    ranks[j] = 0;
+    for (unsigned k = 0; k < n; ++k)
+      if (vert_key(keys, verts[k]) < vert_key(keys, verts[j]))
+        ++ranks[j];
+  }
+}
+
+LOOP_IN static inline void put_ent(
+    unsigned verts_per_ent,
+    unsigned const* pts,
+    unsigned const* tmpl,
+    unsigned* out)
+{
+  for (unsigned j = 0; j < verts_per_ent; ++j)
+    out[j] = pts[tmpl[j]];
+}
+
+LOOP_KERNEL(uniform_edge,
+    unsigned const* verts_of_edges,
+    unsigned long const* keys,
+    unsigned nverts,
+    unsigned* edges_out)
+  unsigned const* v = verts_of_edges + i * 2;
+  unsigned ranks[2];
+  rank_corners(2, v, keys, ranks);
+  unsigned mid = nverts + i;
+  unsigned* out = edges_out + i * 2 * 2;
+  out[ranks[0] * 2 + 0] = v[0];
+  out[ranks[0] * 2 + 1] = mid;
+  out[ranks[1] * 2 + 0] = mid;
+  out[ranks[1] * 2 + 1] = v[1];
+}
+
+LOOP_KERNEL(uniform_tri,
+    unsigned const* verts_of_tris,
+    unsigned const* edges_of_tris,
+    unsigned long const* keys,
+    unsigned nverts,
+    unsigned* edges_out,
+    unsigned* tris_out)
+  unsigned pts[6];
+  for (unsigned j = 0; j < 3; ++j) {
+    pts[j] = verts_of_tris[i * 3 + j];
+    pts[3 + j] = nverts + edges_of_tris[i * 3 + j];
+  }
+  unsigned ranks[3];
+  rank_corners(3, pts, keys, ranks);
+  if (edges_out)
+    for (unsigned j = 0; j < 3; ++j)
+      put_ent(2, pts, tri_corner_edges[j],
+          edges_out + (i * 3 + ranks[j]) * 2);
+  if (tris_out) {
+    for (unsigned j = 0; j < 3; ++j)
+      put_ent(3, pts, tri_corner_tris[j],
+          tris_out + (i * 4 + ranks[j]) * 3);
+    put_ent(3, pts, tri_center_tri, tris_out + (i * 4 + 3) * 3);
+  }
+}
+
+/* tets are never shared, so their products keep the
+   local order. the shortest diagonal gives the best
+   shaped interior tets. */
+
+LOOP_KERNEL(uniform_tet,
+    unsigned const* verts_of_tets,
+    unsigned const* edges_of_tets,
+    double const* coords,
+    unsigned nverts,
+    unsigned* edges_out,
+    unsigned* tris_out,
+    unsigned* tets_out)
+  unsigned pts[10];
+  for (unsigned j = 0; j < 4; ++j)
+    pts[j] = verts_of_tets[i * 4 + j];
+  for (unsigned j = 0; j < 6; ++j)
+    pts[4 + j] = nverts + edges_of_tets[i * 6 + j];
+  double mids[6][3];
+  for (unsigned j = 0; j < 6; ++j)
+    for (unsigned k = 0; k < 3; ++k)
+      mids[j][k] = (coords[pts[tet_edge_verts[j][0]] * 3 + k] +
+                    coords[pts[tet_edge_verts[j][1]] * 3 + k]) / 2;
+  unsigned diag = 0;
+  double min_len = 0;
+  for (unsigned j = 0; j < 3; ++j) {
+    double len = vector_squared_distance(
+        mids[tet_diagonals[j][0] - 4], mids[tet_diagonals[j][1] - 4], 3);
+    if (!j || len < min_len) {
+      diag = j;
+      min_len = len;
+    }
+  }
+  unsigned a = pts[tet_diagonals[diag][0]];
+  unsigned b = pts[tet_diagonals[diag][1]];
+  unsigned ring[4];
+  for (unsigned j = 0; j < 4; ++j)
+    ring[j] = pts[tet_rings[diag][j]];
+  if (edges_out) {
+    edges_out[i * 2 + 0] = a;
+    edges_out[i * 2 + 1] = b;
+  }
+  if (tris_out) {
+    for (unsigned j = 0; j < 4; ++j)
+      put_ent(3, pts, tet_corner_tris[j], tris_out + (i * 8 + j) * 3);
+    for (unsigned j = 0; j < 4; ++j) {
+      unsigned* t = tris_out + (i * 8 + 4 + j) * 3;
+      t[0] = a;
+      t[1] = b;
+      t[2] = ring[j];
+    }
+  }
+  if (tets_out) {
+    for (unsigned j = 0; j < 4; ++j)
+      put_ent(4, pts, tet_corner_tets[j], tets_out + (i * 8 + j) * 4);
+    for (unsigned j = 0; j < 4; ++j) {
+      unsigned* t = tets_out + (i * 8 + 4 + j) * 4;
+      t[0] = a;
+      t[1] = b;
+      t[2] = ring[j];
+      t[3] = ring[(j + 1) % 4];
+    }
+  }
+}
+
+static unsigned wants_dim(struct mesh* m, unsigned dim)
+{
+  return dim == 0 || dim == mesh_dim(m) || mesh_get_rep(m) == MESH_FULL;
+}
+
+/* products per domain, zero if the domain makes none
+   that this mesh representation keeps */
+static unsigned uniform_prods(struct mesh* m, unsigned dom_dim,
+    unsigned prod_dim)
+{
+  if (dom_dim > mesh_dim(m) || !wants_dim(m, prod_dim))
+    return 0;
+  if (prod_dim && !wants_dim(m, dom_dim))
+    return 0;
+  return prods_per_dom[dom_dim][prod_dim];
+}
+
+static void setup_uniform(
+    struct mesh* m,
+    unsigned prod_dim,
+    /* out: */
+    unsigned ndoms[4],
+    unsigned* prods_of_doms_offsets[4],
+    unsigned ngen_offsets[5])
+{
+  for (unsigned d = 0; d < 4; ++d) {
+    unsigned per_dom = uniform_prods(m, d, prod_dim);
+    if (per_dom) {
+      ndoms[d] = mesh_count(m, d);
+      prods_of_doms_offsets[d] = uints_linear(ndoms[d] + 1, per_dom);
+    } else {
+      ndoms[d] = 0;
+      prods_of_doms_offsets[d] = 0;
+    }
+  }
+  if (prod_dim) {
+    /* none of the old entities survive */
+    ndoms[0] = mesh_count(m, prod_dim);
+    prods_of_doms_offsets[0] = uints_filled(ndoms[0] + 1, 0);
+  }
+  unsigned ngen[4];
+  make_ngen_from_doms(ndoms, prods_of_doms_offsets, ngen);
+  make_ngen_offsets(ngen, ngen_offsets);
+}
+
+static unsigned long count_global(struct mesh* m, unsigned dim)
+{
+  unsigned* owned = mesh_get_owned(m, dim);
+  unsigned long n = uints_sum(owned, mesh_count(m, dim));
+  loop_free(owned);
+  return comm_add_ulong(n);
+}
+
+LOOP_KERNEL(uniform_global,
+    unsigned long const* dom_globals,
+    unsigned prods_per_dom,
+    unsigned long offset,
+    unsigned long* prod_globals)
+  for (unsigned j = 0; j < prods_per_dom; ++j)
+    prod_globals[i * prods_per_dom + j] =
+      offset + dom_globals[i] * prods_per_dom + j;
+}
+
+/* product (j) of the domain with global number (g) gets
+   the global number (offset + g * prods_per_dom + j)
+   and the owner of its domain */
+
+static void uniform_parallel(
+    struct mesh* m,
+    struct mesh* m_out,
+    unsigned prod_dim,
+    unsigned long const nglobal[4],
+    unsigned ndoms[4],
+    unsigned* prods_of_doms_offsets[4],
+    unsigned ngen_offsets[5])
+{
+  unsigned long* globals = LOOP_MALLOC(unsigned long, ngen_offsets[4]);
+  unsigned* gen_ranks[4];
+  unsigned long offset = 0;
+  for (unsigned d = 0; d < 4; ++d) {
+    unsigned per_dom = uniform_prods(m, d, prod_dim);
+    gen_ranks[d] = 0;
+    if (!per_dom)
+      continue;
+    LOOP_EXEC(uniform_global, ndoms[d], mesh_ask_globals(m, d),
+        per_dom, offset, globals + ngen_offsets[d]);
+    offset += nglobal[d] * per_dom;
+    gen_ranks[d] = uints_expand(ndoms[d], 1, mesh_ask_own_ranks(m, d),
+        prods_of_doms_offsets[d]);
+  }
+  mesh_set_globals(m_out, prod_dim, globals);
+  mesh_set_own_ranks(m_out, prod_dim,
+      concat_uints_inherited(1, ngen_offsets, gen_ranks));
+}
+
+static void uniform_verts(struct mesh* m, struct mesh* m_out)
+{
+  unsigned nverts = mesh_count(m, 0);
+  unsigned nedges = mesh_count(m, 1);
+  mesh_set_ents(m_out, 0, nverts + nedges, 0);
+  unsigned const* verts_of_edges = mesh_ask_down(m, 1, 0);
+  unsigned* gen_offset_of_edges = uints_linear(nedges + 1, 1);
+  for (unsigned i = 0; i < mesh_count_tags(m, 0); ++i) {
+    struct const_tag* t = mesh_get_tag(m, 0, i);
+    if (t->type != TAG_F64)
+      continue;
+    double* gen_vals = refine_nodal(1, nedges, verts_of_edges,
+        gen_offset_of_edges, t->ncomps, t->d.f64);
+    double* vals_out = concat_doubles(t->ncomps, t->d.f64, nverts,
+        gen_vals, nedges);
+    loop_free(gen_vals);
+    mesh_add_tag(m_out, 0, t->type, t->name, t->ncomps, vals_out);
+  }
+  loop_free(gen_offset_of_edges);
+}
+
+/* integer vertex tags have no value in between two others,
+   so a midpoint takes the larger of its edge's two values.
+   for "adapt_region" this puts exactly the children of the
+   region's elements in the region. tags that the pass sets
+   itself (the classification) are left alone. */
+
+#define GENERIC_UNIFORM_VERTS(T, name) \
+LOOP_KERNEL(name##_edge_max, \
+    unsigned ncomps, \
+    unsigned const* verts_of_edges, \
+    T const* in, \
+    T* out) \
+  unsigned a = verts_of_edges[i * 2 + 0]; \
+  unsigned b = verts_of_edges[i * 2 + 1]; \
+  for (unsigned j = 0; j < ncomps; ++j) { \
+    T va = in[a * ncomps + j]; \
+    T vb = in[b * ncomps + j]; \
+    out[i * ncomps + j] = (va > vb) ? va : vb; \
+  } \
+} \
+static T* name##_uniform_verts(unsigned nverts, unsigned nedges, \
+    unsigned const* verts_of_edges, unsigned ncomps, T const* in) \
+{ \
+  T* out = LOOP_MALLOC(T, (nverts + nedges) * ncomps); \
+  name##_memcpy(out, in, nverts * ncomps); \
+  LOOP_EXEC(name##_edge_max, nedges, ncomps, verts_of_edges, in, \
+      out + nverts * ncomps); \
+  return out; \
+}
+
+GENERIC_UNIFORM_VERTS(unsigned char, uchars)
+GENERIC_UNIFORM_VERTS(unsigned, uints)
+GENERIC_UNIFORM_VERTS(unsigned long, ulongs)
+
+static void uniform_int_verts(struct mesh* m, struct mesh* m_out)
+{
+  unsigned nverts = mesh_count(m, 0);
+  unsigned nedges = mesh_count(m, 1);
+  unsigned const* verts_of_edges = mesh_ask_down(m, 1, 0);
+  for (unsigned i = 0; i < mesh_count_tags(m, 0); ++i) {
+    struct const_tag* t = mesh_get_tag(m, 0, i);
+    if (t->type == TAG_F64 || mesh_find_tag(m_out, 0, t->name))
+      continue;
+    void* vals_out = 0;
+    switch (t->type) {
+      case TAG_U8:
+        vals_out = uchars_uniform_verts(nverts, nedges, verts_of_edges,
+            t->ncomps, t->d.u8);
+        break;
+      case TAG_U32:
+        vals_out = uints_uniform_verts(nverts, nedges, verts_of_edges,
+            t->ncomps, t->d.u32);
+        break;
+      case TAG_U64:
+        vals_out = ulongs_uniform_verts(nverts, nedges, verts_of_edges,
+            t->ncomps, t->d.u64);
+        break;
+      case TAG_F64:
+        break;
+    }
+    mesh_add_tag(m_out, 0, t->type, t->name, t->ncomps, vals_out);
+  }
+}
+
+static void uniform_topology(struct mesh* m,
+    unsigned ngen_offsets[4][5],
+    unsigned* verts_of_prods[4])
+{
+  unsigned elem_dim = mesh_dim(m);
+  unsigned nverts = mesh_count(m, 0);
+  unsigned long const* keys = 0;
+  if (mesh_is_parallel(m))
+    keys = mesh_ask_globals(m, 0);
+  unsigned* out[4][4] = {{0}};
+  unsigned any[4] = {0};
+  for (unsigned d = 1; d <= elem_dim; ++d)
+    for (unsigned p = 1; p <= d; ++p)
+      if (uniform_prods(m, d, p)) {
+        out[d][p] = verts_of_prods[p] + ngen_offsets[p][d] * (p + 1);
+        any[d] = 1;
+      }
+  if (any[1])
+    LOOP_EXEC(uniform_edge, mesh_count(m, 1),
+        mesh_ask_down(m, 1, 0), keys, nverts, out[1][1]);
+  if (any[2])
+    LOOP_EXEC(uniform_tri, mesh_count(m, 2),
+        mesh_ask_down(m, 2, 0), mesh_ask_down(m, 2, 1), keys, nverts,
+        out[2][1], out[2][2]);
+  if (any[3])
+    LOOP_EXEC(uniform_tet, mesh_count(m, 3),
+        mesh_ask_down(m, 3, 0), mesh_ask_down(m, 3, 1),
+        mesh_find_tag(m, 0, "coordinates")->d.f64, nverts,
+        out[3][1], out[3][2], out[3][3]);
+}
+
+static void uniform_pass(struct mesh* m)
+{
+  if (mesh_is_parallel(m)) {
+    assert(mesh_get_rep(m) == MESH_FULL);
+    mesh_ensure_ghosting(m, 0);
+  }
+  unsigned elem_dim = mesh_dim(m);
+  unsigned long nglobal[4] = {0};
+  for (unsigned d = 0; d <= elem_dim; ++d)
+    nglobal[d] = mesh_is_parallel(m) ? count_global(m, d) : mesh_count(m, d);
+  unsigned long total = nglobal[1];
+  struct mesh* m_out = new_mesh(elem_dim, mesh_get_rep(m), mesh_is_parallel(m));
+  uniform_verts(m, m_out);
+  unsigned ndoms[4][4];
+  unsigned* prods_of_doms_offsets[4][4];
+  unsigned ngen_offsets[4][5];
+  unsigned* verts_of_prods[4] = {0};
+  for (unsigned p = 0; p <= elem_dim; ++p) {
+    if (!wants_dim(m, p))
+      continue;
+    setup_uniform(m, p, ndoms[p], prods_of_doms_offsets[p], ngen_offsets[p]);
+    if (p)
+      verts_of_prods[p] = LOOP_MALLOC(unsigned,
+          ngen_offsets[p][4] * (p + 1));
+  }
+  uniform_topology(m, ngen_offsets, verts_of_prods);
+  for (unsigned p = 0; p <= elem_dim; ++p) {
+    if (!wants_dim(m, p))
+      continue;
+    if (p)
+      mesh_set_ents(m_out, p, ngen_offsets[p][4], verts_of_prods[p]);
+    if (mesh_is_parallel(m))
+      uniform_parallel(m, m_out, p, nglobal,
+          ndoms[p], prods_of_doms_offsets[p], ngen_offsets[p]);
+    inherit_class(m, m_out, p, ndoms[p], prods_of_doms_offsets[p]);
+    if (p == elem_dim) {
+      refine_conserve(m, m_out, ndoms[p], prods_of_doms_offsets[p]);
+      refine_fit(m, m_out, ndoms[p], prods_of_doms_offsets[p]);
+    }
+    for (unsigned d = 0; d < 4; ++d)
+      loop_free(prods_of_doms_offsets[p][d]);
+  }
+  uniform_int_verts(m, m_out);
+  if (comm_rank() == 0)
+    printf("split %10lu %s\n", total, get_ent_name(1, total));
+  overwrite_mesh(m, m_out);
+}
+
+void mesh_refine_uniform(struct mesh* m)
+{
+  trace_begin("refine_uniform");
+  loop_host_phase_begin("refine");
+  enum mem_category cat = loop_host_set_category(MEM_ADAPT);
+  uniform_pass(m);
+  loop_host_set_category(cat);
+  loop_host_phase_end();
+  trace_end();
+}
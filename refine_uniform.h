@@ -0,0 +1,8 @@
+#ifndef REFINE_UNIFORM_H
+#define REFINE_UNIFORM_H
+
+struct mesh;
+
+void mesh_refine_uniform(struct mesh* m);
+
+#endif
@@ -2,6 +2,7 @@
 
 #include <assert.h>
 
+#include "derive_by_sort.h"
 #include "ints.h"
 #include "loop.h"
 #include "mesh.h"
@@ -70,8 +71,24 @@ unsigned* mesh_reflect_down(
     unsigned high_dim,
     unsigned low_dim)
 {
-  unsigned nhighs = mesh_count(m, high_dim);
-  unsigned const* verts_of_highs = mesh_ask_down(m, high_dim, 0);
+  return mesh_reflect_down_from(m, high_dim, low_dim, 0);
+}
+
+unsigned* mesh_reflect_down_from(
+    struct mesh* m,
+    unsigned high_dim,
+    unsigned low_dim,
+    unsigned first_high)
+{
+  unsigned nhighs = mesh_count(m, high_dim) - first_high;
+  unsigned const* verts_of_highs = mesh_ask_down(m, high_dim, 0) +
+    first_high * the_down_degrees[high_dim][0];
+  /* an upward adjacency that is already there is still the
+     fastest way, but in sort mode none is built for this */
+  if (mesh_get_derive(m) == MESH_DERIVE_SORT && !mesh_find_up(m, 0, low_dim))
+    return reflect_down_by_sort(high_dim, low_dim, nhighs,
+        mesh_count(m, low_dim), mesh_count(m, 0), verts_of_highs,
+        mesh_ask_down(m, low_dim, 0));
   struct const_up* lows_of_verts = mesh_ask_up(m, 0, low_dim);
   unsigned const* verts_of_lows = mesh_ask_down(m, low_dim, 0);
   return reflect_down(high_dim, low_dim, nhighs, verts_of_highs, verts_of_lows,
@@ -14,4 +14,12 @@ unsigned* mesh_reflect_down(
     unsigned high_dim,
     unsigned low_dim);
 
+/* the same, for only the (high) entities from (first_high) on */
+
+unsigned* mesh_reflect_down_from(
+    struct mesh* m,
+    unsigned high_dim,
+    unsigned low_dim,
+    unsigned first_high);
+
 #endif
@@ -2,24 +2,36 @@
 
 #include "arrays.h"
 #include "bfs.h"
+#include "doubles.h"
+#include "element_field.h"
+#include "graph.h"
 #include "ints.h"
 #include "loop.h"
 #include "mark.h"
 #include "mesh.h"
+#include "sort.h"
 #include "tables.h"
 
-static void get_host_graph(struct mesh* m,
-    unsigned** p_offsets,
-    unsigned** p_adj)
-{
-  unsigned nverts = mesh_count(m, 0);
-  unsigned* offsets = uints_to_host(
-      mesh_ask_star(m, 0, 1)->offsets, nverts + 1);
-  unsigned nadj = offsets[nverts];
-  unsigned* adj = uints_to_host(
-      mesh_ask_star(m, 0, 1)->adj, nadj);
-  *p_offsets = offsets;
-  *p_adj = adj;
+LOOP_KERNEL(invert_order_kern,
+    unsigned const* order,
+    unsigned* old_to_new)
+  old_to_new[order[i]] = i;
+}
+
+/* the BFS ordering runs on the vertex star as it is,
+   using the parallel BFS and components from bfs.c */
+
+LOOP_KERNEL(seed_marked,
+    unsigned const* marked,
+    unsigned const* marked_offsets,
+    unsigned* queue,
+    unsigned* depth)
+  if (marked[i]) {
+    queue[marked_offsets[i]] = i;
+    depth[i] = 0;
+  } else {
+    depth[i] = INVALID;
+  }
 }
 
 static unsigned* compute_boundary_depth(struct mesh* m,
@@ -30,108 +42,315 @@ static unsigned* compute_boundary_depth(struct mesh* m,
   unsigned* bdry_sides = mesh_mark_part_boundary(m);
   unsigned* bdry_verts = mesh_mark_down(m, dim - 1, 0, bdry_sides);
   loop_free(bdry_sides);
-  unsigned* host_bdry_verts = uints_to_host(bdry_verts, nverts);
-  loop_free(bdry_verts);
-  unsigned* queue = LOOP_HOST_MALLOC(unsigned, nverts);
-  unsigned* depth = LOOP_HOST_MALLOC(unsigned, nverts);
+  unsigned* bdry_offsets = uints_exscan(bdry_verts, nverts);
+  unsigned* queue = LOOP_MALLOC(unsigned, nverts);
+  unsigned* depth = LOOP_MALLOC(unsigned, nverts);
+  LOOP_EXEC(seed_marked, nverts, bdry_verts, bdry_offsets, queue, depth);
   unsigned begin = 0;
-  unsigned end = 0;
-  for (unsigned i = 0; i < nverts; ++i)
-    if (host_bdry_verts[i]) {
-      queue[end++] = i;
-      depth[i] = 0;
-    } else {
-      depth[i] = INVALID;
-    }
-  loop_host_free(host_bdry_verts);
-  bfs_continue(queue, &begin, &end, offsets, adj, 0, depth);
-  loop_host_free(queue);
+  unsigned end = uints_at(bdry_offsets, nverts);
+  loop_free(bdry_verts);
+  loop_free(bdry_offsets);
+  bfs_continue_parallel(nverts, queue, &begin, &end, offsets, adj, 0, depth);
+  loop_free(queue);
   return depth;
 }
 
-static void enqueue_component_maxima(
-    unsigned nverts,
-    unsigned const* depth, unsigned const* comp,
-    unsigned* queue, unsigned* p_end)
+LOOP_KERNEL(maxima_key,
+    unsigned const* depth,
+    unsigned const* comp,
+    unsigned max_depth,
+    unsigned depth_bits,
+    unsigned long* keys)
+  keys[i] = (((unsigned long) comp[i]) << depth_bits) |
+    (max_depth - depth[i]);
+}
+
+LOOP_KERNEL(first_of_comp,
+    unsigned const* order,
+    unsigned const* comp,
+    unsigned* seeds)
+  unsigned v = order[i];
+  if (i == 0 || comp[order[i - 1]] != comp[v])
+    seeds[comp[v]] = v;
+}
+
+/* per component, the first vertex of greatest depth,
+   found by sorting on (component, -depth) */
+
+static unsigned* component_maxima(
+    unsigned nverts, unsigned ncomps,
+    unsigned const* depth, unsigned const* comp)
 {
-  for (unsigned c = 0; c < nverts; ++c) {
-    unsigned max_v = INVALID;
-    unsigned max_depth = INVALID;
-    unsigned exists = 0;
-    for (unsigned v = 0; v < nverts; ++v) {
-      if (comp[v] != c)
-        continue;
-      exists = 1;
-      if (max_v == INVALID || depth[v] > max_depth) {
-        max_v = v;
-        max_depth = depth[v];
+  unsigned max_depth = uints_max(depth, nverts);
+  unsigned long* keys = LOOP_MALLOC(unsigned long, nverts);
+  LOOP_EXEC(maxima_key, nverts, depth, comp, max_depth,
+      count_bits(max_depth), keys);
+  unsigned* order = sort_ulongs(nverts, keys);
+  loop_free(keys);
+  unsigned* seeds = LOOP_MALLOC(unsigned, ncomps);
+  LOOP_EXEC(first_of_comp, nverts, order, comp, seeds);
+  loop_free(order);
+  return seeds;
+}
+
+LOOP_KERNEL(seed_layer,
+    unsigned const* seeds,
+    unsigned* queue,
+    unsigned* layer)
+  queue[i] = seeds[i];
+  layer[seeds[i]] = 0;
+}
+
+LOOP_KERNEL(queue_comp_key,
+    unsigned const* queue,
+    unsigned const* comp,
+    unsigned long* keys)
+  keys[i] = comp[queue[i]];
+}
+
+/* a BFS from each component's seed at once.
+   the result is then stably sorted by component, which
+   is the order of searching one component at a time */
+
+static unsigned* bfs_from_seeds(
+    unsigned nverts, unsigned ncomps, unsigned const* seeds,
+    unsigned const* offsets, unsigned const* adj,
+    unsigned const* comp, unsigned* layer)
+{
+  unsigned* queue = LOOP_MALLOC(unsigned, nverts);
+  LOOP_EXEC(seed_layer, ncomps, seeds, queue, layer);
+  unsigned begin = 0;
+  unsigned end = ncomps;
+  bfs_continue_parallel(nverts, queue, &begin, &end, offsets, adj, 0, layer);
+  assert(end == nverts);
+  if (!comp)
+    return queue;
+  unsigned long* keys = LOOP_MALLOC(unsigned long, nverts);
+  LOOP_EXEC(queue_comp_key, nverts, queue, comp, keys);
+  unsigned* order = sort_ulongs(nverts, keys);
+  loop_free(keys);
+  unsigned* sorted = uints_unshuffle(nverts, queue, 1, order);
+  loop_free(order);
+  loop_free(queue);
+  return sorted;
+}
+
+unsigned* compute_ordering(struct mesh* m)
+{
+  unsigned nverts = mesh_count(m, 0);
+  struct const_graph* star = mesh_ask_star(m, 0, 1);
+  unsigned const* offsets = star->offsets;
+  unsigned const* adj = star->adj;
+  unsigned* depth = compute_boundary_depth(m, offsets, adj);
+  unsigned* comp = LOOP_MALLOC(unsigned, nverts);
+  connected_components_parallel(nverts, offsets, adj, comp);
+  unsigned ncomps = nverts ? uints_max(comp, nverts) + 1 : 0;
+  unsigned* seeds = component_maxima(nverts, ncomps, depth, comp);
+  loop_free(depth);
+  unsigned* radius = uints_filled(nverts, INVALID);
+  loop_free(bfs_from_seeds(nverts, ncomps, seeds, offsets, adj, 0, radius));
+  loop_free(seeds);
+  unsigned* comp_seeds = component_maxima(nverts, ncomps, radius, comp);
+  loop_free(radius);
+  unsigned* layer = uints_filled(nverts, INVALID);
+  unsigned* queue = bfs_from_seeds(nverts, ncomps, comp_seeds,
+      offsets, adj, comp, layer);
+  loop_free(comp_seeds);
+  loop_free(comp);
+  loop_free(layer);
+  unsigned* order = LOOP_MALLOC(unsigned, nverts);
+  LOOP_EXEC(invert_order_kern, nverts, queue, order);
+  loop_free(queue);
+  return order;
+}
+
+/* the Hilbert curve ordering: points are snapped to a
+   grid over the vertices' bounding box (using only the
+   axes along which the mesh has any extent) and sorted
+   by their distance along the curve, which is computed
+   with Skilling's transpose algorithm.
+   entities of higher dimension use their centroids. */
+
+struct hilbert_grid {
+  double lo[3];
+  double scale;
+  unsigned axes[3];
+  unsigned naxes;
+  unsigned bits;
+};
+
+LOOP_INOUT static inline unsigned long
+hilbert_index(unsigned naxes, unsigned bits, unsigned* x)
+{
+  unsigned m = 1u << (bits - 1);
+  /* inverse undo */
+  for (unsigned q = m; q > 1; q >>= 1) {
+    unsigned p = q - 1;
+    for (unsigned j = 0; j < naxes; ++j) {
+      if (x[j] & q) {
+        x[0] ^= p;
+      } else {
+        unsigned t = (x[0] ^ x[j]) & p;
+        x[0] ^= t;
+        x[j] ^= t;
       }
     }
-    if (!exists)
-      break;
-    assert(max_v != INVALID);
-    queue[(*p_end)++] = max_v;
   }
+  /* gray encode */
+  for (unsigned j = 1; j < naxes; ++j)
+    x[j] ^= x[j - 1];
+  unsigned t = 0;
+  for (unsigned q = m; q > 1; q >>= 1)
+    if (x[naxes - 1] & q)
+      t ^= q - 1;
+  for (unsigned j = 0; j < naxes; ++j)
+    x[j] ^= t;
+  /* interleave the transposed bits, most significant first */
+  unsigned long key = 0;
+  for (unsigned b = bits; b-- > 0;)
+    for (unsigned j = 0; j < naxes; ++j)
+      key = (key << 1) | ((x[j] >> b) & 1);
+  return key;
 }
 
-static unsigned* invert_order(unsigned* o, unsigned n)
+LOOP_KERNEL(hilbert_key,
+    unsigned verts_per_ent,
+    unsigned const* verts_of_ents,
+    double const* coords,
+    struct hilbert_grid g,
+    unsigned long* keys)
+  double c[3];
+  if (verts_of_ents)
+    average_element_field(verts_per_ent, verts_of_ents + i * verts_per_ent,
+        coords, 3, c);
+  else
+    for (unsigned j = 0; j < 3; ++j)
+      c[j] = coords[i * 3 + j];
+  unsigned max = (1u << g.bits) - 1;
+  unsigned x[3];
+  for (unsigned j = 0; j < g.naxes; ++j) {
+    unsigned a = g.axes[j];
+    double q = (c[a] - g.lo[a]) * g.scale;
+    if (q < 0)
+      q = 0;
+    x[j] = (q < max) ? (unsigned) q : max;
+  }
+  keys[i] = g.naxes ? hilbert_index(g.naxes, g.bits, x) : 0;
+}
+
+LOOP_KERNEL(get_component,
+    double const* coords,
+    unsigned comp,
+    double* out)
+  out[i] = coords[i * 3 + comp];
+}
+
+/* the grid only needs to be fine enough to tell most
+   entities apart, coarser grids make for cheaper keys
+   and fewer sorting passes */
+#define HILBERT_EXTRA_BITS 12
+
+static struct hilbert_grid make_hilbert_grid(unsigned nverts,
+    double const* coords, unsigned npoints)
 {
-  unsigned* io = LOOP_HOST_MALLOC(unsigned, n);
-  for (unsigned i = 0; i < n; ++i)
-    io[o[i]] = i;
-  return io;
+  struct hilbert_grid g;
+  double extent[3];
+  double max_extent = 0;
+  double* comp = LOOP_MALLOC(double, nverts);
+  for (unsigned j = 0; j < 3; ++j) {
+    LOOP_EXEC(get_component, nverts, coords, j, comp);
+    g.lo[j] = nverts ? doubles_min(comp, nverts) : 0;
+    extent[j] = nverts ? doubles_max(comp, nverts) - g.lo[j] : 0;
+    if (extent[j] > max_extent)
+      max_extent = extent[j];
+  }
+  loop_free(comp);
+  g.naxes = 0;
+  for (unsigned j = 0; j < 3; ++j)
+    if (extent[j] > 0)
+      g.axes[g.naxes++] = j;
+  for (unsigned j = g.naxes; j < 3; ++j)
+    g.axes[j] = 0;
+  g.bits = 1;
+  if (g.naxes) {
+    unsigned key_bits = count_bits(npoints) + HILBERT_EXTRA_BITS;
+    g.bits = (key_bits + g.naxes - 1) / g.naxes;
+    /* 64-bit keys, at most 31 bits per axis */
+    if (g.bits > 63 / g.naxes)
+      g.bits = 63 / g.naxes;
+    if (g.bits > 31)
+      g.bits = 31;
+  }
+  g.scale = max_extent > 0 ? ((double) (1u << g.bits)) / max_extent : 0;
+  return g;
 }
 
-unsigned* compute_ordering(struct mesh* m)
+unsigned* compute_hilbert_ordering(struct mesh* m, unsigned dim)
 {
   unsigned nverts = mesh_count(m, 0);
-  unsigned* offsets;
-  unsigned* adj;
-  get_host_graph(m, &offsets, &adj);
-  unsigned* depth = compute_boundary_depth(m, offsets, adj);
-  unsigned* comp = LOOP_HOST_MALLOC(unsigned, nverts);
-  connected_components(nverts, offsets, adj, comp);
-  unsigned* queue = LOOP_HOST_MALLOC(unsigned, nverts);
-  unsigned end = 0;
-  enqueue_component_maxima(nverts, depth, comp, queue, &end);
-  unsigned ncomps = end;
-  unsigned begin = 0;
-  unsigned* radius = depth;
-  for (unsigned i = 0; i < nverts; ++i)
-    radius[i] = INVALID;
-  for (unsigned i = 0; i < end; ++i)
-    radius[queue[i]] = 0;
-  bfs_continue(queue, &begin, &end, offsets, adj, 0, radius);
-  assert(end == nverts);
-  /* we could do all the components from their boundary seeds
-     at once and then sort by component first and layer second.
-     we'll avoid the need to bring a sort into this by doing
-     one component at a time. */
-  unsigned* comp_seeds = LOOP_HOST_MALLOC(unsigned, ncomps);
-  end = 0;
-  enqueue_component_maxima(nverts, radius, comp, comp_seeds, &end);
-  assert(end == ncomps);
-  loop_host_free(comp);
-  unsigned* layer = radius;
-  for (unsigned i = 0; i < nverts; ++i)
-    layer[i] = INVALID;
-  begin = 0;
-  end = 0;
-  for (unsigned c = 0; c < ncomps; ++c) {
-    queue[end++] = comp_seeds[c];
-    layer[comp_seeds[c]] = 0;
-    bfs_continue(queue, &begin, &end, offsets, adj, 0, layer);
+  unsigned nents = mesh_count(m, dim);
+  double const* coords = mesh_find_tag(m, 0, "coordinates")->d.f64;
+  struct hilbert_grid g = make_hilbert_grid(nverts, coords, nents);
+  unsigned const* verts_of_ents = dim ? mesh_ask_down(m, dim, 0) : 0;
+  unsigned long* keys = LOOP_MALLOC(unsigned long, nents);
+  LOOP_EXEC(hilbert_key, nents, the_down_degrees[dim][0], verts_of_ents,
+      coords, g, keys);
+  unsigned* order = sort_ulongs(nents, keys);
+  loop_free(keys);
+  unsigned* old_to_new = LOOP_MALLOC(unsigned, nents);
+  LOOP_EXEC(invert_order_kern, nents, order, old_to_new);
+  loop_free(order);
+  return old_to_new;
+}
+
+/* an entity's key is made of the new numbers of its
+   vertices, lowest first, packed into 64 bits for as
+   many vertices as fit. sorting by it orders entities
+   by their lowest vertex, then their next lowest, etc. */
+
+LOOP_KERNEL(vert_sort_key,
+    unsigned verts_per_ent,
+    unsigned const* verts_of_ents,
+    unsigned const* old_to_new_verts,
+    unsigned bits,
+    unsigned nkey_verts,
+    unsigned long* keys)
+  unsigned v[4];
+  for (unsigned j = 0; j < verts_per_ent; ++j) {
+    unsigned n = old_to_new_verts[verts_of_ents[i * verts_per_ent + j]];
+    unsigned k = j;
+    for (; k > 0 && v[k - 1] > n; --k)
+      v[k] = v[k - 1];
+    v[k] = n;
   }
-  assert(end == nverts);
-  loop_host_free(comp_seeds);
-  loop_host_free(offsets);
-  loop_host_free(adj);
-  loop_host_free(layer);
-  unsigned* order = invert_order(queue, nverts);
-  loop_host_free(queue);
-  unsigned* out = uints_to_device(order, nverts);
-  loop_host_free(order);
-  return out;
+  unsigned long key = 0;
+  for (unsigned j = 0; j < nkey_verts; ++j)
+    key = (key << bits) | v[j];
+  keys[i] = key;
+}
+
+unsigned* sort_ents_by_verts(struct mesh* m,
+    unsigned ent_dim, unsigned const* old_to_new_verts)
+{
+  unsigned nverts = mesh_count(m, 0);
+  unsigned nents = mesh_count(m, ent_dim);
+  unsigned verts_per_ent = the_down_degrees[ent_dim][0];
+  unsigned bits = count_bits(nverts ? nverts - 1 : 0);
+  if (!bits)
+    bits = 1;
+  unsigned nkey_verts = 64 / bits;
+  if (nkey_verts > verts_per_ent)
+    nkey_verts = verts_per_ent;
+  unsigned long* keys = LOOP_MALLOC(unsigned long, nents);
+  LOOP_EXEC(vert_sort_key, nents, verts_per_ent,
+      mesh_ask_down(m, ent_dim, 0), old_to_new_verts,
+      bits, nkey_verts, keys);
+  unsigned* order = sort_ulongs(nents, keys);
+  loop_free(keys);
+  unsigned* old_to_new = LOOP_MALLOC(unsigned, nents);
+  LOOP_EXEC(invert_order_kern, nents, order, old_to_new);
+  loop_free(order);
+  return old_to_new;
 }
 
 LOOP_KERNEL(count_fan_ents,
@@ -5,7 +5,16 @@ struct mesh;
 
 unsigned* compute_ordering(struct mesh* m);
 
+/* old-to-new numbers of the entities of dimension (dim)
+   along a Hilbert curve through their centroids */
+unsigned* compute_hilbert_ordering(struct mesh* m, unsigned dim);
+
 unsigned* number_ents(struct mesh* m,
     unsigned ent_dim, unsigned const* vert_num);
 
+/* old-to-new numbers of the entities of dimension (ent_dim)
+   sorted by the new numbers of their vertices, lowest first */
+unsigned* sort_ents_by_verts(struct mesh* m,
+    unsigned ent_dim, unsigned const* old_to_new_verts);
+
 #endif
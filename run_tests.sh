@@ -1,10 +1,22 @@
 #!/bin/bash -ex
 
 $VALGRIND ./bin/loop.exe
+$VALGRIND ./bin/loop_timing.exe scratch/loop_timing.json
 if [ "$LOOP_MODE" = "cuda" ]; then
   return
 fi
-$VALGRIND ./bin/box.exe --file scratch/box.vtu --dim 2 --refinements 6
+$VALGRIND ./bin/box.exe --file scratch/box.vtu --dim 2 --refinements 3
+$VALGRIND ./bin/box.exe --file scratch/box3.vtu --dim 3 --refinements 2
+$VALGRIND ./bin/memory.exe scratch/box.vtu
+$VALGRIND ./bin/memory.exe scratch/box.vtu sort
+$VALGRIND ./bin/memory.exe scratch/box3.vtu sort
+$VALGRIND ./bin/memory.exe scratch/box.vtu budget
+$VALGRIND ./bin/memory.exe scratch/box3.vtu budget
+$VALGRIND ./bin/carry.exe scratch/box.vtu
+$VALGRIND ./bin/carry.exe scratch/box3.vtu
+$VALGRIND ./bin/region.exe scratch/box.vtu
+$VALGRIND ./bin/region.exe scratch/box3.vtu
+$VALGRIND ./bin/smooth.exe scratch/box.vtu
 $VALGRIND ./bin/vtkdiff.exe --help
 $VALGRIND ./bin/vtk_ascii.exe data/bgq_box.vtu scratch/bgq_ascii_box.vtu
 $VALGRIND ./bin/vtkdiff.exe -tolerance 1e-6 -Floor 1e-15 scratch/bgq_ascii_box.vtu scratch/box.vtu
@@ -17,14 +29,31 @@ if [ -e gold/gmsh_cube.vtu ]; then
 fi
 cp scratch/cube.vtu gold/gmsh_cube.vtu
 $VALGRIND ./bin/grad.exe scratch
+$VALGRIND ./bin/exchanger_perf.exe 10000
+$VALGRIND ./bin/invert_map_perf.exe 10000
+$VALGRIND ./bin/uniform_refine_perf.exe 3 2
+$VALGRIND ./bin/uniform_refine.exe scratch/box3.vtu
+$VALGRIND ./bin/reorder_perf.exe 3 2
+$VALGRIND ./bin/bfs_perf.exe 3 2
 if [ "$USE_MPI" = "1" ]; then
   $MPIRUN -np 2 $VALGRIND ./bin/migrate.exe scratch
   $MPIRUN -np 2 $VALGRIND ./bin/conform.exe scratch
   $MPIRUN -np 2 $VALGRIND ./bin/partition.exe scratch/box.vtu scratch/split.pvtu
+  $MPIRUN -np 3 $VALGRIND ./bin/partition.exe scratch/box.vtu scratch/split3.pvtu
+  $MPIRUN -np 5 $VALGRIND ./bin/partition.exe scratch/box3.vtu scratch/split5.pvtu
+  $MPIRUN -np 3 $VALGRIND ./bin/uniform_refine.exe scratch/box.vtu
+  $MPIRUN -np 2 $VALGRIND ./bin/uniform_refine.exe scratch/box3.vtu
+  $MPIRUN -np 3 $VALGRIND ./bin/partition_perf.exe 3 2
+  $MPIRUN -np 3 $VALGRIND ./bin/balance.exe scratch/box3.vtu
   $MPIRUN -np 2 $VALGRIND ./bin/one_refine.exe scratch/split.pvtu scratch/one_ref.pvtu
   $MPIRUN -np 2 $VALGRIND ./bin/one_refine.exe scratch/one_ref.pvtu scratch/two_ref.pvtu
   $MPIRUN -np 2 $VALGRIND ./bin/one_coarsen.exe scratch/split.pvtu scratch/one_cor.pvtu
   $MPIRUN -np 2 $VALGRIND ./bin/one_coarsen.exe scratch/one_cor.pvtu scratch/two_cor.pvtu
+  $MPIRUN -np 2 $VALGRIND ./bin/adapt.exe scratch/split.pvtu scratch/adapt.pvtu scratch/adapt_trace.json
+  $MPIRUN -np 3 $VALGRIND ./bin/smooth.exe scratch/box.vtu scratch/smooth.pvtu
+  $MPIRUN -np 2 $VALGRIND ./bin/smooth.exe scratch/box3.vtu
+  $MPIRUN -np 2 $VALGRIND ./bin/derive_model.exe scratch/box.vtu
+  $MPIRUN -np 2 $VALGRIND ./bin/derive_model.exe scratch/box3.vtu 1
 fi
 $VALGRIND ./bin/identity.exe scratch/box.vtu scratch/identity.vtu
 $VALGRIND ./bin/vtkdiff.exe -superset scratch/box.vtu scratch/identity.vtu
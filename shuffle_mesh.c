@@ -66,18 +66,166 @@ static void shuffle_ents(
   shuffle_tags(m, m_out, ent_dim, old_to_new_ents);
 }
 
-void shuffle_mesh(struct mesh* m, unsigned const* old_to_new_verts)
+LOOP_KERNEL(remap_dual,
+    unsigned const* old_to_new_elems,
+    unsigned* elems_of_elems_out)
+  if (elems_of_elems_out[i] != INVALID)
+    elems_of_elems_out[i] = old_to_new_elems[elems_of_elems_out[i]];
+}
+
+LOOP_KERNEL(shuffle_up_row,
+    unsigned const* old_to_new_lows,
+    unsigned const* old_to_new_highs,
+    unsigned const* offsets,
+    unsigned const* highs_of_lows,
+    unsigned const* directions,
+    unsigned const* offsets_out,
+    unsigned* highs_of_lows_out,
+    unsigned* directions_out)
+  unsigned f = offsets[i];
+  unsigned e = offsets[i + 1];
+  unsigned o = offsets_out[old_to_new_lows[i]];
+  /* keep the rows sorted, the way up_from_down makes them */
+  for (unsigned j = f; j < e; ++j) {
+    unsigned h = old_to_new_highs[highs_of_lows[j]];
+    unsigned d = directions[j];
+    unsigned k = o + (j - f);
+    for (; k > o && highs_of_lows_out[k - 1] > h; --k) {
+      highs_of_lows_out[k] = highs_of_lows_out[k - 1];
+      directions_out[k] = directions_out[k - 1];
+    }
+    highs_of_lows_out[k] = h;
+    directions_out[k] = d;
+  }
+}
+
+/* adjacencies that were already derived are renumbered
+   along with the entities instead of being derived again
+   by the next user. stars are left to be rebuilt. */
+
+static void shuffle_down(struct mesh* m, struct mesh* m_out,
+    unsigned high_dim, unsigned low_dim,
+    unsigned const* const* old_to_new_ents)
 {
+  unsigned const* lows_of_highs = mesh_find_down(m, high_dim, low_dim);
+  if (!lows_of_highs)
+    return;
+  unsigned nhighs = mesh_count(m, high_dim);
+  unsigned lows_per_high = the_down_degrees[high_dim][low_dim];
+  unsigned* lows_of_highs_out = uints_shuffle(nhighs, lows_of_highs,
+      lows_per_high, old_to_new_ents[high_dim]);
+  LOOP_EXEC(remap_conn, nhighs * lows_per_high, old_to_new_ents[low_dim],
+      lows_of_highs_out);
+  mesh_set_down(m_out, high_dim, low_dim, lows_of_highs_out);
+}
+
+static void shuffle_up(struct mesh* m, struct mesh* m_out,
+    unsigned low_dim, unsigned high_dim,
+    unsigned const* const* old_to_new_ents)
+{
+  struct const_up* up = mesh_find_up(m, low_dim, high_dim);
+  if (!up)
+    return;
+  unsigned nlows = mesh_count(m, low_dim);
+  unsigned* degrees = uints_unscan(up->offsets, nlows);
+  unsigned* degrees_out = uints_shuffle(nlows, degrees, 1,
+      old_to_new_ents[low_dim]);
+  loop_free(degrees);
+  unsigned* offsets_out = uints_exscan(degrees_out, nlows);
+  loop_free(degrees_out);
+  unsigned nuses = uints_at(offsets_out, nlows);
+  unsigned* highs_of_lows_out = LOOP_MALLOC(unsigned, nuses);
+  unsigned* directions_out = LOOP_MALLOC(unsigned, nuses);
+  LOOP_EXEC(shuffle_up_row, nlows,
+      old_to_new_ents[low_dim], old_to_new_ents[high_dim],
+      up->offsets, up->adj, up->directions,
+      offsets_out, highs_of_lows_out, directions_out);
+  mesh_set_up(m_out, low_dim, high_dim,
+      offsets_out, highs_of_lows_out, directions_out);
+}
+
+static void shuffle_dual(struct mesh* m, struct mesh* m_out,
+    unsigned const* old_to_new_elems)
+{
+  unsigned const* elems_of_elems = mesh_find_dual(m);
+  if (!elems_of_elems)
+    return;
   unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  unsigned sides_per_elem = the_down_degrees[dim][dim - 1];
+  unsigned* elems_of_elems_out = uints_shuffle(nelems, elems_of_elems,
+      sides_per_elem, old_to_new_elems);
+  LOOP_EXEC(remap_dual, nelems * sides_per_elem, old_to_new_elems,
+      elems_of_elems_out);
+  mesh_set_dual(m_out, elems_of_elems_out);
+}
+
+static void shuffle_adjacencies(struct mesh* m, struct mesh* m_out,
+    unsigned const* const* old_to_new_ents)
+{
+  enum mem_category cat = loop_host_set_category(MEM_ADJACENCY);
+  unsigned dim = mesh_dim(m);
+  for (unsigned high_dim = 1; high_dim <= dim; ++high_dim)
+    for (unsigned low_dim = 0; low_dim < high_dim; ++low_dim) {
+      if (!old_to_new_ents[high_dim] || !old_to_new_ents[low_dim])
+        continue;
+      if (low_dim)
+        shuffle_down(m, m_out, high_dim, low_dim, old_to_new_ents);
+      shuffle_up(m, m_out, low_dim, high_dim, old_to_new_ents);
+    }
+  if (dim && old_to_new_ents[dim])
+    shuffle_dual(m, m_out, old_to_new_ents[dim]);
+  loop_host_set_category(cat);
+}
+
+void shuffle_mesh_ents(struct mesh* m, unsigned const* const* old_to_new_ents)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned const* old_to_new_verts = old_to_new_ents[0];
   struct mesh* m_out = new_mesh(dim, mesh_get_rep(m), mesh_is_parallel(m));
+  unsigned const* numbers[4] = {old_to_new_verts, 0, 0, 0};
+  unsigned* made[4] = {0};
   mesh_set_ents(m_out, 0, mesh_count(m, 0), 0);
   shuffle_tags(m, m_out, 0, old_to_new_verts);
   for (unsigned d = 1; d <= dim; ++d) {
     if (!mesh_has_dim(m, d))
       continue;
-    unsigned* old_to_new_ents = number_ents(m, d, old_to_new_verts);
-    shuffle_ents(m, m_out, d, old_to_new_ents, old_to_new_verts);
-    loop_free(old_to_new_ents);
+    numbers[d] = old_to_new_ents[d];
+    if (!numbers[d])
+      numbers[d] = made[d] = number_ents(m, d, old_to_new_verts);
+    shuffle_ents(m, m_out, d, numbers[d], old_to_new_verts);
   }
+  shuffle_adjacencies(m, m_out, numbers);
+  for (unsigned d = 1; d <= dim; ++d)
+    loop_free(made[d]);
   overwrite_mesh(m, m_out);
 }
+
+void shuffle_mesh(struct mesh* m, unsigned const* old_to_new_verts)
+{
+  unsigned const* old_to_new_ents[4] = {old_to_new_verts, 0, 0, 0};
+  shuffle_mesh_ents(m, old_to_new_ents);
+}
+
+void reorder_mesh(struct mesh* m, enum reorder_mode mode)
+{
+  unsigned* old_to_new_ents[4] = {0};
+  switch (mode) {
+    case REORDER_BFS:
+      old_to_new_ents[0] = compute_ordering(m);
+      break;
+    case REORDER_HILBERT:
+      old_to_new_ents[0] = compute_hilbert_ordering(m, 0);
+      old_to_new_ents[mesh_dim(m)] = compute_hilbert_ordering(m, mesh_dim(m));
+      break;
+    case REORDER_SORTED:
+      old_to_new_ents[0] = compute_hilbert_ordering(m, 0);
+      for (unsigned d = 1; d <= mesh_dim(m); ++d)
+        if (mesh_has_dim(m, d))
+          old_to_new_ents[d] = sort_ents_by_verts(m, d, old_to_new_ents[0]);
+      break;
+  }
+  shuffle_mesh_ents(m, (unsigned const* const*) old_to_new_ents);
+  for (unsigned d = 0; d < 4; ++d)
+    loop_free(old_to_new_ents[d]);
+}
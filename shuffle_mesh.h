@@ -5,4 +5,27 @@ struct mesh;
 
 void shuffle_mesh(struct mesh* m, unsigned const* old_to_new_verts);
 
+/* like shuffle_mesh, but the entities of dimension (d)
+   take the order (old_to_new_ents[d]) when it is given
+   instead of the one that follows their vertices.
+   (old_to_new_ents[0]) is always required.
+   tags and the adjacencies derived so far are carried over. */
+void shuffle_mesh_ents(struct mesh* m,
+    unsigned const* const* old_to_new_ents);
+
+/* REORDER_BFS: vertices by breadth-first layers from the
+   deepest interior vertex (serial, host side).
+   REORDER_HILBERT: vertices and elements along a Hilbert
+   curve through their coordinates and centroids.
+   REORDER_SORTED: vertices along the Hilbert curve and
+   every other dimension sorted by the new numbers of its
+   vertices, so all dimensions follow one order. */
+enum reorder_mode {
+  REORDER_BFS,
+  REORDER_HILBERT,
+  REORDER_SORTED
+};
+
+void reorder_mesh(struct mesh* m, enum reorder_mode mode);
+
 #endif
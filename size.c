@@ -1,6 +1,8 @@
 #include "size.h"
 
+#include "adapt_region.h"
 #include "algebra.h"
+#include "arrays.h"
 #include "comm.h"
 #include "doubles.h"
 #include "loop.h"
@@ -53,17 +55,19 @@ double* mesh_element_sizes(struct mesh* m)
 }
 
 LOOP_KERNEL(measure_edge,
+    unsigned const* edges,
     unsigned const* verts_of_edges,
     double const* coords,
     double const* size,
     double* out)
-  unsigned const* edge_vert = verts_of_edges + i * 2;
+  unsigned edge = edges ? edges[i] : i;
+  unsigned const* edge_vert = verts_of_edges + edge * 2;
   double edge_coord[2][3];
   copy_vector(coords + edge_vert[0] * 3, edge_coord[0], 3);
   copy_vector(coords + edge_vert[1] * 3, edge_coord[1], 3);
   double length = edge_length(edge_coord);
   double desired_length = (size[edge_vert[0]] + size[edge_vert[1]]) / 2;
-  out[i] = length / desired_length;
+  out[edge] = length / desired_length;
 }
 
 static double* measure_edges(
@@ -74,15 +78,28 @@ static double* measure_edges(
 {
   double* out = LOOP_MALLOC(double, nedges);
   LOOP_EXEC(measure_edge, nedges,
-      verts_of_edges, coords, size, out);
+      0, verts_of_edges, coords, size, out);
   return out;
 }
 
+/* edges outside the adapt region measure exactly 1,
+   so they are neither refined nor coarsened */
+
 double* mesh_measure_edges_for_adapt(struct mesh* m)
 {
-  return measure_edges(mesh_count(m, 1), mesh_ask_down(m, 1, 0),
-      mesh_find_tag(m, 0, "coordinates")->d.f64,
-      mesh_find_tag(m, 0, "adapt_size")->d.f64);
+  unsigned nedges = mesh_count(m, 1);
+  unsigned const* verts_of_edges = mesh_ask_down(m, 1, 0);
+  double const* coords = mesh_find_tag(m, 0, "coordinates")->d.f64;
+  double const* size = mesh_find_tag(m, 0, "adapt_size")->d.f64;
+  unsigned nactive;
+  unsigned* active = mesh_list_region(m, 1, &nactive);
+  if (!active)
+    return measure_edges(nedges, verts_of_edges, coords, size);
+  double* out = doubles_filled(nedges, 1.0);
+  LOOP_EXEC(measure_edge, nactive,
+      active, verts_of_edges, coords, size, out);
+  loop_free(active);
+  return out;
 }
 
 LOOP_KERNEL(vert_identity_size,
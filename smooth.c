@@ -1,18 +1,29 @@
 #include "smooth.h"
 
 #include "algebra.h"
+#include "arrays.h"
+#include "comm.h"
+#include "doubles.h"
+#include "ghost_mesh.h"
+#include "graph.h"
 #include "loop.h"
 #include "mark.h"
 #include "mesh.h"
 #include "parallel_mesh.h"
+#include "tables.h"
+#include "tag.h"
 
 LOOP_KERNEL(smooth_field_vert,
     unsigned ncomps,
+    unsigned const* phases,
+    unsigned phase,
     unsigned const* interior,
     unsigned const* star_offsets,
     unsigned const* star,
     double const* data_in,
     double* data_out)
+  if (phases[i] != phase)
+    return;
   if (!interior[i]) {
     copy_vector(data_in + i * ncomps, data_out + i * ncomps, ncomps);
     return;
@@ -31,26 +42,54 @@ LOOP_KERNEL(smooth_field_vert,
       data_out + i * ncomps, ncomps);
 }
 
-static void smooth_field_iter(
-    unsigned n,
+LOOP_KERNEL(vert_change,
+    unsigned ncomps,
+    double const* data_in,
+    double const* data_out,
+    double* change)
+  change[i] = 0;
+  for (unsigned j = 0; j < ncomps; ++j) {
+    double d = fabs(data_out[i * ncomps + j] - data_in[i * ncomps + j]);
+    if (d > change[i])
+      change[i] = d;
+  }
+}
+
+/* the vertices other ranks have copies of are smoothed
+   first, and the rest while their values are sent.
+   returns the largest change of any value */
+
+static double smooth_field_iter(
+    struct mesh* m,
     unsigned ncomps,
+    unsigned const* phases,
     unsigned const* interior,
     unsigned const* star_offsets,
     unsigned const* star,
     double** p_data)
 {
+  unsigned n = mesh_count(m, 0);
   double* data_in = *p_data;
   double* data_out = LOOP_MALLOC(double, n * ncomps);
-  LOOP_EXEC(smooth_field_vert, n, ncomps, interior, star_offsets, star,
-      data_in, data_out);
+  LOOP_EXEC(smooth_field_vert, n, ncomps, phases, CONFORM_SHARED,
+      interior, star_offsets, star, data_in, data_out);
+  struct exchange* x = mesh_conform_doubles_begin(m, 0, ncomps, data_out);
+  LOOP_EXEC(smooth_field_vert, n, ncomps, phases, CONFORM_INTERIOR,
+      interior, star_offsets, star, data_in, data_out);
+  mesh_conform_doubles_end(m, 0, ncomps, x, data_out);
+  double* change = LOOP_MALLOC(double, n);
+  LOOP_EXEC(vert_change, n, ncomps, data_in, data_out, change);
+  double max_change = comm_max_double(doubles_max(change, n));
+  loop_free(change);
   loop_free(data_in);
   *p_data = data_out;
+  return max_change;
 }
 
 unsigned mesh_smooth_field(struct mesh* m, char const* name,
     double tol, unsigned maxiter)
 {
-  if (mesh_is_paralle(m))
+  if (mesh_is_parallel(m))
     mesh_ensure_ghosting(m, 1);
   unsigned n = mesh_count(m, 0);
   struct const_tag* t = mesh_find_tag(m, 0, name);
@@ -60,11 +99,17 @@ unsigned mesh_smooth_field(struct mesh* m, char const* name,
   unsigned const* star_offsets = mesh_ask_star(m, 0, 1)->offsets;
   unsigned const* star = mesh_ask_star(m, 0, 1)->adj;
   unsigned* interior = mesh_mark_class(m, 0, mesh_dim(m), INVALID);
-  unsigned i;
-  for (i = 0; i < maxiter; ++i) {
-    smooth_field_iter(n, ncomps, interior, star_offsets, star, &data);
-    mesh_conform_doubles(m, 0, ncomps, &data);
+  unsigned* phases = mesh_conform_phases(m, 0);
+  unsigned niters = 0;
+  while (niters < maxiter) {
+    double change = smooth_field_iter(m, ncomps, phases, interior,
+        star_offsets, star, &data);
+    ++niters;
+    if (change <= tol)
+      break;
   }
+  loop_free(interior);
+  loop_free(phases);
   mesh_add_tag(m, 0, TAG_F64, name, ncomps, data);
-  return i;
+  return niters;
 }
@@ -3,6 +3,9 @@
 
 struct mesh;
 
+/* averages each interior vertex value over its neighbors until
+   no value changes by more than (tol), or (maxiter) times,
+   and returns the number of iterations */
 unsigned mesh_smooth_field(struct mesh* m, char const* name,
     double tol, unsigned maxiter);
 
@@ -0,0 +1,198 @@
+#include "sort.h"
+
+#include "arrays.h"
+#include "ints.h"
+#include "loop.h"
+
+unsigned count_bits(unsigned long x)
+{
+  unsigned b = 0;
+  while (b < 64 && (x >> b))
+    ++b;
+  return b;
+}
+
+#ifdef LOOP_CUDA_H
+
+#include <thrust/device_ptr.h>
+#include <thrust/sort.h>
+
+unsigned* sort_ulongs(unsigned n, unsigned long const* keys)
+{
+  unsigned long* sorted_keys = ulongs_copy(keys, n);
+  unsigned* order = uints_linear(n, 1);
+  thrust::stable_sort_by_key(
+      thrust::device_ptr<unsigned long>(sorted_keys),
+      thrust::device_ptr<unsigned long>(sorted_keys + n),
+      thrust::device_ptr<unsigned>(order));
+  loop_free(sorted_keys);
+  return order;
+}
+
+unsigned* sort_uints_by_bits(unsigned n, unsigned const* keys,
+    unsigned key_bits, unsigned** p_sorted_keys)
+{
+  (void) key_bits;
+  unsigned* sorted_keys = uints_copy(keys, n);
+  unsigned* order = uints_linear(n, 1);
+  thrust::stable_sort_by_key(
+      thrust::device_ptr<unsigned>(sorted_keys),
+      thrust::device_ptr<unsigned>(sorted_keys + n),
+      thrust::device_ptr<unsigned>(order));
+  *p_sorted_keys = sorted_keys;
+  return order;
+}
+
+#else
+
+/* a stable least-significant-digit radix sort carrying
+   the key indices along. each pass cuts the entries into
+   blocks, counts digits per block, scans the (digit, block)
+   table and lets each block scatter its entries in order,
+   so there are no atomics and the result is deterministic.
+   digits are as wide as the table size allows (about one
+   entry per input), so a few threads usually get away with
+   one counting sort pass per digit of key bits.
+   keys are either 32 or 64 bits wide, only one of the two
+   key arrays is given. */
+
+#define BLOCKS_PER_THREAD 4
+#define MIN_BLOCK 4096
+#define MIN_DIGIT_BITS 8
+#define MAX_DIGIT_BITS 20
+
+LOOP_INOUT static inline unsigned
+get_digit(unsigned const* keys32, unsigned long const* keys64,
+    unsigned j, unsigned shift, unsigned mask)
+{
+  unsigned long key = keys64 ? keys64[j] : keys32[j];
+  return (unsigned) (key >> shift) & mask;
+}
+
+LOOP_KERNEL(count_digits,
+    unsigned n,
+    unsigned block_size,
+    unsigned nblocks,
+    unsigned shift,
+    unsigned mask,
+    unsigned const* keys32,
+    unsigned long const* keys64,
+    unsigned* counts)
+  unsigned first = i * block_size;
+  unsigned end = first + block_size;
+  if (end > n)
+    end = n;
+  for (unsigned j = first; j < end; ++j)
+    ++counts[get_digit(keys32, keys64, j, shift, mask) * nblocks + i];
+}
+
+LOOP_KERNEL(scatter_digits,
+    unsigned n,
+    unsigned block_size,
+    unsigned nblocks,
+    unsigned shift,
+    unsigned mask,
+    unsigned const* keys32,
+    unsigned long const* keys64,
+    unsigned const* vals,
+    unsigned* cursors,
+    unsigned* keys32_out,
+    unsigned long* keys64_out,
+    unsigned* vals_out)
+  unsigned first = i * block_size;
+  unsigned end = first + block_size;
+  if (end > n)
+    end = n;
+  for (unsigned j = first; j < end; ++j) {
+    unsigned digit = get_digit(keys32, keys64, j, shift, mask);
+    unsigned k = cursors[digit * nblocks + i]++;
+    if (keys64)
+      keys64_out[k] = keys64[j];
+    else
+      keys32_out[k] = keys32[j];
+    vals_out[k] = vals ? vals[j] : j;
+  }
+}
+
+/* sorts on the lowest (key_bits) bits and returns the order.
+   the sorted keys are handed back through (p_sorted32) or
+   (p_sorted64) when given, and are null when no pass ran
+   (all keys zero), in which case the input is already sorted */
+
+static unsigned* radix_sort(unsigned n,
+    unsigned const* keys32, unsigned long const* keys64,
+    unsigned key_bits,
+    unsigned** p_sorted32, unsigned long** p_sorted64)
+{
+  unsigned nblocks = loop_size() * BLOCKS_PER_THREAD;
+  unsigned max_blocks = (n + MIN_BLOCK - 1) / MIN_BLOCK;
+  if (nblocks > max_blocks)
+    nblocks = max_blocks;
+  if (nblocks == 0)
+    nblocks = 1;
+  unsigned block_size = (n + nblocks - 1) / nblocks;
+  unsigned digit_bits = count_bits(n / nblocks);
+  if (digit_bits < MIN_DIGIT_BITS)
+    digit_bits = MIN_DIGIT_BITS;
+  if (digit_bits > MAX_DIGIT_BITS)
+    digit_bits = MAX_DIGIT_BITS;
+  /* spread the key bits evenly over the passes */
+  unsigned npasses = (key_bits + digit_bits - 1) / digit_bits;
+  if (npasses)
+    digit_bits = (key_bits + npasses - 1) / npasses;
+  unsigned ndigits = 1u << digit_bits;
+  unsigned* keys32_owned = 0;
+  unsigned long* keys64_owned = 0;
+  unsigned* vals = 0;
+  for (unsigned pass = 0; pass < npasses; ++pass) {
+    unsigned shift = pass * digit_bits;
+    unsigned* counts = uints_filled(ndigits * nblocks, 0);
+    LOOP_EXEC(count_digits, nblocks, n, block_size, nblocks,
+        shift, ndigits - 1, keys32, keys64, counts);
+    unsigned* cursors = uints_exscan(counts, ndigits * nblocks);
+    loop_free(counts);
+    unsigned* keys32_out = keys64 ? 0 : LOOP_MALLOC(unsigned, n);
+    unsigned long* keys64_out = keys64 ? LOOP_MALLOC(unsigned long, n) : 0;
+    unsigned* vals_out = LOOP_MALLOC(unsigned, n);
+    LOOP_EXEC(scatter_digits, nblocks, n, block_size, nblocks,
+        shift, ndigits - 1, keys32, keys64, vals, cursors,
+        keys32_out, keys64_out, vals_out);
+    loop_free(cursors);
+    loop_free(keys32_owned);
+    loop_free(keys64_owned);
+    loop_free(vals);
+    keys32 = keys32_owned = keys32_out;
+    keys64 = keys64_owned = keys64_out;
+    vals = vals_out;
+  }
+  if (p_sorted32)
+    *p_sorted32 = keys32_owned;
+  else
+    loop_free(keys32_owned);
+  if (p_sorted64)
+    *p_sorted64 = keys64_owned;
+  else
+    loop_free(keys64_owned);
+  if (!vals)
+    vals = uints_linear(n, 1);
+  return vals;
+}
+
+unsigned* sort_ulongs(unsigned n, unsigned long const* keys)
+{
+  unsigned key_bits = count_bits(n ? ulongs_max(keys, n) : 0);
+  return radix_sort(n, 0, keys, key_bits, 0, 0);
+}
+
+unsigned* sort_uints_by_bits(unsigned n, unsigned const* keys,
+    unsigned key_bits, unsigned** p_sorted_keys)
+{
+  unsigned* sorted_keys;
+  unsigned* order = radix_sort(n, keys, 0, key_bits, &sorted_keys, 0);
+  if (!sorted_keys)
+    sorted_keys = uints_copy(keys, n);
+  *p_sorted_keys = sorted_keys;
+  return order;
+}
+
+#endif
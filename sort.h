@@ -0,0 +1,20 @@
+#ifndef SORT_H
+#define SORT_H
+
+/* the number of bits needed to write (x), zero for zero */
+
+unsigned count_bits(unsigned long x);
+
+/* sorts the (n) keys and returns the order as an array
+   whose entry (i) is the index of the i'th smallest key.
+   the sort is stable, so equal keys keep their order */
+
+unsigned* sort_ulongs(unsigned n, unsigned long const* keys);
+
+/* the same for keys below 2^(key_bits), which also
+   hands back the sorted keys */
+
+unsigned* sort_uints_by_bits(unsigned n, unsigned const* keys,
+    unsigned key_bits, unsigned** p_sorted_keys);
+
+#endif
@@ -290,24 +290,152 @@ static void get_edge_tet_star(
   *p_star = star;
 }
 
-void mesh_get_star(
+unsigned mesh_star_method(
     struct mesh* m,
     unsigned low_dim,
-    unsigned high_dim,
-    unsigned** p_star_offsets,
-    unsigned** p_star)
+    unsigned high_dim)
 {
   if (low_dim == 0 &&
       high_dim == mesh_dim(m) &&
       mesh_dim(m) != 1 &&
       mesh_has_dim(m, 1))
-    mesh_get_star(m, low_dim, 1, p_star_offsets, p_star);
-  else if (low_dim == 0 && high_dim == 1)
-    get_vertex_edge_star(m, p_star_offsets, p_star);
-  else if (low_dim == 1 && high_dim == 2)
-    get_edge_triangle_star(m, p_star_offsets, p_star);
-  else if (low_dim == 1 && high_dim == 3 && mesh_has_dim(m, 2))
-    get_edge_tet_star(m, p_star_offsets, p_star);
-  else
-    mesh_get_star_general(m, low_dim, high_dim, p_star_offsets, p_star);
+    return STAR_VERTEX_EDGE;
+  if (low_dim == 0 && high_dim == 1)
+    return STAR_VERTEX_EDGE;
+  if (low_dim == 1 && high_dim == 2)
+    return STAR_EDGE_TRIANGLE;
+  if (low_dim == 1 && high_dim == 3 && mesh_has_dim(m, 2))
+    return STAR_EDGE_TET;
+  return STAR_GENERAL;
+}
+
+void mesh_get_star(
+    struct mesh* m,
+    unsigned low_dim,
+    unsigned high_dim,
+    unsigned** p_star_offsets,
+    unsigned** p_star)
+{
+  switch (mesh_star_method(m, low_dim, high_dim)) {
+    case STAR_VERTEX_EDGE:
+      get_vertex_edge_star(m, p_star_offsets, p_star);
+      break;
+    case STAR_EDGE_TRIANGLE:
+      get_edge_triangle_star(m, p_star_offsets, p_star);
+      break;
+    case STAR_EDGE_TET:
+      get_edge_tet_star(m, p_star_offsets, p_star);
+      break;
+    default:
+      mesh_get_star_general(m, low_dim, high_dim, p_star_offsets, p_star);
+  }
+}
+
+/* the same rows, one low at a time, for when only a few
+   lows need their stars. each method lists the neighbors
+   in the same order as its whole-mesh version above. */
+
+struct star_rows {
+  unsigned method;
+  unsigned lows_per_high;
+  /* the up and down adjacency the method walks:
+     for the edge-tet method, (a) is edge-triangle
+     and (b) is edge-tet */
+  unsigned const* a_offsets;
+  unsigned const* a_adj;
+  unsigned const* a_directions;
+  unsigned const* a_down;
+  unsigned const* b_offsets;
+  unsigned const* b_adj;
+  unsigned const* b_directions;
+  unsigned const* b_down;
+};
+
+LOOP_INOUT static unsigned get_star_row(
+    struct star_rows r,
+    unsigned low,
+    unsigned* star)
+{
+  unsigned f = r.a_offsets[low];
+  unsigned e = r.a_offsets[low + 1];
+  unsigned o = 0;
+  switch (r.method) {
+    case STAR_VERTEX_EDGE:
+      for (unsigned j = f; j < e; ++j)
+        star[o++] = r.a_down[r.a_adj[j] * 2 + (1 - r.a_directions[j])];
+      return o;
+    case STAR_EDGE_TRIANGLE:
+    case STAR_EDGE_TET:
+      for (unsigned j = f; j < e; ++j) {
+        unsigned tri = r.a_adj[j];
+        unsigned dir = r.a_directions[j];
+        star[o++] = r.a_down[tri * 3 + ((dir + 1) % 3)];
+        star[o++] = r.a_down[tri * 3 + ((dir + 2) % 3)];
+      }
+      if (r.method == STAR_EDGE_TET) {
+        unsigned const* tet_edge_opp_edges = the_opposite_orders[3][1];
+        for (unsigned j = r.b_offsets[low]; j < r.b_offsets[low + 1]; ++j)
+          star[o++] = r.b_down[r.b_adj[j] * 6 +
+            tet_edge_opp_edges[r.b_directions[j]]];
+      }
+      return o;
+  }
+  return get_ent_star_general(r.a_offsets, r.a_adj, r.a_down,
+      r.lows_per_high, low, star);
+}
+
+LOOP_KERNEL(count_star_rows,
+    struct star_rows r,
+    unsigned const* rows,
+    unsigned* degrees)
+  unsigned star_buf[MAX_UP * MAX_DOWN];
+  degrees[i] = get_star_row(r, rows[i], star_buf);
+}
+
+LOOP_KERNEL(fill_star_rows,
+    struct star_rows r,
+    unsigned const* rows,
+    unsigned const* offsets,
+    unsigned* star)
+  get_star_row(r, rows[i], star + offsets[i]);
+}
+
+void mesh_get_star_rows(
+    struct mesh* m,
+    unsigned low_dim,
+    unsigned high_dim,
+    unsigned nrows,
+    unsigned const* rows,
+    unsigned** p_row_offsets,
+    unsigned** p_star)
+{
+  struct star_rows r;
+  r.method = mesh_star_method(m, low_dim, high_dim);
+  unsigned a_high_dim = high_dim;
+  if (r.method == STAR_VERTEX_EDGE)
+    a_high_dim = 1;
+  if (r.method == STAR_EDGE_TRIANGLE || r.method == STAR_EDGE_TET)
+    a_high_dim = 2;
+  r.lows_per_high = the_down_degrees[a_high_dim][low_dim];
+  struct const_up* a = mesh_ask_up(m, low_dim, a_high_dim);
+  r.a_offsets = a->offsets;
+  r.a_adj = a->adj;
+  r.a_directions = a->directions;
+  r.a_down = mesh_ask_down(m, a_high_dim, low_dim);
+  r.b_offsets = r.b_adj = r.b_directions = r.b_down = 0;
+  if (r.method == STAR_EDGE_TET) {
+    struct const_up* b = mesh_ask_up(m, 1, 3);
+    r.b_offsets = b->offsets;
+    r.b_adj = b->adj;
+    r.b_directions = b->directions;
+    r.b_down = mesh_ask_down(m, 3, 1);
+  }
+  unsigned* degrees = LOOP_MALLOC(unsigned, nrows);
+  LOOP_EXEC(count_star_rows, nrows, r, rows, degrees);
+  unsigned* row_offsets = uints_exscan(degrees, nrows);
+  loop_free(degrees);
+  unsigned* star = LOOP_MALLOC(unsigned, uints_at(row_offsets, nrows));
+  LOOP_EXEC(fill_star_rows, nrows, r, rows, row_offsets, star);
+  *p_row_offsets = row_offsets;
+  *p_star = star;
 }
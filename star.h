@@ -22,4 +22,32 @@ void mesh_get_star(
     unsigned** p_star_offsets,
     unsigned** p_star);
 
+/* stars are built differently depending on the dimensions
+   and on which entities the mesh has, which decides the
+   order neighbors are listed in */
+
+enum {
+  STAR_VERTEX_EDGE,
+  STAR_EDGE_TRIANGLE,
+  STAR_EDGE_TET,
+  STAR_GENERAL
+};
+
+unsigned mesh_star_method(
+    struct mesh* m,
+    unsigned low_dim,
+    unsigned high_dim);
+
+/* the stars of only the (nrows) lows listed in (rows),
+   the same as their rows in mesh_get_star */
+
+void mesh_get_star_rows(
+    struct mesh* m,
+    unsigned low_dim,
+    unsigned high_dim,
+    unsigned nrows,
+    unsigned const* rows,
+    unsigned** p_row_offsets,
+    unsigned** p_star);
+
 #endif
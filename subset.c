@@ -10,12 +10,17 @@
 #include "parallel_mesh.h"
 #include "tables.h"
 
-void tags_subset(struct mesh* in, struct mesh* out,
-    unsigned dim, unsigned const* offsets)
+static void subset_tags(struct mesh* in, struct mesh* out,
+    unsigned dim, unsigned const* offsets, unsigned may_share)
 {
   unsigned nents = mesh_count(in, dim);
+  unsigned keeps_all = may_share && (uints_at(offsets, nents) == nents);
   for (unsigned i = 0; i < mesh_count_tags(in, dim); ++i) {
     struct const_tag* t = mesh_get_tag(in, dim, i);
+    if (keeps_all) {
+      share_tag(mesh_tags(out, dim), t, OSH_TRANSFER_NOT);
+      continue;
+    }
     void* vals_out = 0;
     switch (t->type) {
       case TAG_U8:
@@ -43,12 +48,25 @@ void tags_subset(struct mesh* in, struct mesh* out,
   }
 }
 
+void tags_subset(struct mesh* in, struct mesh* out,
+    unsigned dim, unsigned const* offsets)
+{
+  subset_tags(in, out, dim, offsets, 0);
+}
+
+void adopt_tags_subset(struct mesh* in, struct mesh* out,
+    unsigned dim, unsigned const* offsets)
+{
+  subset_tags(in, out, dim, offsets, 1);
+}
+
 static void subset_ents(
     struct mesh* m,
     struct mesh* m_out,
     unsigned ent_dim,
     unsigned const* ent_offsets,
-    unsigned const* vert_offsets)
+    unsigned const* vert_offsets,
+    unsigned may_share)
 {
   unsigned nents = mesh_count(m, ent_dim);
   unsigned nents_out = uints_at(ent_offsets, nents);
@@ -59,13 +77,14 @@ static void subset_ents(
   for (unsigned i = 0; i < nents_out * verts_per_ent; ++i)
     verts_of_ents_out[i] = vert_offsets[verts_of_ents_out[i]];
   mesh_set_ents(m_out, ent_dim, nents_out, verts_of_ents_out);
-  tags_subset(m, m_out, ent_dim, ent_offsets);
+  subset_tags(m, m_out, ent_dim, ent_offsets, may_share);
 }
 
-struct mesh* subset_mesh(
+static struct mesh* make_subset(
     struct mesh* m,
     unsigned elem_dim,
-    unsigned const* offsets)
+    unsigned const* offsets,
+    unsigned may_share)
 {
   unsigned nelems = mesh_count(m, elem_dim);
   unsigned* marked_elems = uints_unscan(offsets, nelems);
@@ -85,15 +104,31 @@ struct mesh* subset_mesh(
   unsigned nverts_out = uints_at(ent_offsets[0], nverts);
   struct mesh* m_out = new_mesh(elem_dim, mesh_get_rep(m), mesh_is_parallel(m));
   mesh_set_ents(m_out, 0, nverts_out, 0);
-  tags_subset(m, m_out, 0, ent_offsets[0]);
+  subset_tags(m, m_out, 0, ent_offsets[0], may_share);
   for (unsigned d = 1; d <= elem_dim; ++d)
     if (mesh_has_dim(m, d))
-      subset_ents(m, m_out, d, ent_offsets[d], ent_offsets[0]);
+      subset_ents(m, m_out, d, ent_offsets[d], ent_offsets[0], may_share);
   for (unsigned d = 0; d < elem_dim; ++d)
     loop_free(to_free[d]);
   return m_out;
 }
 
+struct mesh* subset_mesh(
+    struct mesh* m,
+    unsigned elem_dim,
+    unsigned const* offsets)
+{
+  return make_subset(m, elem_dim, offsets, 0);
+}
+
+void overwrite_with_subset(
+    struct mesh* m,
+    unsigned elem_dim,
+    unsigned const* offsets)
+{
+  overwrite_mesh(m, make_subset(m, elem_dim, offsets, 1));
+}
+
 void subset_verts_of_doms(
     struct mesh* m,
     unsigned dom_dim,
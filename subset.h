@@ -11,6 +11,18 @@ struct mesh* subset_mesh(
     unsigned elem_dim,
     unsigned const* offsets);
 
+/* these are for when (in) is about to be overwritten by (out):
+   a dimension kept whole adopts the tag arrays of (in) instead
+   of copying them, see share_tag */
+
+void adopt_tags_subset(struct mesh* in, struct mesh* out,
+    unsigned dim, unsigned const* offsets);
+
+void overwrite_with_subset(
+    struct mesh* m,
+    unsigned elem_dim,
+    unsigned const* offsets);
+
 void subset_verts_of_doms(
     struct mesh* m,
     unsigned dom_dim,
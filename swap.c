@@ -3,7 +3,9 @@
 #include <assert.h>
 #include <stdio.h>
 
+#include "adapt_region.h"
 #include "arrays.h"
+#include "carry_topology.h"
 #include "comm.h"
 #include "doubles.h"
 #include "ghost_mesh.h"
@@ -21,13 +23,15 @@
 #include "swap_qualities.h"
 #include "swap_topology.h"
 #include "tables.h"
+#include "trace.h"
 
 static void swap_ents(
     struct mesh* m,
     struct mesh* m_out,
     unsigned ent_dim,
     unsigned const* indset,
-    unsigned const* ring_sizes)
+    unsigned const* ring_sizes,
+    unsigned** p_same_ent_offsets)
 {
   unsigned nedges = mesh_count(m, 1);
   unsigned* gen_offset_of_edges = get_swap_topology_offsets(
@@ -63,15 +67,14 @@ static void swap_ents(
     swap_fit(m, m_out, gen_offset_of_edges, same_ent_offsets);
   }
   loop_free(gen_offset_of_edges);
-  loop_free(same_ent_offsets);
+  *p_same_ent_offsets = same_ent_offsets;
 }
 
 static void swap_interior(
     struct mesh* m)
 {
   unsigned const* indset = mesh_find_tag(m, 1, "indset")->d.u32;
-  unsigned nedges = mesh_count(m, 1);
-  unsigned long total = comm_add_ulong(uints_sum(indset, nedges));
+  unsigned long total = indset_size();
   unsigned const* ring_sizes = mesh_find_tag(m, 1, "ring_size")->d.u32;
   unsigned elem_dim = mesh_dim(m);
   /* vertex handling */
@@ -80,28 +83,35 @@ static void swap_interior(
   mesh_set_ents(m_out, 0, nverts, 0);
   if (mesh_is_parallel(m))
     mesh_tag_globals(m, 0);
-  copy_tags(mesh_tags(m, 0), mesh_tags(m_out, 0), nverts);
+  share_tags(mesh_tags(m, 0), mesh_tags(m_out, 0));
   if (mesh_is_parallel(m))
     mesh_parallel_from_tags(m_out, 0);
   /* end vertex handling */
+  unsigned* same_ent_offsets[4] = {0};
   if (mesh_get_rep(m) == MESH_REDUCED)
-    swap_ents(m, m_out, mesh_dim(m), indset, ring_sizes);
+    swap_ents(m, m_out, mesh_dim(m), indset, ring_sizes,
+        &same_ent_offsets[elem_dim]);
   else
     for (unsigned d = 1; d <= mesh_dim(m); ++d)
-      swap_ents(m, m_out, d, indset, ring_sizes);
-  printf("swapped %10lu %s\n", total, get_ent_name(1, total));
+      swap_ents(m, m_out, d, indset, ring_sizes, &same_ent_offsets[d]);
+  same_ent_offsets[0] = uints_linear(nverts + 1, 1);
+  carry_topology(m, m_out, same_ent_offsets);
+  mesh_grow_region(m, m_out, same_ent_offsets);
+  for (unsigned d = 0; d <= elem_dim; ++d)
+    loop_free(same_ent_offsets[d]);
+  if (comm_rank() == 0)
+    printf("swapped %10lu %s (independent set in %u iterations)\n",
+        total, get_ent_name(1, total), indset_iterations());
   overwrite_mesh(m, m_out);
 }
 
-static unsigned swap_common(
+static unsigned swap_pass(
     struct mesh* m,
     unsigned* candidates)
 {
   unsigned nedges = mesh_count(m, 1);
-  if (!comm_max_uint(uints_max(candidates, nedges))) {
-    loop_free(candidates);
-    return 0;
-  }
+  /* unmarking is local and only removes candidates,
+     so one global check covers both */
   mesh_unmark_boundary(m, 1, candidates);
   if (!comm_max_uint(uints_max(candidates, nedges))) {
     loop_free(candidates);
@@ -110,9 +120,13 @@ static unsigned swap_common(
   double* edge_quals;
   unsigned* ring_sizes;
   mesh_swap_qualities(m, candidates, &edge_quals, &ring_sizes);
-  mesh_conform_uints(m, 1, 1, &candidates);
-  mesh_conform_doubles(m, 1, 1, &edge_quals);
-  mesh_conform_uints(m, 1, 1, &ring_sizes);
+  void* conformed[3] = {candidates, edge_quals, ring_sizes};
+  unsigned const nbytes[3] = {sizeof(unsigned), sizeof(double),
+    sizeof(unsigned)};
+  mesh_conform_many(m, 1, 3, nbytes, conformed);
+  candidates = conformed[0];
+  edge_quals = conformed[1];
+  ring_sizes = conformed[2];
   if (!comm_max_uint(uints_max(candidates, nedges))) {
     loop_free(candidates);
     loop_free(edge_quals);
@@ -132,12 +146,27 @@ static unsigned swap_common(
   return 1;
 }
 
+/* the temporaries of a pass are charged to the adapt category */
+
+static unsigned swap_common(
+    struct mesh* m,
+    unsigned* candidates)
+{
+  loop_host_phase_begin("swap");
+  enum mem_category cat = loop_host_set_category(MEM_ADAPT);
+  unsigned ret = swap_pass(m, candidates);
+  loop_host_set_category(cat);
+  loop_host_phase_end();
+  return ret;
+}
+
 unsigned swap_slivers(
     struct mesh* m,
     double good_qual,
     unsigned nlayers)
 {
   assert(mesh_dim(m) == 3);
+  trace_begin("swap_slivers");
   if (mesh_is_parallel(m)) {
     assert(mesh_get_rep(m) == MESH_FULL);
     mesh_ensure_ghosting(m, 1);
@@ -146,6 +175,8 @@ unsigned swap_slivers(
   unsigned* slivers = mesh_mark_slivers(m, good_qual, nlayers);
   unsigned* candidates = mesh_mark_down(m, elem_dim, 1, slivers);
   loop_free(slivers);
+  mesh_mask_to_region(m, 1, candidates);
   unsigned ret = swap_common(m, candidates);
+  trace_end();
   return ret;
 }
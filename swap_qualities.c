@@ -106,7 +106,7 @@ void mesh_swap_qualities(
   unsigned const* verts_of_edges = mesh_ask_down(m, 1, 0);
   unsigned const* verts_of_tets = mesh_ask_down(m, 3, 0);
   double const* coords = mesh_find_tag(m, 0, "coordinates")->d.f64;
-  double* elem_quals = mesh_qualities(m);
+  double* elem_quals = mesh_adapt_qualities(m);
   unsigned* owned_edges = 0;
   if (mesh_is_parallel(m))
     owned_edges = mesh_get_owned(m, 1);
@@ -18,6 +18,8 @@ struct tag {
   enum tag_type type;
   enum osh_transfer transfer_type;
   void* data;
+  /* shared by the tags holding (data), null if only this one */
+  unsigned* refs;
 };
 
 #ifdef __clang__
@@ -45,13 +47,25 @@ static struct tag* new_tag(char const* name, enum tag_type type,
   t->type = type;
   t->transfer_type = tt;
   t->data = data;
+  t->refs = 0;
   return t;
 }
 
+static void release_data(struct tag* t)
+{
+  if (t->refs && --(*t->refs)) {
+    t->refs = 0;
+    return;
+  }
+  loop_host_free(t->refs);
+  t->refs = 0;
+  loop_free(t->data);
+}
+
 static void free_tag(struct tag* t)
 {
   loop_host_free(t->name);
-  loop_free(t->data);
+  release_data(t);
   loop_host_free(t);
 }
 
@@ -141,12 +155,13 @@ void modify_tag(struct tags* ts, char const* name, void* data)
 {
   unsigned i = find_i(ts, name);
   struct tag* t = ts->at[i];
-  loop_free(t->data);
+  release_data(t);
   t->data = data;
 }
 
 void copy_tags(struct tags* a, struct tags* b, unsigned n)
 {
+  enum mem_category cat = loop_host_set_category(MEM_TAGS);
   for (unsigned i = 0; i < count_tags(a); ++i) {
     struct const_tag* t = get_tag(a, i);
     void* data = 0;
@@ -162,32 +177,73 @@ void copy_tags(struct tags* a, struct tags* b, unsigned n)
     };
     add_tag2(b, t->type, t->name, t->ncomps, t->transfer_type, data);
   }
+  loop_host_set_category(cat);
 }
 
-void push_tag(struct exchanger* ex, struct const_tag* t, struct tags* into)
+struct const_tag* share_tag(struct tags* ts, struct const_tag* from,
+    enum osh_transfer transfer_type)
 {
-  void* data_out = 0;
-  switch (t->type) {
-    case TAG_U8:
-      break;
-    case TAG_U32:
-      data_out = exchange_uints(ex, t->ncomps, t->d.u32, EX_FOR, EX_ROOT);
-      break;
-    case TAG_U64:
-      data_out = exchange_ulongs(ex, t->ncomps, t->d.u64, EX_FOR, EX_ROOT);
-      break;
-    case TAG_F64:
-      data_out = exchange_doubles(ex, t->ncomps, t->d.f64, EX_FOR, EX_ROOT);
-      break;
+  struct tag* f = (struct tag*) from;
+  if (!f->refs) {
+    f->refs = LOOP_HOST_MALLOC(unsigned, 1);
+    *f->refs = 1;
   }
-  if (find_tag(into, t->name))
-    modify_tag(into, t->name, data_out);
-  else
-    add_tag2(into, t->type, t->name, t->ncomps, t->transfer_type, data_out);
+  struct tag* t = (struct tag*) add_tag2(ts, f->type, f->name, f->ncomps,
+      transfer_type, f->data);
+  t->refs = f->refs;
+  ++(*t->refs);
+  return (struct const_tag*) t;
+}
+
+void share_tags(struct tags* a, struct tags* b)
+{
+  for (unsigned i = 0; i < count_tags(a); ++i) {
+    struct const_tag* t = get_tag(a, i);
+    share_tag(b, t, t->transfer_type);
+  }
+}
+
+/* all the tags go out in one exchange_many round */
+
+void push_tag_list(struct exchanger* ex, unsigned n,
+    struct const_tag* const* ts, struct tags* into)
+{
+  if (!n)
+    return;
+  enum mem_category cat = loop_host_set_category(MEM_TAGS);
+  unsigned* nbytes = LOOP_HOST_MALLOC(unsigned, n);
+  void const** data_in = LOOP_HOST_MALLOC(void const*, n);
+  void** data_out = LOOP_HOST_MALLOC(void*, n);
+  for (unsigned i = 0; i < n; ++i) {
+    nbytes[i] = ts[i]->ncomps * tag_size(ts[i]->type);
+    data_in[i] = ts[i]->d.raw;
+  }
+  exchange_many(ex, n, nbytes, data_in, EX_FOR, EX_ROOT, data_out);
+  for (unsigned i = 0; i < n; ++i) {
+    struct const_tag* t = ts[i];
+    if (find_tag(into, t->name))
+      modify_tag(into, t->name, data_out[i]);
+    else
+      add_tag2(into, t->type, t->name, t->ncomps, t->transfer_type,
+          data_out[i]);
+  }
+  loop_host_free(nbytes);
+  loop_host_free(data_in);
+  loop_host_free(data_out);
+  loop_host_set_category(cat);
+}
+
+void push_tag(struct exchanger* ex, struct const_tag* t, struct tags* into)
+{
+  push_tag_list(ex, 1, &t, into);
 }
 
 void push_tags(struct exchanger* ex, struct tags* from, struct tags* into)
 {
-  for (unsigned i = 0; i < count_tags(from); ++i)
-    push_tag(ex, get_tag(from, i), into);
+  unsigned n = count_tags(from);
+  struct const_tag** ts = LOOP_HOST_MALLOC(struct const_tag*, n);
+  for (unsigned i = 0; i < n; ++i)
+    ts[i] = get_tag(from, i);
+  push_tag_list(ex, n, ts, into);
+  loop_host_free(ts);
 }
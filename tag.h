@@ -57,8 +57,20 @@ unsigned tag_size(enum tag_type t);
 
 void copy_tags(struct tags* a, struct tags* b, unsigned n);
 
+/* these add tags that hold the same array as (from), which is
+ * freed along with the last of them. some tag arrays are written
+ * in place (mesh_conform_tag, osh_get_field), so only share them
+ * with an output mesh that is about to overwrite the input,
+ * with neither written to in between.
+ */
+struct const_tag* share_tag(struct tags* ts, struct const_tag* from,
+    enum osh_transfer transfer_type);
+void share_tags(struct tags* a, struct tags* b);
+
 struct exchanger;
 
+void push_tag_list(struct exchanger* ex, unsigned n,
+    struct const_tag* const* ts, struct tags* into);
 void push_tag(struct exchanger* ex, struct const_tag* t, struct tags* into);
 void push_tags(struct exchanger* push, struct tags* from, struct tags* into);
 
@@ -0,0 +1,71 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "adapt.h"
+#include "algebra.h"
+#include "comm.h"
+#include "eval_field.h"
+#include "ints.h"
+#include "loop.h"
+#include "mesh.h"
+#include "parallel_mesh.h"
+#include "quality.h"
+#include "trace.h"
+#include "vtk_io.h"
+
+static double const size_floor = 1. / 3.;
+static double const good_qual_floor = 0.3;
+static unsigned const nsliver_layers = 2;
+static unsigned const max_ops = 50;
+/* the size field above adapts the unit square to
+   between 230 and 240 elements, depending on the partition */
+static unsigned long const min_elems = 150;
+static unsigned long const max_elems = 350;
+
+static void size_fun(double const* x, double* s)
+{
+  double coarse = 0.5;
+  double fine = 0.04;
+  double radius = vector_norm(x, 3);
+  double d = fabs(radius - 0.25);
+  if (d > 1)
+    d = 1;
+  s[0] = coarse * d + fine * (1 - d);
+}
+
+static unsigned long count_elems(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  if (!mesh_is_parallel(m) || !mesh_ghost_layers(m))
+    return comm_add_ulong(nelems);
+  unsigned* owned = mesh_get_owned(m, dim);
+  unsigned nowned = uints_sum(owned, nelems);
+  loop_free(owned);
+  return comm_add_ulong(nowned);
+}
+
+int main(int argc, char** argv)
+{
+  assert(argc == 3 || argc == 4);
+  comm_init();
+  if (argc == 4)
+    trace_open(argv[3]);
+  struct mesh* m = read_mesh_vtk(argv[1]);
+  mesh_eval_field(m, 0, "adapt_size", 1, size_fun);
+  mesh_adapt_set_imbalance(1.5);
+  mesh_adapt(m, size_floor, good_qual_floor, nsliver_layers, max_ops);
+  mesh_free_tag(m, 0, "adapt_size");
+  unsigned long nelems = count_elems(m);
+  double minqual = comm_min_double(mesh_min_quality(m));
+  if (comm_rank() == 0)
+    printf("adapted to %lu elements, min quality %.3f\n", nelems, minqual);
+  assert(min_elems <= nelems && nelems <= max_elems);
+  assert(minqual >= good_qual_floor);
+  write_mesh_vtk(m, argv[2]);
+  if (argc == 4)
+    trace_close();
+  free_mesh(m);
+  comm_fini();
+}
@@ -0,0 +1,168 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "adapt.h"
+#include "algebra.h"
+#include "arrays.h"
+#include "comm.h"
+#include "diffusive_balance.h"
+#include "eval_field.h"
+#include "ints.h"
+#include "loop.h"
+#include "ghost_mesh.h"
+#include "mesh.h"
+#include "parallel_inertial_bisect.h"
+#include "parallel_mesh.h"
+#include "refine.h"
+
+static void fine_corner(double const* x, double* s)
+{
+  double coarse = 0.5;
+  double fine = 0.05;
+  double d = vector_norm(x, 3);
+  if (d > 1)
+    d = 1;
+  s[0] = coarse * d + fine * (1 - d);
+}
+
+static double get_imbalance(struct mesh* m)
+{
+  unsigned long n = mesh_count(m, mesh_dim(m));
+  double total = (double) comm_add_ulong(n);
+  double max = (double) comm_max_ulong(n);
+  return max / (total / comm_size());
+}
+
+/* each element carries the rank it started on,
+   so the elements that moved can be counted afterwards */
+
+static void tag_origins(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  mesh_add_tag(m, dim, TAG_U32, "origin", 1,
+      uints_filled(mesh_count(m, dim), comm_rank()));
+}
+
+LOOP_KERNEL(moved_kern,
+    unsigned self,
+    unsigned const* origins,
+    unsigned* moved)
+  moved[i] = (origins[i] != self);
+}
+
+static unsigned long count_moved(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  unsigned* moved = LOOP_MALLOC(unsigned, nelems);
+  LOOP_EXEC(moved_kern, nelems, comm_rank(),
+      mesh_find_tag(m, dim, "origin")->d.u32, moved);
+  unsigned long n = comm_add_ulong(uints_sum(moved, nelems));
+  loop_free(moved);
+  return n;
+}
+
+static void refine_corner(struct mesh* m)
+{
+  mesh_eval_field(m, 0, "adapt_size", 1, fine_corner);
+  while (refine_by_size(m, 0));
+  mesh_free_tag(m, 0, "adapt_size");
+}
+
+/* on a ghosted mesh the partition only takes the owned
+   elements and leaves the ghosting alone. the cuts
+   themselves depend on the element order, which ghosting
+   changes, so only the counts are compared */
+
+static void check_ghosted_partition(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  mesh_ensure_ghosting(m, 0);
+  unsigned long nelems = comm_add_ulong(mesh_count(m, dim));
+  mesh_ensure_ghosting(m, 1);
+  unsigned nghosted = mesh_count(m, dim);
+  unsigned n;
+  unsigned* orig_ranks;
+  unsigned* orig_ids;
+  mesh_inertial_partition(m, &n, &orig_ranks, &orig_ids);
+  loop_free(orig_ranks);
+  loop_free(orig_ids);
+  assert(comm_add_ulong(n) == nelems);
+  unsigned long bytes = mesh_inertial_migration_bytes(m);
+  assert(bytes <= nelems * mesh_migration_bytes_per_elem(m));
+  assert(mesh_ghost_layers(m) == 1);
+  assert(mesh_count(m, dim) == nghosted);
+  mesh_ensure_ghosting(m, 0);
+  assert(comm_add_ulong(mesh_count(m, dim)) == nelems);
+}
+
+/* the same refinement done by mesh_adapt on a mesh that
+   starts out balanced: left alone it ends well above
+   (max_imbalance), with diffusive rebalancing between
+   passes it has to end below */
+
+static double adapt_corner(char const* filename, double max_imbalance,
+    unsigned diffusive)
+{
+  struct mesh* m = read_and_partition_serial_mesh(filename);
+  mesh_eval_field(m, 0, "adapt_size", 1, fine_corner);
+  mesh_adapt_set_imbalance(diffusive ? max_imbalance : 0);
+  mesh_adapt_set_diffusive(diffusive);
+  mesh_adapt(m, 0.3, 0.3, 2, 50);
+  mesh_adapt_set_imbalance(0);
+  mesh_adapt_set_diffusive(0);
+  double imbalance = get_imbalance(m);
+  free_mesh(m);
+  return imbalance;
+}
+
+static void check_adapt(char const* filename)
+{
+  double const max_imbalance = 1.03;
+  double left = adapt_corner(filename, max_imbalance, 0);
+  double diffused = adapt_corner(filename, max_imbalance, 1);
+  if (comm_rank() == 0)
+    printf("after adapting, imbalance %.3f without rebalancing, "
+        "%.3f with diffusion\n", left, diffused);
+  assert(left > max_imbalance);
+  assert(diffused <= max_imbalance);
+}
+
+/* refining near one corner leaves the mesh out of balance,
+   which diffusion should fix while moving less than a
+   full repartition would */
+
+int main(int argc, char** argv)
+{
+  assert(argc == 2);
+  comm_init();
+  struct mesh* m = read_and_partition_serial_mesh(argv[1]);
+  refine_corner(m);
+  check_ghosted_partition(m);
+  double before = get_imbalance(m);
+  unsigned long full = mesh_inertial_migration_bytes(m);
+  tag_origins(m);
+  unsigned long bytes_per_elem = mesh_migration_bytes_per_elem(m);
+  unsigned long diffused = balance_mesh_diffusive(m, 1.05);
+  double after = get_imbalance(m);
+  unsigned long moved = count_moved(m);
+  if (comm_rank() == 0)
+    printf("imbalance %.3f -> %.3f, migrated %lu bytes, "
+        "a full repartition would migrate %lu bytes\n",
+        before, after, diffused, full);
+  assert(after <= before);
+  assert(after <= 1.05);
+  /* whole elements are counted, once per round they move in.
+     an element that moves in two rounds is counted twice but
+     may end up back home, so the final count is only a lower
+     bound, which is exact when one round was enough (as it
+     is on three ranks) */
+  assert(diffused % bytes_per_elem == 0);
+  assert(diffused >= moved * bytes_per_elem);
+  if (comm_size() == 3)
+    assert(diffused == moved * bytes_per_elem);
+  assert(diffused < full);
+  free_mesh(m);
+  check_adapt(argv[1]);
+  comm_fini();
+}
@@ -0,0 +1,121 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "algebra.h"
+#include "arrays.h"
+#include "bfs.h"
+#include "comm.h"
+#include "derive_model.h"
+#include "graph.h"
+#include "loop.h"
+#include "mesh.h"
+#include "refine.h"
+#include "star.h"
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+/* the vertex graph of a refined box, twice over,
+   so that there is more than one component */
+
+static void make_graph(unsigned dim, unsigned nlevels,
+    unsigned* p_n, unsigned** p_offsets, unsigned** p_adj)
+{
+  struct mesh* m = new_box_mesh(dim);
+  mesh_derive_model(m, PI / 4);
+  mesh_set_rep(m, MESH_FULL);
+  for (unsigned i = 0; i < nlevels; ++i)
+    uniformly_refine(m);
+  unsigned nverts = mesh_count(m, 0);
+  struct const_graph* star = mesh_ask_star(m, 0, 1);
+  unsigned* offsets = uints_to_host(star->offsets, nverts + 1);
+  unsigned nadj = offsets[nverts];
+  unsigned* adj = uints_to_host(star->adj, nadj);
+  free_mesh(m);
+  unsigned* offsets2 = LOOP_HOST_MALLOC(unsigned, 2 * nverts + 1);
+  unsigned* adj2 = LOOP_HOST_MALLOC(unsigned, 2 * nadj);
+  for (unsigned k = 0; k < 2; ++k) {
+    for (unsigned i = 0; i < nverts; ++i)
+      offsets2[k * nverts + i] = k * nadj + offsets[i];
+    for (unsigned j = 0; j < nadj; ++j)
+      adj2[k * nadj + j] = k * nverts + adj[j];
+  }
+  offsets2[2 * nverts] = 2 * nadj;
+  loop_host_free(offsets);
+  loop_host_free(adj);
+  *p_n = 2 * nverts;
+  *p_offsets = offsets2;
+  *p_adj = adj2;
+}
+
+static void assert_same(unsigned const* host, unsigned const* device,
+    unsigned n)
+{
+  unsigned* a = uints_to_host(device, n);
+  assert(!memcmp(host, a, sizeof(unsigned) * n));
+  loop_host_free(a);
+}
+
+int main(int argc, char** argv)
+{
+  comm_init();
+  unsigned dim = 3;
+  unsigned nlevels = 4;
+  if (argc >= 2)
+    dim = (unsigned) atoi(argv[1]);
+  if (argc >= 3)
+    nlevels = (unsigned) atoi(argv[2]);
+  assert(2 <= dim && dim <= 3);
+  unsigned n;
+  unsigned* offsets;
+  unsigned* adj;
+  make_graph(dim, nlevels, &n, &offsets, &adj);
+  unsigned* d_offsets = uints_to_device(offsets, n + 1);
+  unsigned* d_adj = uints_to_device(adj, offsets[n]);
+  unsigned* comp = LOOP_HOST_MALLOC(unsigned, n);
+  unsigned* layer = LOOP_HOST_MALLOC(unsigned, n);
+  unsigned* sorted = LOOP_HOST_MALLOC(unsigned, n);
+  unsigned* d_comp = LOOP_MALLOC(unsigned, n);
+  unsigned* d_layer = LOOP_MALLOC(unsigned, n);
+  unsigned* d_sorted = LOOP_MALLOC(unsigned, n);
+  double t0 = get_time();
+  bfs_full(n, offsets, adj, comp, layer, sorted);
+  double t1 = get_time();
+  bfs_full_parallel(n, d_offsets, d_adj, d_comp, d_layer, d_sorted);
+  double t2 = get_time();
+  assert_same(comp, d_comp, n);
+  assert_same(layer, d_layer, n);
+  assert_same(sorted, d_sorted, n);
+  double t3 = get_time();
+  connected_components(n, offsets, adj, comp);
+  double t4 = get_time();
+  connected_components_parallel(n, d_offsets, d_adj, d_comp);
+  double t5 = get_time();
+  assert_same(comp, d_comp, n);
+  assert(comp[n - 1] == 1);
+  printf("%u vertices: bfs_full serial %f s parallel %f s, "
+      "connected_components serial %f s parallel %f s\n",
+      n, t1 - t0, t2 - t1, t4 - t3, t5 - t4);
+  loop_host_free(offsets);
+  loop_host_free(adj);
+  loop_host_free(comp);
+  loop_host_free(layer);
+  loop_host_free(sorted);
+  loop_free(d_offsets);
+  loop_free(d_adj);
+  loop_free(d_comp);
+  loop_free(d_layer);
+  loop_free(d_sorted);
+  comm_fini();
+  return 0;
+}
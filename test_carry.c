@@ -0,0 +1,127 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "algebra.h"
+#include "arrays.h"
+#include "coarsen.h"
+#include "comm.h"
+#include "eval_field.h"
+#include "loop.h"
+#include "mesh.h"
+#include "refine.h"
+#include "swap.h"
+#include "tables.h"
+#include "vtk_io.h"
+
+static void fine_fun(double const* x, double* s)
+{
+  double coarse = 0.5;
+  double fine = 0.1;
+  double radius = vector_norm(x, 3);
+  double d = fabs(radius - 0.5);
+  s[0] = coarse * d + fine * (1 - d);
+}
+
+static void coarse_fun(double const* x, double* s)
+{
+  (void) x;
+  s[0] = 4;
+}
+
+static void derive_all(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  for (unsigned h = 1; h <= dim; ++h)
+    for (unsigned l = 0; l < h; ++l) {
+      mesh_ask_down(m, h, l);
+      mesh_ask_up(m, l, h);
+      mesh_ask_star(m, l, h);
+    }
+  mesh_ask_dual(m);
+}
+
+/* the same entities, with nothing derived */
+
+static struct mesh* copy_ents(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  struct mesh* c = new_mesh(dim, mesh_get_rep(m), 0);
+  mesh_set_ents(c, 0, mesh_count(m, 0), 0);
+  for (unsigned d = 1; d <= dim; ++d)
+    if (mesh_has_dim(m, d))
+      mesh_set_ents(c, d, mesh_count(m, d), uints_copy(
+            mesh_ask_down(m, d, 0),
+            mesh_count(m, d) * the_down_degrees[d][0]));
+  return c;
+}
+
+static void assert_same(unsigned const* a, unsigned const* b, unsigned n)
+{
+  unsigned* ha = uints_to_host(a, n);
+  unsigned* hb = uints_to_host(b, n);
+  assert(!memcmp(ha, hb, sizeof(unsigned) * n));
+  loop_host_free(ha);
+  loop_host_free(hb);
+}
+
+/* everything carried must be there without being asked for,
+   and must match what a fresh mesh derives */
+
+static void check_carried(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  struct mesh* c = copy_ents(m);
+  for (unsigned h = 1; h <= dim; ++h)
+    for (unsigned l = 0; l < h; ++l) {
+      unsigned nlows = mesh_count(m, l);
+      unsigned nhighs = mesh_count(m, h);
+      if (l) {
+        assert(mesh_find_down(m, h, l));
+        assert_same(mesh_find_down(m, h, l), mesh_ask_down(c, h, l),
+            nhighs * the_down_degrees[h][l]);
+      }
+      struct const_up* a = mesh_find_up(m, l, h);
+      assert(a);
+      struct const_up* b = mesh_ask_up(c, l, h);
+      assert_same(a->offsets, b->offsets, nlows + 1);
+      unsigned nuses = uints_at(a->offsets, nlows);
+      assert_same(a->adj, b->adj, nuses);
+      assert_same(a->directions, b->directions, nuses);
+      struct const_graph* sa = mesh_find_star(m, l, h);
+      assert(sa);
+      struct const_graph* sb = mesh_ask_star(c, l, h);
+      assert_same(sa->offsets, sb->offsets, nlows + 1);
+      assert_same(sa->adj, sb->adj, uints_at(sa->offsets, nlows));
+    }
+  assert(mesh_find_dual(m));
+  assert_same(mesh_find_dual(m), mesh_ask_dual(c),
+      mesh_count(m, dim) * the_down_degrees[dim][dim - 1]);
+  free_mesh(c);
+}
+
+int main(int argc, char** argv)
+{
+  assert(argc == 2);
+  comm_init();
+  struct mesh* m = read_mesh_vtk(argv[1]);
+  mesh_eval_field(m, 0, "adapt_size", 1, fine_fun);
+  derive_all(m);
+  assert(refine_by_size(m, 0));
+  check_carried(m);
+  printf("%u elements after refining\n", mesh_count(m, mesh_dim(m)));
+  mesh_free_tag(m, 0, "adapt_size");
+  mesh_eval_field(m, 0, "adapt_size", 1, coarse_fun);
+  derive_all(m);
+  assert(coarsen_by_size(m, 0.1, 0.5));
+  check_carried(m);
+  printf("%u elements after coarsening\n", mesh_count(m, mesh_dim(m)));
+  if (mesh_dim(m) == 3) {
+    derive_all(m);
+    assert(swap_slivers(m, 0.7, 4));
+    check_carried(m);
+  }
+  free_mesh(m);
+  comm_fini();
+}
@@ -46,13 +46,16 @@ int main(int argc, char** argv)
   struct mesh* m = make_2_tri_parallel();
   double* data = doubles_filled(3, (double) (comm_rank() + 1));
   mesh_add_tag(m, 0, TAG_F64, "field", 1, data);
+  unsigned* ranks = uints_filled(3, comm_rank());
+  mesh_add_tag(m, 0, TAG_U32, "rank", 1, ranks);
   char file[128];
   sprintf(file, "%s/one.pvtu", path);
   write_mesh_vtk(m, file);
   mesh_accumulate_tag(m, 0, "field");
   sprintf(file, "%s/two.pvtu", path);
   write_mesh_vtk(m, file);
-  mesh_conform_tag(m, 0, "field");
+  char const* const names[2] = {"field", "rank"};
+  mesh_conform_tags(m, 0, 2, names);
   sprintf(file, "%s/three.pvtu", path);
   write_mesh_vtk(m, file);
   free_mesh(m);
@@ -0,0 +1,74 @@
+#include <assert.h>
+#include <stdlib.h>
+
+#include "algebra.h"
+#include "arrays.h"
+#include "comm.h"
+#include "derive_model.h"
+#include "ghost_mesh.h"
+#include "ints.h"
+#include "loop.h"
+#include "mesh.h"
+#include "parallel_mesh.h"
+#include "tables.h"
+
+/* derives the model again on the distributed mesh and
+   checks it against the one derived before partitioning:
+   the same class_dim everywhere, class_id consistent
+   between copies and one-to-one with the old ids */
+
+static void check_dim(struct mesh* m, unsigned dim,
+    unsigned const* old_class_dim, unsigned const* old_class_id)
+{
+  unsigned n = mesh_count(m, dim);
+  unsigned const* class_dim = mesh_find_tag(m, dim, "class_dim")->d.u32;
+  unsigned const* class_id = mesh_find_tag(m, dim, "class_id")->d.u32;
+  unsigned* conformed = uints_copy(class_id, n);
+  mesh_conform_uints(m, dim, 1, &conformed);
+  unsigned nold = n ? uints_max(old_class_id, n) + 1 : 0;
+  unsigned* new_of_old = LOOP_HOST_MALLOC(unsigned, 4 * nold);
+  for (unsigned i = 0; i < 4 * nold; ++i)
+    new_of_old[i] = INVALID;
+  for (unsigned i = 0; i < n; ++i) {
+    assert(class_dim[i] == old_class_dim[i]);
+    assert(class_id[i] != INVALID);
+    assert(conformed[i] == class_id[i]);
+    unsigned* p = &new_of_old[class_dim[i] * nold + old_class_id[i]];
+    assert(*p == INVALID || *p == class_id[i]);
+    *p = class_id[i];
+  }
+  for (unsigned d = 0; d < 4; ++d)
+    for (unsigned i = 0; i < nold; ++i)
+      for (unsigned j = i + 1; j < nold; ++j)
+        assert(new_of_old[d * nold + i] == INVALID ||
+            new_of_old[d * nold + i] != new_of_old[d * nold + j]);
+  loop_host_free(new_of_old);
+  loop_free(conformed);
+}
+
+int main(int argc, char** argv)
+{
+  comm_init();
+  assert(argc >= 2);
+  struct mesh* m = read_and_partition_serial_mesh(argv[1]);
+  if (argc >= 3)
+    ghost_mesh(m, (unsigned) atoi(argv[2]));
+  unsigned dim = mesh_dim(m);
+  unsigned* old_class_dim[4];
+  unsigned* old_class_id[4];
+  for (unsigned d = 0; d <= dim; ++d) {
+    unsigned n = mesh_count(m, d);
+    old_class_dim[d] = uints_copy(mesh_find_tag(m, d, "class_dim")->d.u32, n);
+    old_class_id[d] = uints_copy(mesh_find_tag(m, d, "class_id")->d.u32, n);
+    mesh_free_tag(m, d, "class_dim");
+    mesh_free_tag(m, d, "class_id");
+  }
+  mesh_derive_model(m, PI / 4);
+  for (unsigned d = 0; d <= dim; ++d) {
+    check_dim(m, d, old_class_dim[d], old_class_id[d]);
+    loop_free(old_class_dim[d]);
+    loop_free(old_class_id[d]);
+  }
+  free_mesh(m);
+  comm_fini();
+}
@@ -0,0 +1,133 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "arrays.h"
+#include "exchanger.h"
+#include "ints.h"
+#include "loop.h"
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+/* the previous O(nsent * nsends) message construction,
+   kept here as the reference for timing and results */
+
+static void old_sends_from_dest_ranks(
+    unsigned nsent,
+    unsigned const* dest_rank_of_sent,
+    unsigned** p_send_of_sent,
+    unsigned** p_send_shuffle,
+    unsigned* p_nsends,
+    unsigned** p_send_ranks,
+    unsigned** p_send_offsets)
+{
+  unsigned* queued = LOOP_MALLOC(unsigned, nsent);
+  for (unsigned i = 0; i < nsent; ++i)
+    queued[i] = 1;
+  unsigned* send_of_sent = LOOP_MALLOC(unsigned, nsent);
+  unsigned* send_shuffle = LOOP_MALLOC(unsigned, nsent);
+  unsigned* send_offsets = LOOP_MALLOC(unsigned, nsent + 1);
+  unsigned* send_ranks = LOOP_MALLOC(unsigned, nsent);
+  send_offsets[0] = 0;
+  unsigned send;
+  for (send = 0; send < nsent; ++send) {
+    unsigned current_rank = 0;
+    unsigned* queue_offsets = uints_exscan(queued, nsent);
+    unsigned nqueued = uints_at(queue_offsets, nsent);
+    if (nqueued == 0) {
+      loop_free(queue_offsets);
+      break;
+    }
+    for (unsigned i = 0; i < nsent; ++i)
+      if ((queue_offsets[i + 1] - queue_offsets[i] == 1) &&
+          queue_offsets[i] == 0)
+        current_rank = dest_rank_of_sent[i];
+    send_ranks[send] = current_rank;
+    loop_free(queue_offsets);
+    unsigned* to_rank = LOOP_MALLOC(unsigned, nsent);
+    for (unsigned i = 0; i < nsent; ++i) {
+      if (dest_rank_of_sent[i] == current_rank) {
+        send_of_sent[i] = send;
+        to_rank[i] = 1;
+        queued[i] = 0;
+      } else {
+        to_rank[i] = 0;
+      }
+    }
+    unsigned* send_idxs = uints_exscan(to_rank, nsent);
+    send_offsets[send + 1] = send_offsets[send] + uints_at(send_idxs, nsent);
+    for (unsigned i = 0; i < nsent; ++i)
+      if (to_rank[i])
+        send_shuffle[i] = send_idxs[i] + send_offsets[send];
+    loop_free(to_rank);
+    loop_free(send_idxs);
+  }
+  unsigned nsends = send;
+  loop_free(queued);
+  *p_send_of_sent = send_of_sent;
+  *p_send_shuffle = send_shuffle;
+  *p_nsends = nsends;
+  *p_send_ranks = uints_copy(send_ranks, nsends);
+  loop_free(send_ranks);
+  *p_send_offsets = uints_copy(send_offsets, nsends + 1);
+  loop_free(send_offsets);
+}
+
+static unsigned const nranks = 4096;
+
+static void run(unsigned nsent, unsigned nneighbors)
+{
+  /* scatter the neighbors over the rank range and
+     the items randomly over the neighbors */
+  unsigned* dest_ranks = LOOP_MALLOC(unsigned, nsent);
+  srand(nneighbors);
+  for (unsigned i = 0; i < nsent; ++i)
+    dest_ranks[i] = ((unsigned) rand() % nneighbors) * (nranks / nneighbors);
+  unsigned* send_of_sent[2];
+  unsigned* send_shuffle[2];
+  unsigned nsends[2];
+  unsigned* send_ranks[2];
+  unsigned* send_offsets[2];
+  double t0 = get_time();
+  old_sends_from_dest_ranks(nsent, dest_ranks, &send_of_sent[0],
+      &send_shuffle[0], &nsends[0], &send_ranks[0], &send_offsets[0]);
+  double t1 = get_time();
+  sends_from_dest_ranks(nsent, dest_ranks, nranks, &send_of_sent[1],
+      &send_shuffle[1], &nsends[1], &send_ranks[1], &send_offsets[1]);
+  double t2 = get_time();
+  assert(nsends[0] == nsends[1]);
+  assert(!memcmp(send_of_sent[0], send_of_sent[1], nsent * sizeof(unsigned)));
+  assert(!memcmp(send_shuffle[0], send_shuffle[1], nsent * sizeof(unsigned)));
+  assert(!memcmp(send_ranks[0], send_ranks[1], nsends[0] * sizeof(unsigned)));
+  assert(!memcmp(send_offsets[0], send_offsets[1],
+        (nsends[0] + 1) * sizeof(unsigned)));
+  printf("%u items %u neighbors: old %f s, new %f s, speedup %.1f\n",
+      nsent, nsends[0], t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+  for (unsigned i = 0; i < 2; ++i) {
+    loop_free(send_of_sent[i]);
+    loop_free(send_shuffle[i]);
+    loop_free(send_ranks[i]);
+    loop_free(send_offsets[i]);
+  }
+  loop_free(dest_ranks);
+}
+
+int main(int argc, char** argv)
+{
+  unsigned nsent = 1000 * 1000;
+  if (argc == 2)
+    nsent = (unsigned) atoi(argv[1]);
+  for (unsigned nneighbors = 1; nneighbors <= 64; nneighbors *= 2)
+    run(nsent, nneighbors);
+  return 0;
+}
@@ -0,0 +1,125 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "arrays.h"
+#include "ints.h"
+#include "invert_map.h"
+#include "loop.h"
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+/* the previous atomic fill plus per-row selection sort,
+   kept here as the reference for timing and results */
+
+LOOP_KERNEL(old_count,
+    unsigned const* in,
+    unsigned* counts)
+  loop_atomic_increment(&(counts[in[i]]));
+}
+
+LOOP_KERNEL(old_fill,
+    unsigned const* in,
+    unsigned* offsets,
+    unsigned* counts,
+    unsigned* out)
+  unsigned d = in[i];
+  unsigned o = offsets[d];
+  unsigned j = loop_atomic_increment(&(counts[d]));
+  out[o + j] = i;
+}
+
+LOOP_KERNEL(old_sort,
+    unsigned* offsets,
+    unsigned* out)
+  unsigned first = offsets[i];
+  unsigned end = offsets[i + 1];
+  for (unsigned j = first; j < end; ++j) {
+    unsigned min_k = j;
+    for (unsigned k = j + 1; k < end; ++k)
+      if (out[k] < out[min_k])
+        min_k = k;
+    unsigned tmp = out[j];
+    out[j] = out[min_k];
+    out[min_k] = tmp;
+  }
+}
+
+static void old_invert_map(
+    unsigned nin,
+    unsigned const* in,
+    unsigned nout,
+    unsigned** p_out,
+    unsigned** p_offsets)
+{
+  unsigned* counts = uints_filled(nout, 0);
+  LOOP_EXEC(old_count, nin, in, counts);
+  unsigned* offsets = uints_exscan(counts, nout);
+  unsigned* out = LOOP_MALLOC(unsigned, nin);
+  loop_free(counts);
+  counts = uints_filled(nout, 0);
+  LOOP_EXEC(old_fill, nin, in, offsets, counts, out);
+  loop_free(counts);
+  LOOP_EXEC(old_sort, nout, offsets, out);
+  *p_out = out;
+  *p_offsets = offsets;
+}
+
+static void run(unsigned nin, unsigned nout, unsigned const* in)
+{
+  unsigned* out[2];
+  unsigned* offsets[2];
+  double t0 = get_time();
+  old_invert_map(nin, in, nout, &out[0], &offsets[0]);
+  double t1 = get_time();
+  invert_map(nin, in, nout, &out[1], &offsets[1]);
+  double t2 = get_time();
+  assert(!memcmp(out[0], out[1], nin * sizeof(unsigned)));
+  assert(!memcmp(offsets[0], offsets[1], (nout + 1) * sizeof(unsigned)));
+  printf("%u threads: old %f s, new %f s, speedup %.1f\n",
+      loop_size(), t1 - t0, t2 - t1, (t1 - t0) / (t2 - t1));
+  for (unsigned i = 0; i < 2; ++i) {
+    loop_free(out[i]);
+    loop_free(offsets[i]);
+  }
+}
+
+int main(int argc, char** argv)
+{
+  /* the shape of a tet mesh's vertices of elements:
+     about 24 elements per vertex, 4 vertices per element */
+  unsigned nin = 4 * 1000 * 1000;
+  if (argc == 2)
+    nin = (unsigned) atoi(argv[1]);
+  unsigned nout = nin / 24 + 1;
+  unsigned* in = LOOP_MALLOC(unsigned, nin);
+  srand(0);
+  for (unsigned i = 0; i < nin; ++i)
+    in[i] = (unsigned) rand() % nout;
+  printf("%u entries into %u rows\n", nin, nout);
+#ifdef _OPENMP
+  int max_threads = omp_get_max_threads();
+  for (int nthreads = 1; nthreads <= max_threads; nthreads *= 2) {
+    omp_set_num_threads(nthreads);
+    run(nin, nout, in);
+  }
+#else
+  run(nin, nout, in);
+#endif
+  loop_free(in);
+  return 0;
+}
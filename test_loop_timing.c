@@ -0,0 +1,71 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arrays.h"
+#include "files.h"
+#include "ints.h"
+#include "loop.h"
+#include "loop_timing.h"
+
+#define NCALLS 5
+#define NITEMS 1000
+
+LOOP_KERNEL(increment_kern,
+    unsigned* a)
+  a[i] += 1;
+}
+
+#if LOOP_TIMING
+/* the whole file, null-terminated */
+
+static char* read_file(char const* filename)
+{
+  FILE* f = safe_fopen(filename, "r");
+  safe_seek(f, 0, SEEK_END);
+  long size = ftell(f);
+  assert(size > 0);
+  safe_seek(f, 0, SEEK_SET);
+  char* s = malloc((unsigned long) size + 1);
+  safe_read(s, 1, (unsigned long) size, f);
+  s[size] = '\0';
+  fclose(f);
+  return s;
+}
+#endif
+
+/* a kernel run (NCALLS) times over (NITEMS) items has to
+   show up with exactly those counts, both when asked for
+   and in the JSON file */
+
+int main(int argc, char** argv)
+{
+  assert(argc == 2);
+  unsigned* a = uints_filled(NITEMS, 0);
+  for (unsigned k = 0; k < NCALLS; ++k)
+    LOOP_EXEC(increment_kern, NITEMS, a);
+  assert(uints_sum(a, NITEMS) == NCALLS * NITEMS);
+  loop_free(a);
+#if LOOP_TIMING
+  unsigned long calls, iterations;
+  loop_timing_counts("increment_kern", &calls, &iterations);
+  assert(calls == NCALLS);
+  assert(iterations == (unsigned long) NCALLS * NITEMS);
+  loop_timing_print();
+  loop_timing_write_json(argv[1]);
+  char* json = read_file(argv[1]);
+  char expected[256];
+  sprintf(expected, "\"name\": \"increment_kern\", "
+      "\"file\": \"%s\", \"calls\": %u, \"iterations\": %u,",
+      __FILE__, NCALLS, NCALLS * NITEMS);
+  assert(strstr(json, expected));
+  free(json);
+  loop_timing_reset();
+  loop_timing_counts("increment_kern", &calls, &iterations);
+  assert(!calls && !iterations);
+#else
+  (void) argv;
+  printf("kernels are not timed, build with LOOP_TIMING=1\n");
+#endif
+}
@@ -1,30 +1,273 @@
 #include <assert.h>
 #include <stdio.h>
+#include <string.h>
 
+#include "arrays.h"
+#include "comm.h"
+#include "eval_field.h"
 #include "loop.h"
 #include "vtk_io.h"
 #include "mesh.h"
+#include "refine.h"
+#include "reorder.h"
+#include "tables.h"
+
+static void sorted_low_verts(unsigned high_dim,
+    unsigned low_dim, unsigned i, unsigned j, unsigned const* lows_of_highs,
+    unsigned const* verts_of_lows, unsigned* v)
+{
+  unsigned verts_per_low = the_down_degrees[low_dim][0];
+  unsigned low = lows_of_highs[i * the_down_degrees[high_dim][low_dim] + j];
+  for (unsigned k = 0; k < verts_per_low; ++k) {
+    unsigned u = verts_of_lows[low * verts_per_low + k];
+    unsigned l = k;
+    for (; l > 0 && v[l - 1] > u; --l)
+      v[l] = v[l - 1];
+    v[l] = u;
+  }
+}
+
+static void fine_size(double const* x, double* s)
+{
+  (void) x;
+  s[0] = 0.05;
+}
+
+/* only the elements, so that everything else is derived */
+
+static struct mesh* read_reduced_mesh(char const* filename)
+{
+  struct mesh* full = read_mesh_vtk(filename);
+  unsigned dim = mesh_dim(full);
+  unsigned nelems = mesh_count(full, dim);
+  struct mesh* m = new_mesh(dim, MESH_REDUCED, 0);
+  mesh_set_ents(m, 0, mesh_count(full, 0), 0);
+  mesh_set_ents(m, dim, nelems, uints_copy(mesh_ask_down(full, dim, 0),
+        nelems * the_down_degrees[dim][0]));
+  free_mesh(full);
+  return m;
+}
+
+/* sides are numbered and oriented the same by both modes,
+   3D edges may be numbered differently, so every downward
+   adjacency is compared through the vertices it names */
+
+static void check_sort_mode(char const* filename)
+{
+  struct mesh* m[2];
+  for (unsigned k = 0; k < 2; ++k)
+    m[k] = read_reduced_mesh(filename);
+  mesh_set_derive(m[1], MESH_DERIVE_SORT);
+  unsigned dim = mesh_dim(m[0]);
+  for (unsigned d = 1; d < dim; ++d)
+    assert(mesh_count(m[0], d) == mesh_count(m[1], d));
+  unsigned nsides = mesh_count(m[0], dim - 1);
+  unsigned verts_per_side = the_down_degrees[dim - 1][0];
+  unsigned* sides[2];
+  for (unsigned k = 0; k < 2; ++k)
+    sides[k] = uints_to_host(mesh_ask_down(m[k], dim - 1, 0),
+        nsides * verts_per_side);
+  assert(!memcmp(sides[0], sides[1],
+        sizeof(unsigned) * nsides * verts_per_side));
+  for (unsigned k = 0; k < 2; ++k)
+    loop_host_free(sides[k]);
+  for (unsigned h = dim - 1; h <= dim; ++h)
+    for (unsigned l = 1; l < h; ++l) {
+      unsigned nhighs = mesh_count(m[0], h);
+      unsigned* down[2];
+      unsigned* verts[2];
+      for (unsigned k = 0; k < 2; ++k) {
+        down[k] = uints_to_host(mesh_ask_down(m[k], h, l),
+            nhighs * the_down_degrees[h][l]);
+        verts[k] = uints_to_host(mesh_ask_down(m[k], l, 0),
+            mesh_count(m[k], l) * the_down_degrees[l][0]);
+      }
+      for (unsigned i = 0; i < nhighs; ++i)
+        for (unsigned j = 0; j < the_down_degrees[h][l]; ++j) {
+          unsigned v[2][3];
+          for (unsigned k = 0; k < 2; ++k)
+            sorted_low_verts(h, l, i, j, down[k], verts[k], v[k]);
+          assert(!memcmp(v[0], v[1],
+                sizeof(unsigned) * the_down_degrees[l][0]));
+        }
+      for (unsigned k = 0; k < 2; ++k) {
+        loop_host_free(down[k]);
+        loop_host_free(verts[k]);
+      }
+    }
+  for (unsigned d = 1; d <= dim; ++d)
+    assert(!mesh_find_up(m[1], 0, d));
+  for (unsigned k = 0; k < 2; ++k)
+    free_mesh(m[k]);
+}
+
+static void assert_same_uints(unsigned const* a, unsigned const* b,
+    unsigned n)
+{
+  unsigned* ha = uints_to_host(a, n);
+  unsigned* hb = uints_to_host(b, n);
+  assert(!memcmp(ha, hb, sizeof(unsigned) * n));
+  loop_host_free(ha);
+  loop_host_free(hb);
+}
+
+static void assert_same_up(struct mesh* a, struct mesh* b,
+    unsigned low_dim, unsigned high_dim)
+{
+  unsigned nlows = mesh_count(a, low_dim);
+  struct const_up* ua = mesh_ask_up(a, low_dim, high_dim);
+  struct const_up* ub = mesh_ask_up(b, low_dim, high_dim);
+  assert_same_uints(ua->offsets, ub->offsets, nlows + 1);
+  unsigned nuses = uints_at(ua->offsets, nlows);
+  assert_same_uints(ua->adj, ub->adj, nuses);
+  assert_same_uints(ua->directions, ub->directions, nuses);
+}
+
+/* with a tiny budget, asking never frees anything but a trim
+   frees all adjacency except what is pinned, and what is freed
+   comes back the same when asked for again */
+
+static void check_budget(char const* filename)
+{
+  struct mesh* m = read_reduced_mesh(filename);
+  struct mesh* full = read_reduced_mesh(filename);
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  mesh_set_adj_budget(m, 1);
+  mesh_pin_down(m, dim, 1);
+  unsigned const* edges_of_elems = mesh_ask_down(m, dim, 1);
+  unsigned nedges_of_elems = nelems * the_down_degrees[dim][1];
+  assert_same_uints(edges_of_elems, mesh_ask_down(full, dim, 1),
+      nedges_of_elems);
+  assert_same_up(m, full, 0, dim);
+  assert_same_uints(mesh_ask_dual(m), mesh_ask_dual(full),
+      nelems * the_down_degrees[dim][dim - 1]);
+  assert(mesh_find_up(m, 0, dim));
+  mesh_trim_adj(m);
+  assert(!mesh_find_up(m, 0, dim));
+  assert(!mesh_find_dual(m));
+  assert(mesh_find_down(m, dim, 1) == edges_of_elems);
+  assert_same_up(m, full, 1, dim);
+  assert_same_up(m, full, 0, dim);
+  mesh_trim_adj(m);
+  assert(!mesh_find_up(m, 1, dim));
+  assert(mesh_adj_bytes(m) == sizeof(unsigned) * nedges_of_elems);
+  mesh_unpin_down(m, dim, 1);
+  mesh_trim_adj(m);
+  assert(!mesh_find_down(m, dim, 1));
+  assert(!mesh_adj_bytes(m));
+  mesh_set_adj_budget(m, 0);
+  assert_same_uints(mesh_ask_down(m, dim, 1), mesh_ask_down(full, dim, 1),
+      nedges_of_elems);
+  free_mesh(m);
+  free_mesh(full);
+}
+
+/* algorithms that hold several adjacencies at once run
+   the same on a budgeted mesh, which is trimmed when
+   an adapt pass overwrites it */
+
+static void check_budget_in_use(char const* filename)
+{
+  struct mesh* m = read_mesh_vtk(filename);
+  struct mesh* full = read_mesh_vtk(filename);
+  unsigned nverts = mesh_count(m, 0);
+  mesh_set_adj_budget(m, 1);
+  unsigned* order = compute_ordering(m);
+  unsigned* full_order = compute_ordering(full);
+  assert_same_uints(order, full_order, nverts);
+  loop_free(order);
+  loop_free(full_order);
+  struct mesh* ms[2] = {m, full};
+  for (unsigned k = 0; k < 2; ++k) {
+    mesh_eval_field(ms[k], 0, "adapt_size", 1, fine_size);
+    assert(refine_by_size(ms[k], 0));
+  }
+  assert(!mesh_adj_bytes(m));
+  unsigned dim = mesh_dim(m);
+  assert(mesh_count(m, dim) == mesh_count(full, dim));
+  assert_same_uints(mesh_ask_down(m, dim, 0), mesh_ask_down(full, dim, 0),
+      mesh_count(m, dim) * the_down_degrees[dim][0]);
+  free_mesh(m);
+  free_mesh(full);
+}
+
+#if MEASURE_MEMORY
+static void check_categories(void)
+{
+  unsigned long sum = 0;
+  for (unsigned c = 0; c < MEM_CATEGORIES; ++c)
+    sum += loop_host_category_memory(c);
+  assert(sum == loop_host_memory());
+}
+
+/* every phase saw at least what was live when it ended,
+   and the edges phase saw the edges it derived */
+
+static void check_phases(unsigned long after_edges_adj)
+{
+  char const* const names[3] = {"up", "edges", "faces"};
+  for (unsigned i = 0; i < 3; ++i)
+    assert(loop_host_phase_high_water(names[i]));
+  assert(loop_host_phase_category_high_water("edges", MEM_ADJACENCY)
+      >= after_edges_adj);
+  assert(loop_host_phase_high_water("faces") >= loop_host_memory());
+  assert(loop_host_high_water() >= loop_host_phase_high_water("faces"));
+  assert(!loop_host_phase_high_water("no such phase"));
+}
+#endif
 
 int main(int argc, char** argv)
 {
-  assert(argc == 2);
-  printf("baseline %lu\n", loop_host_memory());
-  struct mesh* m = read_mesh_vtk(argv[1]);
+  assert(argc == 2 || argc == 3);
+  unsigned by_sort = (argc == 3 && !strcmp(argv[2], "sort"));
+  unsigned on_budget = (argc == 3 && !strcmp(argv[2], "budget"));
+  comm_init();
+  unsigned long baseline = loop_host_memory();
+  printf("baseline %lu\n", baseline);
+  struct mesh* m = read_reduced_mesh(argv[1]);
+  unsigned dim = mesh_dim(m);
+  if (by_sort)
+    mesh_set_derive(m, MESH_DERIVE_SORT);
   printf("regions to vertices %lu\n", loop_host_memory());
   printf("regions to vertices %f (per element)\n",
       ((double)(loop_host_memory())/((double)(mesh_count(m, mesh_dim(m))))));
-  mesh_ask_up(m, 0, mesh_dim(m));
+  loop_host_phase_begin("up");
+  if (!by_sort)
+    mesh_ask_up(m, 0, dim);
+  loop_host_phase_end();
   printf("regions <-> vertices %lu\n", loop_host_memory());
   printf("regions <-> vertices %f (per element)\n",
       ((double)(loop_host_memory())/((double)(mesh_count(m, mesh_dim(m))))));
-  mesh_count(m, 1);
+  loop_host_phase_begin("edges");
+  mesh_ask_down(m, dim, 1);
+  loop_host_phase_end();
+  unsigned long edges_adj = loop_host_category_memory(MEM_ADJACENCY);
   printf("with edges %lu\n", loop_host_memory());
   printf("with edges %f (per element)\n",
       ((double)(loop_host_memory())/((double)(mesh_count(m, mesh_dim(m))))));
-  mesh_count(m, 2);
+  loop_host_phase_begin("faces");
+  if (dim == 3)
+    mesh_ask_down(m, dim, 2);
+  loop_host_phase_end();
   printf("with edges and faces %lu\n", loop_host_memory());
   printf("with edges and faces %f (per element)\n",
       ((double)(loop_host_memory())/((double)(mesh_count(m, mesh_dim(m))))));
+  loop_host_memory_report();
+#if MEASURE_MEMORY
+  check_categories();
+  check_phases(edges_adj);
+#else
+  (void) edges_adj;
+#endif
   free_mesh(m);
   printf("after freeing %lu\n", loop_host_memory());
+  assert(loop_host_memory() == baseline);
+  if (by_sort)
+    check_sort_mode(argv[1]);
+  if (on_budget) {
+    check_budget(argv[1]);
+    check_budget_in_use(argv[1]);
+  }
+  comm_fini();
 }
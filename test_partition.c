@@ -1,16 +1,58 @@
 #include <assert.h>
+#include <stdio.h>
 
 #include "comm.h"
+#include "doubles.h"
+#include "element_field.h"
+#include "eval_field.h"
 #include "mesh.h"
+#include "parallel_inertial_bisect.h"
 #include "parallel_mesh.h"
 #include "vtk_io.h"
 
+/* elements on one side weigh ten times as much */
+
+static void weight_fun(double const* x, double* w)
+{
+  w[0] = (x[0] < 0.3) ? 10.0 : 1.0;
+}
+
+static double weighted_imbalance(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  double load = doubles_sum(mesh_find_tag(m, dim, "balance_weight")->d.f64,
+      mesh_count(m, dim));
+  double total = comm_add_double(load);
+  double max = comm_max_double(load);
+  return max / (total / comm_size());
+}
+
+/* a weighted repartition should even out the weight,
+   not the number of elements */
+
+static void check_weighted(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  mesh_interp_to_elems(m, "coordinates");
+  mesh_eval_field(m, dim, "balance_weight", 1, weight_fun);
+  mesh_free_tag(m, dim, "coordinates");
+  double before = weighted_imbalance(m);
+  balance_mesh_inertial(m);
+  double after = weighted_imbalance(m);
+  if (comm_rank() == 0)
+    printf("weighted imbalance %.3f -> %.3f on %u ranks\n",
+        before, after, comm_size());
+  assert(after < 1.1);
+  mesh_free_tag(m, dim, "balance_weight");
+}
+
 int main(int argc, char** argv)
 {
   comm_init();
   assert(argc == 3);
   struct mesh* m = read_and_partition_serial_mesh(argv[1]);
   write_mesh_vtk(m, argv[2]);
+  check_weighted(m);
   free_mesh(m);
   comm_fini();
 }
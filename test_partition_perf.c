@@ -0,0 +1,76 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "algebra.h"
+#include "comm.h"
+#include "derive_model.h"
+#include "mesh.h"
+#include "parallel_inertial_bisect.h"
+#include "parallel_mesh.h"
+#include "refine.h"
+#include "trace.h"
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+/* a refined box built on rank 0 and handed out to
+   the rest, which is where read_and_partition_serial_mesh
+   starts from */
+
+static struct mesh* make_mesh(unsigned dim, unsigned nlevels)
+{
+  struct mesh* m = 0;
+  if (comm_rank() == 0) {
+    comm_use(comm_self());
+    m = new_box_mesh(dim);
+    mesh_derive_model(m, PI / 4);
+    mesh_set_rep(m, MESH_FULL);
+    for (unsigned i = 0; i < nlevels; ++i)
+      uniformly_refine(m);
+    mesh_make_parallel(m);
+    comm_use(comm_world());
+  }
+  mesh_partition_out(&m, comm_size());
+  return m;
+}
+
+int main(int argc, char** argv)
+{
+  comm_init();
+  unsigned dim = 3;
+  unsigned nlevels = 4;
+  if (argc >= 2)
+    dim = (unsigned) atoi(argv[1]);
+  if (argc >= 3)
+    nlevels = (unsigned) atoi(argv[2]);
+  if (argc >= 4)
+    trace_open(argv[3]);
+  assert(2 <= dim && dim <= 3);
+  struct mesh* m = make_mesh(dim, nlevels);
+  double t0 = get_time();
+  balance_mesh_inertial(m);
+  double t1 = get_time();
+  double t = comm_max_double(t1 - t0);
+  unsigned long nelems = mesh_count(m, dim);
+  unsigned long total = comm_add_ulong(nelems);
+  unsigned long max = comm_max_ulong(nelems);
+  double imbalance = (double) max / ((double) total / comm_size());
+  if (comm_rank() == 0)
+    printf("%lu elements on %u ranks: partitioned in %f s, "
+        "imbalance %.3f\n", total, comm_size(), t, imbalance);
+  assert(imbalance < 1.1);
+  free_mesh(m);
+  if (argc >= 4)
+    trace_close();
+  comm_fini();
+  return 0;
+}
@@ -0,0 +1,132 @@
+#include <assert.h>
+#include <stdio.h>
+
+#include "adapt_region.h"
+#include "arrays.h"
+#include "coarsen.h"
+#include "comm.h"
+#include "doubles.h"
+#include "ints.h"
+#include "loop.h"
+#include "loop_timing.h"
+#include "mesh.h"
+#include "quality.h"
+#include "refine.h"
+#include "size.h"
+#include "vtk_io.h"
+
+static double const region_x = 0.25;
+static double const far_x = 0.5;
+
+static void set_size(struct mesh* m, double size)
+{
+  if (mesh_find_tag(m, 0, "adapt_size"))
+    mesh_free_tag(m, 0, "adapt_size");
+  mesh_add_tag(m, 0, TAG_F64, "adapt_size", 1,
+      doubles_filled(mesh_count(m, 0), size));
+}
+
+static void set_region(struct mesh* m)
+{
+  unsigned nverts = mesh_count(m, 0);
+  double* coords = doubles_to_host(
+      mesh_find_tag(m, 0, "coordinates")->d.f64, nverts * 3);
+  unsigned* region = LOOP_HOST_MALLOC(unsigned, nverts);
+  for (unsigned i = 0; i < nverts; ++i)
+    region[i] = coords[i * 3] < region_x;
+  loop_host_free(coords);
+  mesh_add_tag(m, 0, TAG_U32, "adapt_region", 1,
+      uints_to_device(region, nverts));
+  loop_host_free(region);
+}
+
+static unsigned count_far_verts(struct mesh* m)
+{
+  unsigned nverts = mesh_count(m, 0);
+  double* coords = doubles_to_host(
+      mesh_find_tag(m, 0, "coordinates")->d.f64, nverts * 3);
+  unsigned n = 0;
+  for (unsigned i = 0; i < nverts; ++i)
+    if (coords[i * 3] > far_x)
+      ++n;
+  loop_host_free(coords);
+  return n;
+}
+
+static unsigned count_region_verts(struct mesh* m)
+{
+  return uints_sum(mesh_find_tag(m, 0, "adapt_region")->d.u32,
+      mesh_count(m, 0));
+}
+
+/* the region only masks the qualities adapt decides on,
+   mesh_qualities still reports every element */
+
+static void check_qualities(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nelems = mesh_count(m, dim);
+  double* quals = mesh_qualities(m);
+  double* all = element_qualities(dim, nelems,
+      mesh_ask_down(m, dim, 0),
+      mesh_find_tag(m, 0, "coordinates")->d.f64);
+  doubles_axpy(-1, all, quals, quals, nelems);
+  assert(doubles_max(quals, nelems) == 0);
+  assert(doubles_min(quals, nelems) == 0);
+  loop_free(quals);
+  loop_free(all);
+  assert(mesh_min_quality(m) <= mesh_adapt_min_quality(m));
+  assert(mesh_min_quality(m) < 1.0);
+}
+
+/* the region is a mask: the size and quality kernels adapt
+   runs each pass only visit the region's edges and elements,
+   which are a fraction of the mesh */
+
+static void check_work(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned nedges, nelems;
+  loop_free(mesh_list_region(m, 1, &nedges));
+  loop_free(mesh_list_region(m, dim, &nelems));
+  assert(0 < nedges && nedges < mesh_count(m, 1));
+  assert(0 < nelems && nelems < mesh_count(m, dim));
+#if LOOP_TIMING
+  loop_timing_reset();
+  loop_free(mesh_measure_edges_for_adapt(m));
+  loop_free(mesh_adapt_qualities(m));
+  unsigned long calls, iterations;
+  loop_timing_counts("measure_edge", &calls, &iterations);
+  assert(calls == 1 && iterations == nedges);
+  loop_timing_counts("elem_quality_kern", &calls, &iterations);
+  assert(calls == 1 && iterations == nelems);
+#endif
+  printf("%u of %u edges, %u of %u elements in the region\n",
+      nedges, mesh_count(m, 1), nelems, mesh_count(m, dim));
+}
+
+/* the size field asks for changes everywhere, but one pass
+   may only modify the region and the cavities next to it */
+
+int main(int argc, char** argv)
+{
+  assert(argc == 2);
+  comm_init();
+  struct mesh* m = read_mesh_vtk(argv[1]);
+  set_region(m);
+  unsigned nfar = count_far_verts(m);
+  unsigned nregion = count_region_verts(m);
+  set_size(m, 0.01);
+  assert(refine_by_size(m, 0));
+  assert(count_far_verts(m) == nfar);
+  assert(count_region_verts(m) > nregion);
+  nregion = count_region_verts(m);
+  set_size(m, 4.0);
+  assert(coarsen_by_size(m, 0.1, 0.5));
+  assert(count_far_verts(m) == nfar);
+  check_qualities(m);
+  check_work(m);
+  printf("%u of %u vertices in the region\n", nregion, mesh_count(m, 0));
+  free_mesh(m);
+  comm_fini();
+}
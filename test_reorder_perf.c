@@ -0,0 +1,181 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include "algebra.h"
+#include "arrays.h"
+#include "comm.h"
+#include "derive_model.h"
+#include "doubles.h"
+#include "loop.h"
+#include "mesh.h"
+#include "quality.h"
+#include "refine.h"
+#include "reorder.h"
+#include "shuffle_mesh.h"
+#include "star.h"
+#include "tables.h"
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+static unsigned* random_permutation(unsigned n)
+{
+  unsigned* p = LOOP_HOST_MALLOC(unsigned, n);
+  for (unsigned i = 0; i < n; ++i)
+    p[i] = i;
+  for (unsigned i = n; i > 1; --i) {
+    unsigned j = (unsigned) rand() % i;
+    unsigned tmp = p[i - 1];
+    p[i - 1] = p[j];
+    p[j] = tmp;
+  }
+  unsigned* out = uints_to_device(p, n);
+  loop_host_free(p);
+  return out;
+}
+
+/* a refined box with its vertices and elements in random
+   order, which is roughly what many adapt cycles leave */
+
+static struct mesh* make_scrambled_mesh(unsigned dim, unsigned nlevels)
+{
+  struct mesh* m = new_box_mesh(dim);
+  mesh_derive_model(m, PI / 4);
+  mesh_set_rep(m, MESH_FULL);
+  for (unsigned i = 0; i < nlevels; ++i)
+    uniformly_refine(m);
+  srand(0);
+  unsigned* old_to_new_ents[4] = {0};
+  old_to_new_ents[0] = random_permutation(mesh_count(m, 0));
+  old_to_new_ents[dim] = random_permutation(mesh_count(m, dim));
+  shuffle_mesh_ents(m, (unsigned const* const*) old_to_new_ents);
+  loop_free(old_to_new_ents[0]);
+  loop_free(old_to_new_ents[dim]);
+  return m;
+}
+
+static void assert_same_uints(unsigned const* a, unsigned const* b,
+    unsigned n)
+{
+  unsigned* ha = uints_to_host(a, n);
+  unsigned* hb = uints_to_host(b, n);
+  assert(!memcmp(ha, hb, sizeof(unsigned) * n));
+  loop_host_free(ha);
+  loop_host_free(hb);
+}
+
+/* adjacencies carried over by the shuffle must be the same
+   as the ones derived from scratch after it */
+
+static void check_carried(unsigned dim, unsigned nlevels)
+{
+  struct mesh* m[2];
+  for (unsigned k = 0; k < 2; ++k)
+    m[k] = make_scrambled_mesh(dim, nlevels);
+  mesh_ask_dual(m[0]);
+  for (unsigned h = 1; h <= dim; ++h)
+    for (unsigned l = 0; l < h; ++l) {
+      mesh_ask_down(m[0], h, l);
+      mesh_ask_up(m[0], l, h);
+    }
+  for (unsigned k = 0; k < 2; ++k)
+    reorder_mesh(m[k], REORDER_SORTED);
+  for (unsigned h = 1; h <= dim; ++h)
+    for (unsigned l = 0; l < h; ++l) {
+      assert(mesh_find_down(m[0], h, l));
+      assert(!l || !mesh_find_down(m[1], h, l));
+      assert_same_uints(mesh_ask_down(m[0], h, l), mesh_ask_down(m[1], h, l),
+          mesh_count(m[0], h) * the_down_degrees[h][l]);
+      unsigned nlows = mesh_count(m[0], l);
+      struct const_up* u[2];
+      for (unsigned k = 0; k < 2; ++k)
+        u[k] = mesh_ask_up(m[k], l, h);
+      assert_same_uints(u[0]->offsets, u[1]->offsets, nlows + 1);
+      unsigned nuses = uints_at(u[0]->offsets, nlows);
+      assert_same_uints(u[0]->adj, u[1]->adj, nuses);
+      assert_same_uints(u[0]->directions, u[1]->directions, nuses);
+    }
+  assert_same_uints(mesh_ask_dual(m[0]), mesh_ask_dual(m[1]),
+      mesh_count(m[0], dim) * the_down_degrees[dim][dim - 1]);
+  for (unsigned k = 0; k < 2; ++k)
+    free_mesh(m[k]);
+}
+
+static unsigned const nquality_runs = 10;
+
+static void run(unsigned dim, unsigned nlevels, char const* name,
+    int mode, double* p_qual_sum)
+{
+  struct mesh* m = make_scrambled_mesh(dim, nlevels);
+  /* build the adjacency the BFS uses up front */
+  if (mode >= 0)
+    mesh_ask_star(m, 0, 1);
+  double t0 = get_time();
+  unsigned* old_to_new_ents[4] = {0};
+  if (mode == REORDER_BFS) {
+    old_to_new_ents[0] = compute_ordering(m);
+  } else if (mode == REORDER_HILBERT) {
+    old_to_new_ents[0] = compute_hilbert_ordering(m, 0);
+    old_to_new_ents[dim] = compute_hilbert_ordering(m, dim);
+  } else if (mode == REORDER_SORTED) {
+    old_to_new_ents[0] = compute_hilbert_ordering(m, 0);
+    for (unsigned d = 1; d <= dim; ++d)
+      old_to_new_ents[d] = sort_ents_by_verts(m, d, old_to_new_ents[0]);
+  }
+  double t1 = get_time();
+  if (old_to_new_ents[0])
+    shuffle_mesh_ents(m, (unsigned const* const*) old_to_new_ents);
+  for (unsigned d = 0; d < 4; ++d)
+    loop_free(old_to_new_ents[d]);
+  double t1b = get_time();
+  unsigned nelems = mesh_count(m, dim);
+  unsigned const* verts_of_elems = mesh_ask_down(m, dim, 0);
+  double const* coords = mesh_find_tag(m, 0, "coordinates")->d.f64;
+  double qual_sum = 0;
+  for (unsigned k = 0; k < nquality_runs; ++k) {
+    double* quals = element_qualities(dim, nelems, verts_of_elems, coords);
+    qual_sum = doubles_sum(quals, nelems);
+    loop_free(quals);
+  }
+  double t2 = get_time();
+  mesh_ask_star(m, 0, 1);
+  double t3 = get_time();
+  if (*p_qual_sum < 0)
+    *p_qual_sum = qual_sum;
+  assert(fabs(qual_sum - *p_qual_sum) < 1e-8 * *p_qual_sum);
+  printf("%-10s ordering %f s, shuffle %f s, "
+      "%u x element_qualities %f s, vertex star %f s\n",
+      name, t1 - t0, t1b - t1, nquality_runs, t2 - t1b, t3 - t2);
+  free_mesh(m);
+}
+
+int main(int argc, char** argv)
+{
+  comm_init();
+  unsigned dim = 3;
+  unsigned nlevels = 4;
+  if (argc >= 2)
+    dim = (unsigned) atoi(argv[1]);
+  if (argc >= 3)
+    nlevels = (unsigned) atoi(argv[2]);
+  assert(2 <= dim && dim <= 3);
+  double qual_sum = -1;
+  run(dim, nlevels, "scrambled", -1, &qual_sum);
+  run(dim, nlevels, "bfs", REORDER_BFS, &qual_sum);
+  run(dim, nlevels, "hilbert", REORDER_HILBERT, &qual_sum);
+  run(dim, nlevels, "sorted", REORDER_SORTED, &qual_sum);
+  check_carried(dim, nlevels);
+  comm_fini();
+  return 0;
+}
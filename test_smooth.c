@@ -0,0 +1,79 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "arrays.h"
+#include "comm.h"
+#include "eval_field.h"
+#include "loop.h"
+#include "mesh.h"
+#include "parallel_mesh.h"
+#include "smooth.h"
+#include "tag.h"
+#include "vtk_io.h"
+
+static double const tol = 1e-6;
+static unsigned const maxiter = 1000;
+
+static void step_fun(double const* x, double* s)
+{
+  s[0] = (x[0] < 0.5) ? 0.0 : 1.0;
+}
+
+/* every rank smooths the whole serial mesh by itself,
+   which is what the partitioned result is checked against */
+
+static double* smooth_serial(char const* filename, unsigned* p_niters)
+{
+  comm_use(comm_self());
+  struct mesh* m = read_mesh_vtk(filename);
+  mesh_eval_field(m, 0, "field", 1, step_fun);
+  *p_niters = mesh_smooth_field(m, "field", tol, maxiter);
+  double* data = doubles_to_host(mesh_find_tag(m, 0, "field")->d.f64,
+      mesh_count(m, 0));
+  free_mesh(m);
+  comm_use(comm_world());
+  return data;
+}
+
+/* the partition keeps the serial vertex numbers as
+   its global numbers */
+
+static double max_difference(struct mesh* m, double const* serial)
+{
+  unsigned n = mesh_count(m, 0);
+  double* data = doubles_to_host(mesh_find_tag(m, 0, "field")->d.f64, n);
+  unsigned long const* globals = mesh_ask_globals(m, 0);
+  double max = 0;
+  for (unsigned i = 0; i < n; ++i) {
+    double d = fabs(data[i] - serial[globals[i]]);
+    if (d > max)
+      max = d;
+  }
+  loop_host_free(data);
+  return comm_max_double(max);
+}
+
+int main(int argc, char** argv)
+{
+  assert(argc == 2 || argc == 3);
+  comm_init();
+  unsigned serial_niters;
+  double* serial = smooth_serial(argv[1], &serial_niters);
+  struct mesh* m = read_and_partition_serial_mesh(argv[1]);
+  mesh_eval_field(m, 0, "field", 1, step_fun);
+  unsigned niters = mesh_smooth_field(m, "field", tol, maxiter);
+  double diff = max_difference(m, serial);
+  if (comm_rank() == 0)
+    printf("%u iterations on %u ranks, %u serially, "
+        "largest difference %.3e\n",
+        niters, comm_size(), serial_niters, diff);
+  assert(niters < maxiter);
+  assert(niters == serial_niters);
+  assert(diff < tol);
+  loop_host_free(serial);
+  if (argc == 3)
+    write_mesh_vtk(m, argv[2]);
+  free_mesh(m);
+  comm_fini();
+}
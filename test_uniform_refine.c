@@ -0,0 +1,123 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+
+#include "adapt_region.h"
+#include "arrays.h"
+#include "comm.h"
+#include "doubles.h"
+#include "ints.h"
+#include "loop.h"
+#include "mesh.h"
+#include "parallel_mesh.h"
+#include "refine_uniform.h"
+#include "size.h"
+#include "vtk_io.h"
+
+static double const region_x = 0.25;
+
+static void set_region(struct mesh* m)
+{
+  unsigned nverts = mesh_count(m, 0);
+  double* coords = doubles_to_host(
+      mesh_find_tag(m, 0, "coordinates")->d.f64, nverts * 3);
+  unsigned* region = LOOP_HOST_MALLOC(unsigned, nverts);
+  for (unsigned i = 0; i < nverts; ++i)
+    region[i] = coords[i * 3] < region_x;
+  loop_host_free(coords);
+  mesh_add_tag(m, 0, TAG_U32, "adapt_region", 1,
+      uints_to_device(region, nverts));
+  loop_host_free(region);
+}
+
+struct counts {
+  unsigned long nverts;
+  unsigned long nelems;
+  unsigned long nregion_verts;
+  unsigned long nregion_elems;
+  double size;
+};
+
+/* only owned entities are counted, so the
+   counts do not depend on the number of ranks */
+
+static unsigned long count_owned(struct mesh* m, unsigned dim,
+    unsigned const* marked)
+{
+  unsigned n = mesh_count(m, dim);
+  unsigned* owned = mesh_is_parallel(m) ?
+    mesh_get_owned(m, dim) : uints_filled(n, 1);
+  unsigned long c = 0;
+  for (unsigned i = 0; i < n; ++i)
+    if (owned[i] && (!marked || marked[i]))
+      ++c;
+  loop_free(owned);
+  return comm_add_ulong(c);
+}
+
+static struct counts get_counts(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  struct counts c;
+  c.nverts = count_owned(m, 0, 0);
+  c.nelems = count_owned(m, dim, 0);
+  unsigned* verts = mesh_mark_region(m, 0);
+  c.nregion_verts = count_owned(m, 0, verts);
+  loop_free(verts);
+  unsigned* elems = mesh_mark_region(m, dim);
+  c.nregion_elems = count_owned(m, dim, elems);
+  loop_free(elems);
+  double* sizes = mesh_element_sizes(m);
+  c.size = comm_add_double(doubles_sum(sizes, mesh_count(m, dim)));
+  loop_free(sizes);
+  return c;
+}
+
+/* every rank refines the whole serial mesh by itself,
+   which is what the partitioned result is checked against */
+
+static struct counts refine_serial(char const* filename,
+    struct counts* before)
+{
+  comm_use(comm_self());
+  struct mesh* m = read_mesh_vtk(filename);
+  mesh_set_rep(m, MESH_FULL);
+  set_region(m);
+  *before = get_counts(m);
+  mesh_refine_uniform(m);
+  struct counts c = get_counts(m);
+  free_mesh(m);
+  comm_use(comm_world());
+  return c;
+}
+
+/* uniform refinement splits every element into 2^dim
+   and the region into the children of its elements */
+
+int main(int argc, char** argv)
+{
+  assert(argc == 2);
+  comm_init();
+  struct counts before;
+  struct counts serial = refine_serial(argv[1], &before);
+  struct mesh* m = read_and_partition_serial_mesh(argv[1]);
+  unsigned dim = mesh_dim(m);
+  mesh_set_rep(m, MESH_FULL);
+  set_region(m);
+  mesh_refine_uniform(m);
+  struct counts c = get_counts(m);
+  if (comm_rank() == 0)
+    printf("%lu elements, %lu in the region, on %u ranks\n",
+        c.nelems, c.nregion_elems, comm_size());
+  assert(serial.nelems == (before.nelems << dim));
+  assert(serial.nregion_elems == (before.nregion_elems << dim));
+  assert(serial.nregion_verts > before.nregion_verts);
+  assert(c.nverts == serial.nverts);
+  assert(c.nelems == serial.nelems);
+  assert(c.nregion_verts == serial.nregion_verts);
+  assert(c.nregion_elems == serial.nregion_elems);
+  assert(fabs(c.size - before.size) < 1e-10 * before.size);
+  assert(fabs(serial.size - before.size) < 1e-10 * before.size);
+  free_mesh(m);
+  comm_fini();
+}
@@ -0,0 +1,104 @@
+#include <assert.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+#include "algebra.h"
+#include "arrays.h"
+#include "comm.h"
+#include "derive_model.h"
+#include "doubles.h"
+#include "mesh.h"
+#include "quality.h"
+#include "refine.h"
+#include "refine_common.h"
+#include "size.h"
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+/* the previous uniform refinement: every edge is a candidate
+   and each pass splits an independent set of them, so it
+   takes several passes to get the same number of elements */
+
+static unsigned old_uniformly_refine(struct mesh* m)
+{
+  unsigned dim = mesh_dim(m);
+  unsigned target = mesh_count(m, dim) << dim;
+  unsigned npasses = 0;
+  while (mesh_count(m, dim) < target) {
+    unsigned nedges = mesh_count(m, 1);
+    mesh_add_tag(m, 1, TAG_U32, "candidate", 1, uints_filled(nedges, 1));
+    if (!refine_common(m, 1, 0.0, 0))
+      break;
+    ++npasses;
+  }
+  return npasses;
+}
+
+static struct mesh* make_mesh(unsigned dim, unsigned nlevels)
+{
+  struct mesh* m = new_box_mesh(dim);
+  mesh_derive_model(m, PI / 4);
+  mesh_set_rep(m, MESH_FULL);
+  for (unsigned i = 0; i < nlevels; ++i)
+    uniformly_refine(m);
+  return m;
+}
+
+static double total_size(struct mesh* m)
+{
+  double* sizes = mesh_element_sizes(m);
+  double s = doubles_sum(sizes, mesh_count(m, mesh_dim(m)));
+  loop_free(sizes);
+  return s;
+}
+
+int main(int argc, char** argv)
+{
+  comm_init();
+  unsigned dim = 3;
+  unsigned nlevels = 4;
+  if (argc >= 2)
+    dim = (unsigned) atoi(argv[1]);
+  if (argc >= 3)
+    nlevels = (unsigned) atoi(argv[2]);
+  assert(1 <= dim && dim <= 3);
+  struct mesh* m[2];
+  double t[2];
+  m[0] = make_mesh(dim, nlevels);
+  m[1] = make_mesh(dim, nlevels);
+  unsigned nelems = mesh_count(m[0], dim);
+  double t0 = get_time();
+  unsigned npasses = old_uniformly_refine(m[0]);
+  double t1 = get_time();
+  uniformly_refine(m[1]);
+  double t2 = get_time();
+  t[0] = t1 - t0;
+  t[1] = t2 - t1;
+  assert(mesh_count(m[1], dim) == (nelems << dim));
+  double s[2];
+  double q[2];
+  for (unsigned i = 0; i < 2; ++i) {
+    s[i] = total_size(m[i]);
+    q[i] = mesh_min_quality(m[i]);
+  }
+  assert(fabs(s[1] - s[0]) < 1e-10 * s[0]);
+  assert(q[1] > 0);
+  printf("%u elements: old %u passes %u elements quality %f %f s, "
+      "new 1 pass %u elements quality %f %f s, speedup %.1f\n",
+      nelems, npasses, mesh_count(m[0], dim), q[0], t[0],
+      mesh_count(m[1], dim), q[1], t[1], t[0] / t[1]);
+  for (unsigned i = 0; i < 2; ++i)
+    free_mesh(m[i]);
+  comm_fini();
+  return 0;
+}
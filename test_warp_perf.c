@@ -10,6 +10,7 @@
 #include "doubles.h"
 #include "element_field.h"
 #include "eval_field.h"
+#include "loop_timing.h"
 #include "mesh.h"
 #include "refine.h"
 #include "reorder.h"
@@ -163,6 +164,11 @@ int main(int argc, char** argv)
   double t1 = get_time();
   printf("time for main code: %.5e seconds\n", t1 - t0);
   printf("time for reorder: %.5e seconds\n", reorder_time);
+#if LOOP_TIMING
+  loop_timing_print();
+  sprintf(prefix, "%s/kernels.json", path);
+  loop_timing_write_json(prefix);
+#endif
   free_mesh(m);
   comm_fini();
 }
@@ -0,0 +1,159 @@
+#include "trace.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "comm.h"
+#include "files.h"
+#include "loop_host.h"
+
+#ifdef _OPENMP
+#define CRITICAL _Pragma("omp critical (trace)")
+#else
+#define CRITICAL
+#endif
+
+struct event {
+  char const* name;
+  double time;
+  unsigned thread;
+  char phase;
+};
+
+/* events are kept in memory and only written out at
+   trace_close, so tracing itself does no I/O */
+
+static unsigned is_open = 0;
+static char trace_path[256];
+static double trace_start;
+static struct event* events = 0;
+static unsigned nevents = 0;
+static unsigned capacity = 0;
+
+static double get_time(void)
+{
+  struct timeval tv;
+  gettimeofday(&tv, NULL);
+  double t = (double) tv.tv_usec;
+  t /= 1e6;
+  t += (double) tv.tv_sec;
+  return t;
+}
+
+static unsigned get_thread(void)
+{
+#ifdef _OPENMP
+  return (unsigned) omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+static void record(char const* name, char phase)
+{
+  if (!is_open)
+    return;
+  double t = get_time();
+  unsigned thread = get_thread();
+  CRITICAL {
+    if (nevents == capacity) {
+      capacity = capacity ? capacity * 2 : 1024;
+      events = LOOP_HOST_REALLOC(struct event, events, capacity);
+    }
+    events[nevents].name = name;
+    events[nevents].time = t;
+    events[nevents].thread = thread;
+    events[nevents].phase = phase;
+    ++nevents;
+  }
+}
+
+void trace_begin(char const* name)
+{
+  record(name, 'B');
+}
+
+void trace_end(void)
+{
+  record(0, 'E');
+}
+
+/* all ranks measure from the earliest rank's start,
+   which lines up the timelines as well as the
+   wall clocks of the nodes agree */
+
+void trace_open(char const* filename)
+{
+  assert(!is_open);
+  assert(strlen(filename) < sizeof(trace_path));
+  strcpy(trace_path, filename);
+  trace_start = comm_min_double(get_time());
+  is_open = 1;
+}
+
+static void write_events(FILE* f, unsigned rank)
+{
+  fprintf(f, "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %u, "
+      "\"args\": {\"name\": \"rank %u\"}}", rank, rank);
+  for (unsigned i = 0; i < nevents; ++i) {
+    struct event const* e = &events[i];
+    double us = (e->time - trace_start) * 1e6;
+    fprintf(f, ",\n{");
+    if (e->name)
+      fprintf(f, "\"name\": \"%s\", ", e->name);
+    fprintf(f, "\"ph\": \"%c\", \"ts\": %.3f, \"pid\": %u, \"tid\": %u}",
+        e->phase, us, rank, e->thread);
+  }
+}
+
+static void piece_path(unsigned rank, char* path, unsigned size)
+{
+  int n = snprintf(path, size, "%s.%u", trace_path, rank);
+  assert(n > 0 && (unsigned) n < size);
+}
+
+/* each rank writes its events to a piece file next to
+   the trace, then rank 0 joins them into one file */
+
+void trace_close(void)
+{
+  assert(is_open);
+  is_open = 0;
+  unsigned rank = comm_rank();
+  unsigned nranks = comm_size();
+  char path[300];
+  piece_path(rank, path, sizeof(path));
+  FILE* f = safe_fopen(path, "w");
+  write_events(f, rank);
+  fclose(f);
+  loop_host_free(events);
+  events = 0;
+  nevents = capacity = 0;
+  /* the reduction doubles as a barrier */
+  comm_max_uint(0);
+  if (!rank) {
+    FILE* out = safe_fopen(trace_path, "w");
+    fprintf(out, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    for (unsigned r = 0; r < nranks; ++r) {
+      piece_path(r, path, sizeof(path));
+      FILE* in = safe_fopen(path, "r");
+      if (r)
+        fprintf(out, ",\n");
+      char buf[4096];
+      size_t n;
+      while ((n = fread(buf, 1, sizeof(buf), in)))
+        fwrite(buf, 1, n, out);
+      fclose(in);
+      remove(path);
+    }
+    fprintf(out, "\n]}\n");
+    fclose(out);
+  }
+  comm_max_uint(0);
+}
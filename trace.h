@@ -0,0 +1,16 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/* timeline tracing in the Chrome trace event format.
+   between trace_open and trace_close, every
+   trace_begin/trace_end pair becomes a region on the
+   timeline of its MPI rank and thread.
+   names must outlive the trace (string literals).
+   when no trace is open the calls return immediately. */
+
+void trace_open(char const* filename);
+void trace_close(void);
+void trace_begin(char const* name);
+void trace_end(void);
+
+#endif
@@ -16,6 +16,7 @@
 #include "parallel_mesh.h"
 #include "tables.h"
 #include "tag.h"
+#include "trace.h"
 
 enum cell_type {
   VTK_VERTEX         = 1,
@@ -148,6 +149,7 @@ static void write_binary_array(FILE* file, enum tag_type t, unsigned nents,
   unsigned tsize = tag_size(t);
   unsigned size = tsize * ncomps * nents;
   unsigned long comp_size;
+  enum mem_category cat = loop_host_set_category(MEM_IO);
   void* host_data = uchars_to_host((unsigned char const*) data, size);
   void* comp = my_compress(host_data, size, &comp_size);
   loop_host_free(host_data);
@@ -161,6 +163,7 @@ static void write_binary_array(FILE* file, enum tag_type t, unsigned nents,
   fputs(s, file);
   loop_host_free(s);
   fputc('\n', file);
+  loop_host_set_category(cat);
 }
 
 static void read_binary_uints(char const** p, unsigned* x, unsigned n)
@@ -176,6 +179,7 @@ static void* read_binary_array(FILE* file, enum endian end, unsigned do_com,
 {
   unsigned tsize = tag_size(t);
   unsigned long enc_nchars;
+  enum mem_category cat = loop_host_set_category(MEM_IO);
   char* enc = base64_fread(file, &enc_nchars);
   char const* p = enc;
   unsigned long decomp_size = nents * ncomps * tsize;
@@ -199,6 +203,7 @@ static void* read_binary_array(FILE* file, enum endian end, unsigned do_com,
     loop_host_free(decod);
   } else
     decomp = decod;
+  loop_host_set_category(cat);
   /* this function also copies to device space */
   void* swapped = generic_swap_if_needed(end, nents * ncomps, tsize, decomp);
   loop_host_free(decomp);
@@ -479,6 +484,7 @@ static void read_piece_header(FILE* f, unsigned* nverts, unsigned* nelems,
 
 static void write_vtu_opts(struct mesh* m, char const* filename, enum vtk_format fmt)
 {
+  trace_begin("write_vtu");
   unsigned elem_dim = mesh_dim(m);
   unsigned nverts = mesh_count(m, 0);
   unsigned do_edges = ((elem_dim > 1) && mesh_has_dim(m, 1));
@@ -524,6 +530,7 @@ static void write_vtu_opts(struct mesh* m, char const* filename, enum vtk_format
   fprintf(file, "</UnstructuredGrid>\n");
   fprintf(file, "</VTKFile>\n");
   fclose(file);
+  trace_end();
 }
 
 static void write_vtu(struct mesh* m, char const* filename)
@@ -699,6 +706,7 @@ static void read_vtk_fields(FILE* f, struct mesh* m, enum endian end,
 
 static struct mesh* read_vtu_opts(char const* filename, unsigned is_parallel)
 {
+  trace_begin("read_vtu");
   FILE* file = safe_fopen(filename, "r");
   enum endian end;
   unsigned do_com;
@@ -708,6 +716,7 @@ static struct mesh* read_vtu_opts(char const* filename, unsigned is_parallel)
   struct mesh* m = read_vtk_mesh(file, end, do_com, is_parallel);
   read_vtk_fields(file, m, end, do_com, is_parallel);
   fclose(file);
+  trace_end();
   return m;
 }
 